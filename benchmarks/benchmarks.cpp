@@ -1,6 +1,12 @@
 #include <benchmark/benchmark.h>
 
 #include "bsm.h"
+#include "solver_qdplus_internals.h"
+#include "solver_fastamerican_internals.h"
+#include "../random.h"
+
+#include <fstream>
+#include <string>
 
 using namespace bsm;
 using namespace bsm::chrono;
@@ -130,4 +136,866 @@ static void Benchmark_AP_CRR_Price(benchmark::State& state) {
 }
 BENCHMARK(Benchmark_AP_CRR_Price);
 
+static void Benchmark_AP_CRR_Truncated_Price(benchmark::State& state) {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = datetime::now();
+    auto r = 0.01;
+    auto q = 0.05;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 0.5_years};
+    crr_solver<autodiff_off> solve{mktParams, static_cast<int>(state.range(0)), 0, 6.0};
+
+    for (auto _: state) {
+        auto pricing = solve(americanPut);
+        benchmark::DoNotOptimize(pricing->price());
+    }
+}
+BENCHMARK(Benchmark_AP_CRR_Truncated_Price)->Arg(400)->Arg(4000)->Arg(20000);
+
+//Trinomial method
+
+static void Benchmark_AP_Trinomial_Price(benchmark::State& state) {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = datetime::now();
+    auto r = 0.01;
+    auto q = 0.05;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 0.5_years};
+    trinomial_solver<autodiff_off> solve{mktParams,400};
+
+    for (auto _: state) {
+        auto pricing = solve(americanPut);
+        pricing->price();
+        pricing->delta();
+        pricing->gamma();
+        pricing->vega();
+        pricing->rho();
+        pricing->theta();
+        pricing->psi();
+    }
+}
+BENCHMARK(Benchmark_AP_Trinomial_Price);
+
+//Superpositioned Binomial Lattice method
+
+static void Benchmark_AP_SBL_Price(benchmark::State& state) {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = datetime::now();
+    auto r = 0.01;
+    auto q = 0.05;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 0.5_years};
+    sbl_solver<autodiff_off> solve{mktParams,static_cast<int>(state.range(0))};
+
+    for (auto _: state) {
+        auto pricing = solve(americanPut);
+        pricing->price();
+        pricing->delta();
+        pricing->gamma();
+        pricing->vega();
+        pricing->rho();
+        pricing->theta();
+        pricing->psi();
+    }
+}
+BENCHMARK(Benchmark_AP_SBL_Price)->Arg(200)->Arg(2000);
+
+//Control variate (American - European + Black-Scholes) vs plain lattices: the RMS price error against the spectral
+//collocation solver over a strip of spots, and the accuracy bought per millisecond, 1/(error x time of one price)
+
+static void Benchmark_AP_ControlVariate(benchmark::State& state, std::function<std::unique_ptr<american_method>(mkt_params<double> const&, american_put&)> solve) {
+    auto t = datetime::now();
+    american_put americanPut{100.0, t + 1.0_years};
+    std::vector<mkt_params<double>> markets;
+    std::vector<double> references;
+    for (auto S = 80.0; S <= 120.0; S += 2.0) {
+        markets.push_back({S, 0.25, t, 0.05, 0.01});
+        fastamerican_solver<autodiff_off> solve_reference{markets.back(), 25, 5, 12};
+        references.push_back(solve_reference(americanPut)->price());
+    }
+
+    double squares = 0;
+    for (auto _: state) {
+        squares = 0;
+        for (std::size_t i = 0; i < markets.size(); i++) {
+            auto error = solve(markets[i], americanPut)->price() - references[i];
+            squares += error * error;
+        }
+    }
+    auto error = std::sqrt(squares / markets.size());
+    state.SetItemsProcessed(state.iterations() * markets.size());
+    state.counters["rms_error"] = error;
+    state.counters["accuracy_per_ms"] = benchmark::Counter(1e-3 * markets.size() / error, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+static void Benchmark_AP_CRR_ControlVariate(benchmark::State& state) {
+    Benchmark_AP_ControlVariate(state, [&state](mkt_params<double> const& mktParams, american_put& americanPut) {
+        crr_solver<autodiff_off> solve{mktParams, static_cast<int>(state.range(0)), 0, 0, state.range(1) != 0};
+        return solve(americanPut);
+    });
+}
+BENCHMARK(Benchmark_AP_CRR_ControlVariate)->Args({200, 0})->Args({200, 1})->Args({500, 0})->Args({500, 1})->Unit(benchmark::kMillisecond);
+
+static void Benchmark_AP_SBL_ControlVariate(benchmark::State& state) {
+    Benchmark_AP_ControlVariate(state, [&state](mkt_params<double> const& mktParams, american_put& americanPut) {
+        sbl_solver<autodiff_off> solve{mktParams, static_cast<int>(state.range(0)), state.range(1) != 0};
+        return solve(americanPut);
+    });
+}
+BENCHMARK(Benchmark_AP_SBL_ControlVariate)->Args({200, 0})->Args({200, 1})->Args({500, 0})->Args({500, 1})->Unit(benchmark::kMillisecond);
+
+//Crank-Nicolson finite differences (space steps, time steps)
+
+static void Benchmark_AP_CrankNicolson_Price(benchmark::State& state) {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = datetime::now();
+    auto r = 0.01;
+    auto q = 0.05;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 0.5_years};
+    cranknicolson_solver<autodiff_off> solve{mktParams, static_cast<int>(state.range(0)), static_cast<int>(state.range(1))};
+
+    for (auto _: state) {
+        auto pricing = solve(americanPut);
+        pricing->price();
+        pricing->delta();
+        pricing->gamma();
+        pricing->theta();
+    }
+}
+BENCHMARK(Benchmark_AP_CrankNicolson_Price)->Args({200, 100})->Args({400, 200})->Args({800, 400});
+
+static void Benchmark_AP_CrankNicolson_Greeks(benchmark::State& state) {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = datetime::now();
+    auto r = 0.01;
+    auto q = 0.05;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 0.5_years};
+    cranknicolson_solver<autodiff_off> solve{mktParams, static_cast<int>(state.range(0)), static_cast<int>(state.range(1))};
+
+    for (auto _: state) {
+        auto pricing = solve(americanPut);
+        pricing->price();
+        pricing->delta();
+        pricing->gamma();
+        pricing->vega();
+        pricing->rho();
+        pricing->theta();
+        pricing->psi();
+    }
+}
+BENCHMARK(Benchmark_AP_CrankNicolson_Greeks)->Args({400, 200});
+
+//A chain of 41 strikes (60 to 140): one Crank-Nicolson solve per strike vs one solve shared in moneyness
+
+static void Benchmark_AP_CrankNicolson_Chain(benchmark::State& state) {
+    auto t = datetime::now();
+    mkt_params mktParams{100.0, 0.20, t, 0.01, 0.05};
+    std::vector<american_put> chain;
+    for (int i = 0; i <= 40; i++) {
+        chain.emplace_back(60.0 + 2.0 * i, t + 0.5_years);
+    }
+    cranknicolson_solver<autodiff_off> solve{mktParams, 400, 200};
+    bool shared = state.range(0);
+
+    for (auto _: state) {
+        if (shared) {
+            for (auto& pricing: solve(chain)) {
+                benchmark::DoNotOptimize(pricing->price());
+                benchmark::DoNotOptimize(pricing->delta());
+                benchmark::DoNotOptimize(pricing->gamma());
+            }
+        } else {
+            for (auto& option: chain) {
+                auto pricing = solve(option);
+                benchmark::DoNotOptimize(pricing->price());
+                benchmark::DoNotOptimize(pricing->delta());
+                benchmark::DoNotOptimize(pricing->gamma());
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * chain.size());
+}
+BENCHMARK(Benchmark_AP_CrankNicolson_Chain)->Arg(0)->Arg(1);
+
+//QD+ exercise boundary: dual number Newton (current path) vs double precision Halley, cold and warm started
+
+static void Benchmark_QDPlus_Boundary_Dual(benchmark::State& state) {
+    using namespace bsm::internals;
+    pricing<ldual> p{100.0, 100.0, 0.20, 0.5, 0.05, 0.0};
+    int iterations = 0;
+    for (auto _: state) {
+        qdplus_method_core<ldual> core{p, false};
+        benchmark::DoNotOptimize(core.calculate_exercise_boundary(0.5));
+        iterations += core.iterations;
+    }
+    state.counters["iterations"] = benchmark::Counter(iterations, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(Benchmark_QDPlus_Boundary_Dual);
+
+static void Benchmark_QDPlus_Boundary_Halley(benchmark::State& state) {
+    bsm::internals::qdplus_boundary_solver solver{100.0, 0.20, 0.05, 0.0};
+    int iterations = 0;
+    for (auto _: state) {
+        auto boundary = solver(0.5);
+        benchmark::DoNotOptimize(boundary.Sb);
+        iterations += boundary.iterations;
+    }
+    state.counters["iterations"] = benchmark::Counter(iterations, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(Benchmark_QDPlus_Boundary_Halley);
+
+//A boundary curve: each time to maturity is warm started from the previous one
+static void Benchmark_QDPlus_Boundary_Halley_Warm(benchmark::State& state) {
+    bsm::internals::qdplus_boundary_solver solver{100.0, 0.20, 0.05, 0.0};
+    const int points = 100;
+    int iterations = 0;
+    for (auto _: state) {
+        double Sb = NAN;
+        for (int i = 1; i <= points; i++) {
+            auto boundary = solver(0.5 * i / points, Sb);
+            Sb = boundary.Sb;
+            iterations += boundary.iterations;
+        }
+        benchmark::DoNotOptimize(Sb);
+    }
+    state.counters["iterations"] = benchmark::Counter(iterations, benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations() * points);
+}
+BENCHMARK(Benchmark_QDPlus_Boundary_Halley_Warm);
+
+//QD+ over a chain (puts and calls, 100 strikes x 10 expiries): one scalar solve per option vs the batched solver
+
+static std::vector<bsm::internals::qdplus_batch_solver::option> qdplus_chain() {
+    std::vector<bsm::internals::qdplus_batch_solver::option> chain;
+    for (int e = 1; e <= 10; e++) {
+        for (int k = 0; k < 50; k++) {
+            auto K = 75.0 + k;
+            chain.push_back({100.0, K, 0.25, e / 10.0, 0.05, 0.02, false});
+            chain.push_back({100.0, K, 0.25, e / 10.0, 0.05, 0.02, true});
+        }
+    }
+    return chain;
+}
+
+static void Benchmark_QDPlus_Chain_Scalar(benchmark::State& state) {
+    using namespace bsm::internals;
+    auto chain = qdplus_chain();
+    for (auto _: state) {
+        for (auto const& o: chain) {
+            auto r = o.call ? o.q : o.r;
+            auto q = o.call ? o.r : o.q;
+            qdplus_boundary_solver solver{o.call ? o.S : o.K, o.sigma, r, q};
+            auto Sb = solver(o.tau).Sb;
+            qdplus_put_coefficients put{o.call ? o.S : o.K, o.sigma, r, q, o.tau};
+            benchmark::DoNotOptimize(put.price(o.call ? o.K : o.S, Sb));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * chain.size());
+}
+BENCHMARK(Benchmark_QDPlus_Chain_Scalar)->Unit(benchmark::kMicrosecond);
+
+static void Benchmark_QDPlus_Chain_Batched(benchmark::State& state) {
+    using namespace bsm::internals;
+    auto chain = qdplus_chain();
+    std::vector<qdplus_batch_solver::result> results(chain.size());
+    qdplus_batch_solver solve;
+    for (auto _: state) {
+        solve(chain.data(), results.data(), chain.size());
+        benchmark::DoNotOptimize(results.data());
+    }
+    state.SetItemsProcessed(state.iterations() * chain.size());
+}
+BENCHMARK(Benchmark_QDPlus_Chain_Batched)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+//Spectral collocation (ALO): price only, then the full set of greeks (vega, rho and psi reprice twice each)
+
+static void Benchmark_AP_FastAmerican_Price(benchmark::State& state) {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = datetime::now();
+    auto r = 0.05;
+    auto q = 0.01;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 0.5_years};
+    fastamerican_solver<autodiff_off> solve{mktParams, static_cast<int>(state.range(0)), static_cast<int>(state.range(1)), static_cast<int>(state.range(2))};
+
+    for (auto _: state) {
+        auto pricing = solve(americanPut);
+        benchmark::DoNotOptimize(pricing->price());
+    }
+}
+BENCHMARK(Benchmark_AP_FastAmerican_Price)->Args({8, 2, 6})->Args({16, 3, 8})->Args({25, 5, 12});
+
+static void Benchmark_AP_FastAmerican_Greeks(benchmark::State& state) {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = datetime::now();
+    auto r = 0.05;
+    auto q = 0.01;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 0.5_years};
+    fastamerican_solver<autodiff_off> solve{mktParams, 16, 3, 8};
+
+    for (auto _: state) {
+        auto pricing = solve(americanPut);
+        pricing->price();
+        pricing->delta();
+        pricing->gamma();
+        pricing->vega();
+        pricing->rho();
+        pricing->theta();
+        pricing->psi();
+    }
+}
+BENCHMARK(Benchmark_AP_FastAmerican_Greeks);
+
+//Table setup of the collocation: built from scratch vs looked up in the cache (what a pricing call pays)
+
+static void Benchmark_FastAmerican_Tables_Build(benchmark::State& state) {
+    for (auto _: state) {
+        bsm::internals::alo_collocation_tables tables{static_cast<int>(state.range(0)), static_cast<int>(state.range(1))};
+        benchmark::DoNotOptimize(tables.basis.data());
+    }
+}
+BENCHMARK(Benchmark_FastAmerican_Tables_Build)->Args({16, 8})->Args({25, 12});
+
+static void Benchmark_FastAmerican_Tables_Cached(benchmark::State& state) {
+    for (auto _: state) {
+        auto tables = bsm::internals::alo_collocation_tables::get(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+        benchmark::DoNotOptimize(tables.get());
+    }
+}
+BENCHMARK(Benchmark_FastAmerican_Tables_Cached)->Args({16, 8})->Args({25, 12});
+
+//Early exercise monitoring: 100 boundary queries per option, point-wise (QD+) vs the boundary curve
+
+static void Benchmark_Boundary_QDPlus_Pointwise(benchmark::State& state) {
+    auto t = datetime::now();
+    mkt_params<long double> mktParams{100.0L, 0.20L, t, 0.05L, 0.01L};
+    american_put americanPut{100.0, t + 0.5_years};
+    qdplus_solver<autodiff_off> solve{mktParams};
+    auto pricing = solve(americanPut);
+    for (auto _: state) {
+        for (int i = 1; i <= 100; i++) {
+            benchmark::DoNotOptimize(pricing->exercise_boundary(0.005 * i));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 100);
+}
+BENCHMARK(Benchmark_Boundary_QDPlus_Pointwise);
+
+static void Benchmark_Boundary_Curve_Query(benchmark::State& state) {
+    auto t = datetime::now();
+    mkt_params<long double> mktParams{100.0L, 0.20L, t, 0.05L, 0.01L};
+    american_put americanPut{100.0, t + 0.5_years};
+    qdplus_solver<autodiff_off> solve{mktParams};
+    auto curve = solve(americanPut)->exercise_boundary_curve();
+    for (auto _: state) {
+        for (int i = 1; i <= 100; i++) {
+            benchmark::DoNotOptimize((*curve)(0.005 * i));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 100);
+}
+BENCHMARK(Benchmark_Boundary_Curve_Query);
+
+static void Benchmark_Boundary_Curve_Build(benchmark::State& state) {
+    auto t = datetime::now();
+    mkt_params<long double> mktParams{100.0L, 0.20L, t, 0.05L, 0.01L};
+    american_put americanPut{100.0, t + 0.5_years};
+    qdplus_solver<autodiff_off> solve{mktParams};
+    auto pricing = solve(americanPut);
+    for (auto _: state) {
+        boundary_curve curve{[&pricing](double tau) { return static_cast<double>(pricing->exercise_boundary(tau)); }, 0.5, instrument_type::put};
+        benchmark::DoNotOptimize(curve(0.25));
+    }
+}
+BENCHMARK(Benchmark_Boundary_Curve_Build);
+
+//Table of a trading day: the rates are fixed
+static american_price_table const& benchmark_price_table() {
+    static auto table = american_price_table::build(instrument_type::put,
+            price_table_domain{{-4.0, 0.1, 0.1, 0.05, 0.01}, {4.0, 1.0, 0.5, 0.05, 0.01}, {16, 12, 8, 1, 1}});
+    return table;
+}
+
+static void Benchmark_AP_PriceTable_Price(benchmark::State& state) {
+    auto const& table = benchmark_price_table();
+    for (auto _: state) {
+        for (int i = 0; i < 100; i++) {
+            benchmark::DoNotOptimize(table.price(80.0 + 0.4 * i, 100.0, 0.5, 0.25, 0.05, 0.01));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 100);
+}
+BENCHMARK(Benchmark_AP_PriceTable_Price);
+
+static void Benchmark_AP_PriceTable_Greeks(benchmark::State& state) {
+    auto const& table = benchmark_price_table();
+    for (auto _: state) {
+        for (int i = 0; i < 100; i++) {
+            benchmark::DoNotOptimize(table.greeks(80.0 + 0.4 * i, 100.0, 0.5, 0.25, 0.05, 0.01));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 100);
+}
+BENCHMARK(Benchmark_AP_PriceTable_Greeks);
+
+//Normal random numbers: std::mt19937 with std::normal_distribution (the former random_normal) vs Philox streams
+
+static void Benchmark_Normals_MT19937(benchmark::State& state) {
+    std::mt19937 generator{1};
+    std::normal_distribution<double> normal;
+    std::vector<double> z(state.range(0));
+    for (auto _: state) {
+        std::ranges::generate(z, [&]() { return normal(generator); });
+        benchmark::DoNotOptimize(z.data());
+    }
+    state.SetItemsProcessed(state.iterations() * z.size());
+}
+BENCHMARK(Benchmark_Normals_MT19937)->Arg(4096);
+
+static void Benchmark_Normals_Philox_Scalar(benchmark::State& state) {
+    random_normal<double> normal{1};
+    std::vector<double> z(state.range(0));
+    for (auto _: state) {
+        std::ranges::generate(z, [&]() { return normal(); });
+        benchmark::DoNotOptimize(z.data());
+    }
+    state.SetItemsProcessed(state.iterations() * z.size());
+}
+BENCHMARK(Benchmark_Normals_Philox_Scalar)->Arg(4096);
+
+static void Benchmark_Normals_Philox_Fill(benchmark::State& state) {
+    random_normal<double> normal{1};
+    std::vector<double> z(state.range(0));
+    for (auto _: state) {
+        normal.fill(z.data(), z.size());
+        benchmark::DoNotOptimize(z.data());
+    }
+    state.SetItemsProcessed(state.iterations() * z.size());
+}
+BENCHMARK(Benchmark_Normals_Philox_Fill)->Arg(4096);
+
+//Convergence of pseudo random (Philox) vs scrambled Sobol paths with the Brownian bridge: RMS error, over 16 seeds,
+//of the Monte Carlo price of an at the money european call simulated on 64 steps, by number of paths
+
+static void Benchmark_Convergence(benchmark::State& state, bool quasi_random) {
+    int paths = state.range(0);
+    int steps = 64;
+    double S = 100.0, K = 100.0, sigma = 0.2, tau = 1.0, r = 0.03;
+    auto reference = internals::calculate_european_call<double>({S, K, sigma, tau, r, 0.0});
+    brownian_bridge bridge{steps, tau};
+    std::vector<double> z(static_cast<std::size_t>(paths) * steps), W(steps);
+    auto dt = tau / steps;
+
+    double squares = 0;
+    for (auto _: state) {
+        squares = 0;
+        for (std::uint64_t seed = 1; seed <= 16; seed++) {
+            if (quasi_random) {
+                sobol{steps, seed}.normals(0, paths, z.data());
+            } else {
+                random_normal<double>{seed}.fill(z.data(), z.size());
+            }
+            double sum = 0;
+            for (int p = 0; p < paths; p++) {
+                auto normals = z.data() + static_cast<std::size_t>(p) * steps;
+                double log_S = 0;
+                if (quasi_random) {
+                    bridge(normals, W.data());
+                    log_S = sigma * W[steps - 1];
+                } else {
+                    for (int i = 0; i < steps; i++) {
+                        log_S += sigma * std::sqrt(dt) * normals[i];
+                    }
+                }
+                sum += std::max(S * exp((r - 0.5 * sigma * sigma) * tau + log_S) - K, 0.0);
+            }
+            auto error = exp(-r * tau) * sum / paths - reference;
+            squares += error * error;
+        }
+    }
+    state.counters["rms_error"] = std::sqrt(squares / 16);
+    state.SetItemsProcessed(state.iterations() * 16 * paths);
+}
+
+static void Benchmark_Convergence_Philox(benchmark::State& state) {
+    Benchmark_Convergence(state, false);
+}
+BENCHMARK(Benchmark_Convergence_Philox)->RangeMultiplier(4)->Range(1 << 10, 1 << 14)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Convergence_Sobol(benchmark::State& state) {
+    Benchmark_Convergence(state, true);
+}
+BENCHMARK(Benchmark_Convergence_Sobol)->RangeMultiplier(4)->Range(1 << 10, 1 << 14)->Unit(benchmark::kMillisecond);
+
+//Monte Carlo solver on an arithmetic Asian call of 12 fixings: paths per second and standard error of each estimator
+//(0 plain, 1 antithetic, 2 European call control variate, 3 both)
+
+static void Benchmark_MC_Asian(benchmark::State& state) {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.30;
+    auto t = datetime::now();
+    auto r = 0.03;
+    auto q = 0.0;
+    mkt_params mktParams{S, sigma, t, r, q};
+    european_call europeanCall{K, t + 1.0_years};
+    path_payoff asian = [K](double const* S, int steps) {
+        double average = 0;
+        for (int i = 0; i < steps; i++) {
+            average += S[i] / steps;
+        }
+        return std::max(average - K, 0.0);
+    };
+    int paths = 1 << 16;
+    auto estimator = state.range(0);
+    mc_solver solve{mktParams, paths, 12, (estimator & 1) != 0, (estimator & 2) != 0};
+
+    double standard_error = 0;
+    for (auto _: state) {
+        standard_error = solve(europeanCall, asian)->standard_error();
+    }
+    state.counters["standard_error"] = standard_error;
+    state.SetItemsProcessed(state.iterations() * paths);
+}
+BENCHMARK(Benchmark_MC_Asian)->DenseRange(0, 3)->Unit(benchmark::kMillisecond);
+
+//Delta, gamma and vega of a Monte Carlo european call: read off the sweep of the price (0) or by bumping and
+//revaluing on the same random numbers (1)
+
+static void Benchmark_MC_Greeks(benchmark::State& state) {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = datetime::now();
+    auto r = 0.01;
+    auto q = 0.05;
+    european_call europeanCall{K, t + 0.5_years};
+    int paths = 1 << 16;
+    auto solver = [&](double _S, double _sigma) {
+        return mc_solver{mkt_params{_S, _sigma, t, r, q}, paths};
+    };
+    bool bump = state.range(0) != 0;
+
+    double delta_error = 0;
+    for (auto _: state) {
+        auto pricing = solver(S, sigma)(europeanCall);
+        if (bump) {
+            auto up = solver(1.01 * S, sigma)(europeanCall)->price();
+            auto down = solver(0.99 * S, sigma)(europeanCall)->price();
+            auto vol_up = solver(S, sigma * exp(0.01))(europeanCall)->price();
+            benchmark::DoNotOptimize((up - down) / (0.02 * S));
+            benchmark::DoNotOptimize((up - 2 * pricing->price() + down) / (0.0001 * S * S));
+            benchmark::DoNotOptimize((vol_up - pricing->price()) / (sigma * (exp(0.01) - 1)));
+        } else {
+            benchmark::DoNotOptimize(pricing->delta());
+            benchmark::DoNotOptimize(pricing->gamma());
+            benchmark::DoNotOptimize(pricing->vega());
+        }
+        delta_error = pricing->delta_error();
+    }
+    state.counters["delta_error"] = delta_error;
+}
+BENCHMARK(Benchmark_MC_Greeks)->DenseRange(0, 1)->Unit(benchmark::kMillisecond);
+
+//Least-squares Monte Carlo American put on 50 exercise dates, by number of paths: error against the Spectral
+//Collocation (ALO) price and standard error
+
+static void Benchmark_AP_LSM(benchmark::State& state) {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = datetime::now();
+    auto r = 0.05;
+    auto q = 0.01;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 1.0_years};
+    int paths = state.range(0);
+    lsm_solver solve{mktParams, paths, 50};
+    auto reference = fastamerican_solver{mktParams, 25, 5, 12}(americanPut)->price();
+
+    double error = 0, standard_error = 0;
+    for (auto _: state) {
+        auto pricing = solve(americanPut);
+        error = pricing->price() - reference;
+        standard_error = pricing->standard_error();
+    }
+    state.counters["error"] = error;
+    state.counters["standard_error"] = standard_error;
+    state.SetItemsProcessed(state.iterations() * paths);
+}
+BENCHMARK(Benchmark_AP_LSM)->RangeMultiplier(4)->Range(1 << 12, 1 << 16)->Unit(benchmark::kMillisecond);
+
+//Year fractions of the maturities of a chain of 1024 options on 8 expiries: one time_between per option, indexing
+//the chain into an expiry_table (which computes them once per expiry), and on the business/252 clock of a calendar
+
+static std::vector<datetime> Chain_Maturities(datetime t) {
+    std::vector<datetime> maturities;
+    for (int i = 0; i < 1024; i++) {
+        maturities.push_back(t + frac_years{0.125L * (1 + i % 8)});
+    }
+    return maturities;
+}
+
+static void Benchmark_Chrono_TimeBetween(benchmark::State& state) {
+    auto t = datetime::now();
+    auto maturities = Chain_Maturities(t);
+    for (auto _: state) {
+        for (auto const& maturity: maturities) {
+            benchmark::DoNotOptimize(time_between(t, maturity));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * maturities.size());
+}
+BENCHMARK(Benchmark_Chrono_TimeBetween);
+
+static void Benchmark_Chrono_ExpiryTable(benchmark::State& state) {
+    auto t = datetime::now();
+    auto maturities = Chain_Maturities(t);
+    for (auto _: state) {
+        expiry_table expiries{t};
+        auto indices = expiries.indices(maturities);
+        for (auto i: indices) {
+            benchmark::DoNotOptimize(expiries.tau(i));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * maturities.size());
+}
+BENCHMARK(Benchmark_Chrono_ExpiryTable);
+
+static void Benchmark_Chrono_Calendar(benchmark::State& state) {
+    auto t = datetime::now();
+    auto maturities = Chain_Maturities(t);
+    auto today = year_month_day{floor<days>(t.instant)};
+    calendar business{today, year_month_day{sys_days{today} + days{800}}, {}};
+    for (auto _: state) {
+        benchmark::DoNotOptimize(business.year_fractions(t, maturities));
+    }
+    state.SetItemsProcessed(state.iterations() * maturities.size());
+}
+BENCHMARK(Benchmark_Chrono_Calendar);
+
+//European chain of 100 strikes x 10 expiries x calls and puts: priced one object at a time, or read from the
+//columns of an instrument_table, with the memory of a contract in each layout
+
+static void Benchmark_Chain_Objects_Analytical(benchmark::State& state) {
+    auto t = datetime::now();
+    mkt_params mktParams{100.0, 0.25, t, 0.05, 0.02};
+    std::vector<european_call> calls;
+    std::vector<european_put> puts;
+    for (int e = 1; e <= 10; e++) {
+        for (int k = 0; k < 100; k++) {
+            calls.emplace_back(50.0 + k, t + frac_years{e / 10.0L});
+            puts.emplace_back(50.0 + k, t + frac_years{e / 10.0L});
+        }
+    }
+    analytical_solver<autodiff_off> solve{mktParams};
+    for (auto _: state) {
+        for (std::size_t i = 0; i < calls.size(); i++) {
+            benchmark::DoNotOptimize(solve(calls[i])->price());
+            benchmark::DoNotOptimize(solve(puts[i])->price());
+        }
+    }
+    state.counters["bytes_per_contract"] = sizeof(european_call);
+    state.SetItemsProcessed(state.iterations() * 2 * calls.size());
+}
+BENCHMARK(Benchmark_Chain_Objects_Analytical)->Unit(benchmark::kMicrosecond);
+
+static void Benchmark_Chain_Table_Analytical(benchmark::State& state) {
+    auto t = datetime::now();
+    mkt_params mktParams{100.0, 0.25, t, 0.05, 0.02};
+    instrument_table table{t};
+    for (int e = 1; e <= 10; e++) {
+        for (int k = 0; k < 100; k++) {
+            table.add(50.0 + k, t + frac_years{e / 10.0L}, instrument_type::call, european_exercise);
+            table.add(50.0 + k, t + frac_years{e / 10.0L}, instrument_type::put, european_exercise);
+        }
+    }
+    analytical_solver<autodiff_off> solve{mktParams};
+    for (auto _: state) {
+        benchmark::DoNotOptimize(solve(table));
+    }
+    state.counters["bytes_per_contract"] = instrument_table::bytes_per_contract;
+    state.SetItemsProcessed(state.iterations() * table.size());
+}
+BENCHMARK(Benchmark_Chain_Table_Analytical)->Unit(benchmark::kMicrosecond);
+
+//The same chain with the market_context of its expiries built once and reused, as for every chain of an underlying
+//sharing its expiries
+
+static void Benchmark_Chain_Context_Analytical(benchmark::State& state) {
+    auto t = datetime::now();
+    mkt_params mktParams{100.0, 0.25, t, 0.05, 0.02};
+    instrument_table table{t};
+    for (int e = 1; e <= 10; e++) {
+        for (int k = 0; k < 100; k++) {
+            table.add(50.0 + k, t + frac_years{e / 10.0L}, instrument_type::call, european_exercise);
+            table.add(50.0 + k, t + frac_years{e / 10.0L}, instrument_type::put, european_exercise);
+        }
+    }
+    analytical_solver<autodiff_off> solve{mktParams};
+    market_context context{mktParams, table.columns().taus};
+    for (auto _: state) {
+        benchmark::DoNotOptimize(solve(table, context));
+    }
+    state.SetItemsProcessed(state.iterations() * table.size());
+}
+BENCHMARK(Benchmark_Chain_Context_Analytical)->Unit(benchmark::kMicrosecond);
+
+static void Benchmark_Chain_Table_QDPlus(benchmark::State& state) {
+    auto t = datetime::now();
+    instrument_table table{t};
+    for (int e = 1; e <= 10; e++) {
+        for (int k = 0; k < 100; k++) {
+            table.add(50.0 + k, t + frac_years{e / 10.0L}, instrument_type::call, american_exercise);
+            table.add(50.0 + k, t + frac_years{e / 10.0L}, instrument_type::put, american_exercise);
+        }
+    }
+    qdplus_solver<autodiff_off> solve{mkt_params<long double>{100.0, 0.25, t, 0.05, 0.02}};
+    for (auto _: state) {
+        benchmark::DoNotOptimize(solve(table));
+    }
+    state.SetItemsProcessed(state.iterations() * table.size());
+}
+BENCHMARK(Benchmark_Chain_Table_QDPlus)->Unit(benchmark::kMicrosecond);
+
+//American chain of 10 strikes x 10 expiries x calls and puts on a 200 step CRR tree: a tree per contract, or the
+//lattice of each expiry shared by its strikes
+
+static instrument_table Chain_American_Table(datetime t) {
+    instrument_table table{t};
+    for (int e = 1; e <= 10; e++) {
+        for (int k = 0; k < 10; k++) {
+            table.add(80.0 + 4 * k, t + frac_years{e / 10.0L}, instrument_type::call, american_exercise);
+            table.add(80.0 + 4 * k, t + frac_years{e / 10.0L}, instrument_type::put, american_exercise);
+        }
+    }
+    return table;
+}
+
+static void Benchmark_Chain_Objects_CRR(benchmark::State& state) {
+    auto t = datetime::now();
+    mkt_params mktParams{100.0, 0.25, t, 0.05, 0.02};
+    auto table = Chain_American_Table(t);
+    std::vector<american_call> calls;
+    std::vector<american_put> puts;
+    for (std::size_t i = 0; i < table.size(); i += 2) {
+        calls.emplace_back(table.strike(i), t + frac_years{table.tau(i)});
+        puts.emplace_back(table.strike(i), t + frac_years{table.tau(i)});
+    }
+    crr_solver<autodiff_off> solve{mktParams, 200};
+    for (auto _: state) {
+        for (std::size_t i = 0; i < calls.size(); i++) {
+            benchmark::DoNotOptimize(solve(calls[i])->price());
+            benchmark::DoNotOptimize(solve(puts[i])->price());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * table.size());
+}
+BENCHMARK(Benchmark_Chain_Objects_CRR)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Chain_Table_CRR(benchmark::State& state) {
+    auto t = datetime::now();
+    mkt_params mktParams{100.0, 0.25, t, 0.05, 0.02};
+    auto table = Chain_American_Table(t);
+    crr_solver<autodiff_off> solve{mktParams, 200};
+    for (auto _: state) {
+        benchmark::DoNotOptimize(solve(table));
+    }
+    state.SetItemsProcessed(state.iterations() * table.size());
+}
+BENCHMARK(Benchmark_Chain_Table_CRR)->Unit(benchmark::kMillisecond);
+
+//Start-up of a universe of 64 underlyings x 50 strikes x 32 expiries x calls and puts (204800 contracts): parsed
+//from a CSV file into instrument tables, or memory mapped from a chain file, up to the columns the solvers read
+
+static std::vector<instrument_table> const& Universe_Tables(datetime t) {
+    static std::vector<instrument_table> tables = [t]() mutable {
+        std::vector<instrument_table> chains;
+        for (int u = 0; u < 64; u++) {
+            chains.emplace_back(t);
+            for (int e = 1; e <= 32; e++) {
+                for (int k = 0; k < 50; k++) {
+                    chains.back().add(75.0 + k, t + frac_years{e / 16.0L}, instrument_type::call, american_exercise);
+                    chains.back().add(75.0 + k, t + frac_years{e / 16.0L}, instrument_type::put, american_exercise);
+                }
+            }
+        }
+        std::ofstream csv{"universe.csv"};
+        csv << "underlying,strike,expiry,type,style\n";
+        for (int u = 0; u < 64; u++) {
+            auto const& chain = chains[u];
+            for (std::size_t i = 0; i < chain.size(); i++) {
+                csv << u << ',' << chain.strike(i) << ',' << chain.expiry_index().instants()[chain.expiry(i)] << ','
+                    << (chain.type(i) == instrument_type::call ? 'C' : 'P') << ',' << (chain.style(i) == american_exercise ? 'A' : 'E') << '\n';
+            }
+        }
+        std::vector<market_snapshot> markets(64, market_snapshot{100.0, 0.25, 0.05, 0.02});
+        chain_file::write("universe.bin", markets, chains);
+        return chains;
+    }();
+    return tables;
+}
+
+static void Benchmark_Startup_CSV(benchmark::State& state) {
+    auto t = datetime::now();
+    auto const& universe = Universe_Tables(t);
+    for (auto _: state) {
+        std::ifstream csv{"universe.csv"};
+        std::string line;
+        std::getline(csv, line);
+        std::vector<instrument_table> chains;
+        while (std::getline(csv, line)) {
+            char* end;
+            auto u = std::strtol(line.c_str(), &end, 10);
+            auto K = std::strtod(end + 1, &end);
+            auto expiry = std::strtoll(end + 1, &end, 10);
+            auto type = end[1] == 'C' ? instrument_type::call : instrument_type::put;
+            auto style = end[3] == 'A' ? american_exercise : european_exercise;
+            if (static_cast<std::size_t>(u) == chains.size()) {
+                chains.emplace_back(t);
+            }
+            chains[u].add(K, datetime{system_clock::time_point{system_clock::duration{expiry}}}, type, style);
+        }
+        benchmark::DoNotOptimize(chains.back().columns().strikes.data());
+    }
+    state.SetItemsProcessed(state.iterations() * universe.size() * universe[0].size());
+}
+BENCHMARK(Benchmark_Startup_CSV)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Startup_ChainFile(benchmark::State& state) {
+    auto t = datetime::now();
+    auto const& universe = Universe_Tables(t);
+    bool validated = state.range(0);
+    for (auto _: state) {
+        auto file = chain_file::open("universe.bin");
+        if (validated) {
+            benchmark::DoNotOptimize(file.validate());
+        }
+        double strikes = 0;
+        for (std::size_t u = 0; u < file.underlyings(); u++) {
+            strikes += file.columns(u).strike(0);
+        }
+        benchmark::DoNotOptimize(strikes);
+    }
+    state.SetItemsProcessed(state.iterations() * universe.size() * universe[0].size());
+}
+BENCHMARK(Benchmark_Startup_ChainFile)->DenseRange(0, 1)->Unit(benchmark::kMillisecond);
+
 BENCHMARK_MAIN();
\ No newline at end of file
@@ -5,24 +5,38 @@
 #include <vector>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 
 namespace bsm {
     template<typename T>
     class bintree {
 
     public:
-        explicit bintree(int steps) : steps_(steps), lattice(steps) {
+        explicit bintree(int steps) : steps_(steps), lattice(steps), first_(steps, 0) {
             for (int i = 0; i < steps; ++i) {
                 lattice[i].resize(i + 1);
             }
         }
 
+        /**
+         * Banded tree: row t only stores the nodes whose level t-2i is within [-width, width].
+         * Nodes outside the band are never allocated.
+         */
+        bintree(int steps, int width) : steps_(steps), lattice(steps), first_(steps, 0) {
+            for (int t = 0; t < steps; ++t) {
+                int first = std::max(0, (t - width + 1) / 2);
+                int last = std::min(t, (t + width) / 2);
+                first_[t] = first;
+                lattice[t].resize(last - first + 1);
+            }
+        }
+
         bintree(bintree const &copy) = default;
 
         T operator()(int t, int i) const {
             assert(("Invalid index t", t >= 0 and t < steps_));
-            assert(("Invalid index i", i >= 0 and i <= t));
-            return lattice[t][i];
+            assert(("Invalid index i", i >= first(t) and i <= last(t)));
+            return lattice[t][i - first_[t]];
         }
 
         auto operator()(int t) {
@@ -32,17 +46,25 @@ namespace bsm {
 
         void set(int t, int i, T value) {
             assert(("Invalid index t", t >= 0 and t < steps_));
-            assert(("Invalid index i", i >= 0 and i <= t));
-            lattice[t][i] = value;
+            assert(("Invalid index i", i >= first(t) and i <= last(t)));
+            lattice[t][i - first_[t]] = value;
         }
 
         int size() const { return steps_; }
 
+        //First and last node stored in row t
+        int first(int t) const { return first_[t]; }
+
+        int last(int t) const { return first_[t] + static_cast<int>(lattice[t].size()) - 1; }
+
+        bool contains(int t, int i) const { return i >= first(t) and i <= last(t); }
+
         T root() const { return lattice[0][0]; }
 
     private:
         int steps_;
         std::vector<std::vector<T>> lattice;
+        std::vector<int> first_;
     };
 
     template<typename T>
@@ -55,7 +77,7 @@ namespace bsm {
                 out << std::setw(4) << "\t";
             }
             tabs -= 1;
-            for (int i = 0; i <= t; ++i) {
+            for (int i = tree.first(t); i <= tree.last(t); ++i) {
                 T value = tree(t, i);
                 out << value << std::setw(4) << "\t";
             }
@@ -0,0 +1,69 @@
+#include "solver.h"
+#include "solver_quadrature_internals.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace bsm::internals;
+
+namespace bsm {
+
+    namespace {
+        //Cells of the monotone envelope per Chebyshev interval
+        constexpr int envelope_refinement = 8;
+    }
+
+    boundary_curve::boundary_curve(std::function<double(double)> const& boundary, double tau, instrument_type type, int n):
+            type{type}, tau_{tau}, B0{boundary(0.0)}, constant{true} {
+        //Expired, never exercised early (the boundary is 0 or infinity) or not an american option at all
+        if (tau <= 0 or n < 1 or not std::isfinite(B0) or B0 <= 0) {
+            return;
+        }
+        auto z = chebyshev_nodes(n);
+        std::vector<double> values(n + 1);
+        for (int i = 1; i <= n; i++) {
+            auto x = 0.5 * (1.0 + z[i]);
+            auto B = boundary(tau * x * x);
+            if (not std::isfinite(B) or B <= 0) {
+                return;
+            }
+            //A put boundary never rises above B0 nor a call one falls below it, lattice noise aside
+            auto log_ratio = type == instrument_type::put ? std::min(log(B / B0), 0.0) : std::max(log(B / B0), 0.0);
+            values[i] = log_ratio * log_ratio;
+        }
+        chebyshev_interpolation H{values};
+        coefficients = H.a;
+
+        int cells = envelope_refinement * n;
+        envelope.resize(cells + 1);
+        double running = 0;
+        for (int g = 0; g <= cells; g++) {
+            running = std::max(running, H(-1.0 + 2.0 * g / cells));
+            envelope[g] = running;
+        }
+        constant = false;
+    }
+
+    double boundary_curve::operator()(double _tau) const {
+        //At the maturity H is zero, but the rounding of the interpolation would come out of its square root
+        if (constant or _tau <= 0) {
+            return B0;
+        }
+        auto z = 2.0 * sqrt(std::clamp(_tau / tau_, 0.0, 1.0)) - 1.0;
+        //Clenshaw's recurrence
+        double b1 = 0, b2 = 0;
+        for (int k = coefficients.size() - 1; k >= 1; k--) {
+            double b0 = 2.0 * z * b1 - b2 + coefficients[k];
+            b2 = b1;
+            b1 = b0;
+        }
+        double H = z * b1 - b2 + coefficients[0];
+
+        int cells = envelope.size() - 1;
+        int g = std::min(static_cast<int>((z + 1.0) * 0.5 * cells), cells - 1);
+        H = std::clamp(H, envelope[g], envelope[g + 1]);
+        auto distance = sqrt(H);
+        return type == instrument_type::put ? B0 * exp(-distance) : B0 * exp(distance);
+    }
+
+}
@@ -4,8 +4,12 @@
 #include "common.h"
 #include "chrono.h"
 #include "instruments.h"
+#include "instrument_table.h"
+#include "chain_file.h"
+#include "market_context.h"
 
 #include "solver.h"
+#include "price_table.h"
 
 namespace bsm {
 
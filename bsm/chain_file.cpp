@@ -0,0 +1,282 @@
+#include "chain_file.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace bsm {
+
+    struct chain_file::header {
+        char magic[8];
+        std::uint32_t version;
+        //system_clock ticks per second of the writer, the unit of the instants
+        std::uint32_t ticks_per_second;
+        std::int64_t valuation;
+        std::uint64_t contracts;
+        std::uint64_t expiries;
+        std::uint64_t underlyings;
+        //offsets of the columns from the start of the file
+        std::uint64_t strikes;
+        std::uint64_t expiry;
+        std::uint64_t types;
+        std::uint64_t styles;
+        std::uint64_t instants;
+        std::uint64_t taus;
+        std::uint64_t ranges;
+        std::uint64_t file_size;
+    };
+
+    struct chain_file::underlying_range {
+        market_snapshot market;
+        std::uint64_t first;
+        std::uint64_t count;
+    };
+
+    namespace {
+
+        constexpr char chain_magic[8] = {'B', 'S', 'M', 'C', 'H', 'A', 'I', 'N'};
+        constexpr std::uint32_t chain_version = 1;
+        constexpr std::uint32_t ticks_per_second = system_clock::period::den / system_clock::period::num;
+
+        std::uint64_t round_up(std::uint64_t size, std::uint64_t alignment) {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+        //Lays the columns out one after the other from the end of the header
+        struct chain_layout {
+            std::uint64_t offset;
+
+            template<typename T>
+            std::uint64_t next(std::uint64_t count) {
+                auto start = round_up(offset, 64);
+                offset = start + count * sizeof(T);
+                return start;
+            }
+        };
+
+        template<typename T>
+        void write_at(std::ofstream& file, std::uint64_t offset, T const* data, std::uint64_t count) {
+            file.seekp(static_cast<std::streamoff>(offset));
+            file.write(reinterpret_cast<char const*>(data), static_cast<std::streamsize>(count * sizeof(T)));
+        }
+
+    }
+
+    void chain_file::write(std::string const& path, std::vector<market_snapshot> const& markets, std::vector<instrument_table> const& chains) {
+        assert(("A chain file needs a market per chain", markets.size() == chains.size()));
+        header h{};
+        std::memcpy(h.magic, chain_magic, sizeof(chain_magic));
+        h.version = chain_version;
+        h.ticks_per_second = ticks_per_second;
+        h.valuation = chains.empty() ? 0 : chains[0].expiry_index().valuation().instant.time_since_epoch().count();
+        h.underlyings = chains.size();
+
+        //The expiries of all the chains, merged by instant
+        std::vector<std::int64_t> instants;
+        std::vector<double> taus;
+        std::unordered_map<std::int64_t, std::int32_t> indices;
+        std::vector<std::vector<std::int32_t>> remap(chains.size());
+        for (std::size_t u = 0; u < chains.size(); u++) {
+            auto const& expiries = chains[u].expiry_index();
+            assert(("The chains of a file share the valuation instant", expiries.valuation().instant.time_since_epoch().count() == h.valuation));
+            for (int e = 0; e < expiries.size(); e++) {
+                auto [it, added] = indices.try_emplace(expiries.instants()[e], static_cast<std::int32_t>(instants.size()));
+                if (added) {
+                    instants.push_back(expiries.instants()[e]);
+                    taus.push_back(expiries.tau(e));
+                }
+                remap[u].push_back(it->second);
+            }
+            h.contracts += chains[u].size();
+        }
+        h.expiries = instants.size();
+
+        chain_layout layout{sizeof(header)};
+        h.strikes = layout.next<double>(h.contracts);
+        h.expiry = layout.next<std::int32_t>(h.contracts);
+        h.types = layout.next<std::uint8_t>(h.contracts);
+        h.styles = layout.next<std::uint8_t>(h.contracts);
+        h.instants = layout.next<std::int64_t>(h.expiries);
+        h.taus = layout.next<double>(h.expiries);
+        h.ranges = layout.next<underlying_range>(h.underlyings);
+        h.file_size = layout.offset;
+
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
+        write_at(file, 0, &h, 1);
+        std::uint64_t first = 0;
+        for (std::size_t u = 0; u < chains.size(); u++) {
+            auto columns = chains[u].columns();
+            auto n = columns.size();
+            std::vector<std::int32_t> expiry(n);
+            std::transform(columns.expiries.begin(), columns.expiries.end(), expiry.begin(), [&remap, u](std::int32_t e) {
+                return remap[u][e];
+            });
+            write_at(file, h.strikes + first * sizeof(double), columns.strikes.data(), n);
+            write_at(file, h.expiry + first * sizeof(std::int32_t), expiry.data(), n);
+            write_at(file, h.types + first, columns.types.data(), n);
+            write_at(file, h.styles + first, columns.styles.data(), n);
+            underlying_range range{markets[u], first, n};
+            write_at(file, h.ranges + u * sizeof(underlying_range), &range, 1);
+            first += n;
+        }
+        write_at(file, h.instants, instants.data(), h.expiries);
+        write_at(file, h.taus, taus.data(), h.expiries);
+        //Pads the file to its full size
+        file.seekp(static_cast<std::streamoff>(h.file_size - 1));
+        file.put(0);
+        if (not file) {
+            throw std::runtime_error("Cannot write chain file " + path);
+        }
+    }
+
+    chain_file chain_file::open(std::string const& path) {
+        chain_file chain;
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open chain file " + path);
+        }
+        struct stat st{};
+        if (fstat(fd, &st) != 0 or static_cast<std::size_t>(st.st_size) < sizeof(header)) {
+            ::close(fd);
+            throw std::runtime_error("Invalid chain file " + path);
+        }
+        std::size_t size = st.st_size;
+        void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            throw std::runtime_error("Cannot map chain file " + path);
+        }
+        std::shared_ptr<const void> storage{address, [size](const void* p) { munmap(const_cast<void*>(p), size); }};
+#else
+        std::ifstream file{path, std::ios::binary | std::ios::ate};
+        if (not file) {
+            throw std::runtime_error("Cannot open chain file " + path);
+        }
+        std::size_t size = file.tellg();
+        auto buffer = std::make_shared<std::vector<double>>((size + sizeof(double) - 1) / sizeof(double));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(buffer->data()), size);
+        std::shared_ptr<const void> storage{buffer, buffer->data()};
+#endif
+        auto const* h = static_cast<header const*>(storage.get());
+        auto fits = [h, size](std::uint64_t offset, std::uint64_t count, std::uint64_t bytes) {
+            return offset % 64 == 0 and offset >= sizeof(header) and offset <= size and count <= (size - offset) / bytes;
+        };
+        if (size < sizeof(header) or std::memcmp(h->magic, chain_magic, sizeof(chain_magic)) != 0 or h->version != chain_version
+            or h->ticks_per_second != ticks_per_second or h->file_size > size
+            or not fits(h->strikes, h->contracts, sizeof(double)) or not fits(h->expiry, h->contracts, sizeof(std::int32_t))
+            or not fits(h->types, h->contracts, 1) or not fits(h->styles, h->contracts, 1)
+            or not fits(h->instants, h->expiries, sizeof(std::int64_t)) or not fits(h->taus, h->expiries, sizeof(double))
+            or not fits(h->ranges, h->underlyings, sizeof(underlying_range))) {
+            throw std::runtime_error("Invalid chain file " + path);
+        }
+        chain.storage = std::move(storage);
+        chain.header_ = h;
+        chain.size_ = size;
+        return chain;
+    }
+
+    std::vector<std::string> chain_file::validate() const {
+        std::vector<std::string> problems;
+        auto all = columns();
+        auto report = [&problems](std::string const& problem, std::size_t row) {
+            problems.push_back(problem + " at contract " + std::to_string(row));
+        };
+        for (std::size_t row = 0; row < all.size(); row++) {
+            if (not std::isfinite(all.strikes[row]) or all.strikes[row] <= 0) {
+                report("Invalid strike", row);
+            }
+            if (all.expiries[row] < 0 or static_cast<std::uint64_t>(all.expiries[row]) >= header_->expiries) {
+                report("Expiry index out of range", row);
+            }
+            if (all.types[row] > instrument_type::put) {
+                report("Invalid instrument type", row);
+            }
+            if (all.styles[row] > american_exercise) {
+                report("Invalid exercise style", row);
+            }
+        }
+        for (std::size_t e = 0; e < all.taus.size(); e++) {
+            if (not std::isfinite(all.taus[e]) or all.taus[e] < 0) {
+                problems.push_back("Invalid year fraction at expiry " + std::to_string(e));
+            }
+        }
+        std::uint64_t next = 0;
+        for (std::size_t u = 0; u < underlyings(); u++) {
+            auto const& range = ranges()[u];
+            auto const& m = range.market;
+            auto at = " of underlying " + std::to_string(u);
+            if (range.first != next or range.count > header_->contracts - range.first) {
+                problems.push_back("Contracts out of range" + at);
+            }
+            next = range.first + range.count;
+            if (not (std::isfinite(m.S) and m.S > 0 and std::isfinite(m.sigma) and m.sigma > 0 and std::isfinite(m.r) and std::isfinite(m.q))) {
+                problems.push_back("Invalid market" + at);
+            }
+        }
+        if (next != header_->contracts) {
+            problems.push_back("Contracts not covered by the underlyings");
+        }
+        return problems;
+    }
+
+    template<typename T>
+    std::span<const T> chain_file::column(std::uint64_t offset, std::uint64_t count) const {
+        return {reinterpret_cast<T const*>(static_cast<char const*>(storage.get()) + offset), count};
+    }
+
+    std::span<const chain_file::underlying_range> chain_file::ranges() const {
+        return column<underlying_range>(header_->ranges, header_->underlyings);
+    }
+
+    datetime chain_file::valuation() const {
+        return datetime{system_clock::time_point{system_clock::duration{header_->valuation}}};
+    }
+
+    std::size_t chain_file::size() const {
+        return header_->contracts;
+    }
+
+    std::size_t chain_file::underlyings() const {
+        return header_->underlyings;
+    }
+
+    market_snapshot const& chain_file::market(std::size_t underlying) const {
+        return ranges()[underlying].market;
+    }
+
+    mkt_params<double> chain_file::market_params(std::size_t underlying) const {
+        auto const& m = market(underlying);
+        return {m.S, m.sigma, valuation(), m.r, m.q};
+    }
+
+    instrument_columns chain_file::columns() const {
+        auto n = header_->contracts;
+        return {column<double>(header_->strikes, n), column<std::int32_t>(header_->expiry, n), column<std::uint8_t>(header_->types, n),
+                column<std::uint8_t>(header_->styles, n), column<double>(header_->taus, header_->expiries)};
+    }
+
+    instrument_columns chain_file::columns(std::size_t underlying) const {
+        auto const& range = ranges()[underlying];
+        auto all = columns();
+        return {all.strikes.subspan(range.first, range.count), all.expiries.subspan(range.first, range.count),
+                all.types.subspan(range.first, range.count), all.styles.subspan(range.first, range.count), all.taus};
+    }
+
+    std::span<const std::int64_t> chain_file::expiry_instants() const {
+        return column<std::int64_t>(header_->instants, header_->expiries);
+    }
+
+}
@@ -0,0 +1,75 @@
+#ifndef BSM_CHAIN_FILE_H
+#define BSM_CHAIN_FILE_H
+
+#include "common.h"
+#include "instrument_table.h"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace bsm {
+
+    //Market parameters of an underlying at the valuation instant of a chain file
+    struct market_snapshot {
+        double S;
+        double sigma;
+        double r;
+        double q;
+    };
+
+    /**
+     * Binary file of an option universe: the contracts of several underlyings, stored by columns as in an
+     * instrument_table, and the market snapshot of each underlying. The contracts of an underlying are contiguous,
+     * every column starts on a 64 byte boundary and the expiries (instants and year fractions) are shared by the
+     * whole file, so once the file is memory mapped the columns of an underlying are handed to the batch solvers in
+     * place: nothing is parsed, copied or allocated per contract.
+     * The layout is native (same endianness and doubles as the writer) and versioned. open() checks the header and
+     * the extent of the columns in O(1); validate() checks every value, for files that don't come from write().
+     * Columns returned by a chain_file are valid while it, or one of its copies, is alive.
+     */
+    class chain_file {
+    public:
+        //chains[u] holds the contracts of the underlying of markets[u]; all of them must have the same valuation
+        static void write(std::string const& path, std::vector<market_snapshot> const& markets, std::vector<instrument_table> const& chains);
+
+        static chain_file open(std::string const& path);
+
+        //Every problem found in the contents, empty for a valid file
+        std::vector<std::string> validate() const;
+
+        datetime valuation() const;
+
+        std::size_t size() const;
+
+        std::size_t underlyings() const;
+
+        market_snapshot const& market(std::size_t underlying) const;
+
+        mkt_params<double> market_params(std::size_t underlying) const;
+
+        //Contracts of an underlying, or of the whole file
+        instrument_columns columns(std::size_t underlying) const;
+        instrument_columns columns() const;
+
+        //Expiries as system_clock ticks since the epoch
+        std::span<const std::int64_t> expiry_instants() const;
+
+    private:
+        struct header;
+        struct underlying_range;
+        std::shared_ptr<const void> storage;
+        header const* header_ = nullptr;
+        std::size_t size_ = 0;
+
+        chain_file() = default;
+        template<typename T>
+        std::span<const T> column(std::uint64_t offset, std::uint64_t count) const;
+        std::span<const underlying_range> ranges() const;
+    };
+
+}
+
+#endif //BSM_CHAIN_FILE_H
@@ -1,10 +1,102 @@
 #include "chrono.h"
 
+#include <cassert>
+#include <algorithm>
+
 namespace bsm::chrono {
     using namespace bsm::chrono;
-    frac_years time_between(datetime const &initial, datetime const &final) {
-        auto dur = final - initial;
-        return duration_cast<frac_years>(dur);
+
+    std::vector<double> year_fractions(datetime const& initial, std::vector<datetime> const& finals) {
+        std::vector<double> taus(finals.size());
+        std::transform(finals.begin(), finals.end(), taus.begin(), [&initial](datetime const& final) {
+            return static_cast<double>(time_between(initial, final).count());
+        });
+        return taus;
+    }
+
+    calendar::calendar(year_month_day const& first, year_month_day const& last, std::vector<year_month_day> const& holidays,
+                       double non_business_weight, double days_per_year, std::vector<weekday> const& weekend):
+            first_{first}, days_{static_cast<int>((sys_days{last} - sys_days{first}).count()) + 1},
+            business_((days_ + 63) / 64, 0), business_before_(days_ + 1), time_before_(days_ + 1),
+            non_business_weight_{non_business_weight}, days_per_year_{days_per_year} {
+        assert(("A calendar needs first <= last", days_ >= 1));
+        for (int d = 0; d < days_; d++) {
+            auto wd = weekday{first_ + days{d}};
+            if (std::find(weekend.begin(), weekend.end(), wd) == weekend.end()) {
+                business_[d / 64] |= std::uint64_t{1} << (d % 64);
+            }
+        }
+        for (auto const& holiday: holidays) {
+            auto d = (sys_days{holiday} - first_).count();
+            if (d >= 0 and d < days_) {
+                business_[d / 64] &= ~(std::uint64_t{1} << (d % 64));
+            }
+        }
+        for (int d = 0; d < days_; d++) {
+            bool business = (business_[d / 64] >> (d % 64)) & 1;
+            business_before_[d + 1] = business_before_[d] + business;
+            time_before_[d + 1] = time_before_[d] + weight(d);
+        }
+    }
+
+    int calendar::day(sys_days const& date) const {
+        auto d = static_cast<int>((date - first_).count());
+        assert(("Date out of the calendar", d >= 0 and d <= days_));
+        return d;
+    }
+
+    double calendar::weight(int d) const {
+        return (business_[d / 64] >> (d % 64)) & 1 ? 1.0 : non_business_weight_;
+    }
+
+    double calendar::trading_days(datetime const& instant) const {
+        auto date = floor<days>(instant.instant);
+        auto d = day(date);
+        if (d == days_) {
+            return time_before_[d];
+        }
+        auto elapsed = duration<double, days::period>(instant.instant - date).count();
+        return time_before_[d] + weight(d) * elapsed;
+    }
+
+    bool calendar::is_business_day(sys_days const& date) const {
+        auto d = day(date);
+        return d < days_ and (business_[d / 64] >> (d % 64)) & 1;
+    }
+
+    int calendar::business_days_between(sys_days const& from, sys_days const& to) const {
+        return business_before_[day(to)] - business_before_[day(from)];
+    }
+
+    double calendar::year_fraction(datetime const& from, datetime const& to) const {
+        return (trading_days(to) - trading_days(from)) / days_per_year_;
+    }
+
+    std::vector<double> calendar::year_fractions(datetime const& from, std::vector<datetime> const& to) const {
+        auto start = trading_days(from);
+        std::vector<double> taus(to.size());
+        std::transform(to.begin(), to.end(), taus.begin(), [this, start](datetime const& instant) {
+            return (trading_days(instant) - start) / days_per_year_;
+        });
+        return taus;
+    }
+
+    int expiry_table::index(datetime const& expiry) {
+        auto instant = expiry.instant.time_since_epoch().count();
+        auto [it, added] = indices_.try_emplace(instant, size());
+        if (added) {
+            instants_.push_back(instant);
+            taus_.push_back(calendar_ ? calendar_->year_fraction(valuation_, expiry) : static_cast<double>(time_between(valuation_, expiry).count()));
+        }
+        return it->second;
+    }
+
+    std::vector<int> expiry_table::indices(std::vector<datetime> const& expiries) {
+        std::vector<int> result(expiries.size());
+        std::transform(expiries.begin(), expiries.end(), result.begin(), [this](datetime const& expiry) {
+            return index(expiry);
+        });
+        return result;
     }
 
 }
@@ -3,6 +3,9 @@
 
 #include <concepts>
 #include <chrono>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
 #include <vector>
 #include <iostream>
 #include <ratio>
@@ -62,28 +65,93 @@ namespace bsm::chrono {
 
     using datetime = datetime2;
 
-    frac_years time_between(datetime const& initial, datetime const& final);
-
-//    auto time_between(datetime const& initial, datetime const& final) {
-//        auto dur = final - initial;
-//        return duration_cast<frac_years>(dur);
-//    }
-
-//    class calendar {
-//        std::vector<std::chrono::year_month_day> holidays;
-//    public:
-//        int business_days_between() const {
-//            return 0;
-//        }
-//        bool isBusinessDay(std::chrono::year_month_day ymd)
-//        {
-//            std::chrono::sys_days sd = ymd;
-//            std::chrono::weekday wd = sd;
-//            if (wd == std::chrono::Saturday || wd == std::chrono::Sunday)  // weekend
-//                return false;
-//            return true;
-//        }
-//    };
+    /**
+     * Actual time between two instants in years of 365.2425 days. The difference of the time points is scaled by a
+     * constant, one multiplication instead of the long double division of a duration_cast.
+     */
+    inline frac_years time_between(datetime const& initial, datetime const& final) {
+        constexpr long double years_per_tick = static_cast<long double>(system_clock::period::num) / system_clock::period::den / frac_years::period::num;
+        return frac_years{(final.instant - initial.instant).count() * years_per_tick};
+    }
+
+    //Year fractions from one instant to many, as time_between
+    std::vector<double> year_fractions(datetime const& initial, std::vector<datetime> const& finals);
+
+    /**
+     * Business day calendar over the days [first, last]. Each day is a bit of a bitset, set on business days (not a
+     * weekend day nor a holiday), and the prefix sums of the business days and of the day weights are precomputed,
+     * so counts and year fractions are O(1) differences. The weights define a trading time (vol) clock: a business
+     * day weighs 1 and any other day non_business_weight, and a year is days_per_year of weight. With the defaults
+     * (0 and 252) the year fraction is business/252; a positive weight lets weekends and holidays carry some variance.
+     */
+    class calendar {
+        sys_days first_;
+        int days_;
+        std::vector<std::uint64_t> business_;
+        std::vector<int> business_before_;
+        std::vector<double> time_before_;
+        double non_business_weight_;
+        double days_per_year_;
+
+        int day(sys_days const& date) const;
+        double weight(int day) const;
+        //Trading time from the start of the calendar to an instant, in days of weight
+        double trading_days(datetime const& instant) const;
+    public:
+        calendar(year_month_day const& first, year_month_day const& last, std::vector<year_month_day> const& holidays,
+                 double non_business_weight = 0.0, double days_per_year = 252.0, std::vector<weekday> const& weekend = {Saturday, Sunday});
+
+        bool is_business_day(sys_days const& date) const;
+        //Business days in [from, to)
+        int business_days_between(sys_days const& from, sys_days const& to) const;
+        //Trading time between two instants in years, the elapsed part of a day weighted as the day
+        double year_fraction(datetime const& from, datetime const& to) const;
+        std::vector<double> year_fractions(datetime const& from, std::vector<datetime> const& to) const;
+    };
+
+    /**
+     * Expiries of the instruments of a chain seen from a valuation instant. Each distinct expiry gets an index, the
+     * position of its year fraction (actual, or on the trading time of a calendar) computed once and shared by all
+     * the instruments of that expiry.
+     */
+    class expiry_table {
+        datetime valuation_;
+        calendar const* calendar_;
+        std::vector<std::int64_t> instants_;
+        std::vector<double> taus_;
+        std::unordered_map<std::int64_t, int> indices_;
+    public:
+        explicit expiry_table(datetime const& valuation, calendar const* cal = nullptr): valuation_{valuation}, calendar_{cal} {}
+
+        //Index of an expiry, added on first use
+        int index(datetime const& expiry);
+        std::vector<int> indices(std::vector<datetime> const& expiries);
+
+        double tau(int index) const {
+            return taus_[index];
+        }
+
+        double tau(datetime const& expiry) {
+            return taus_[index(expiry)];
+        }
+
+        //Year fractions, and expiries as system_clock ticks since the epoch, by index
+        std::span<const double> taus() const {
+            return taus_;
+        }
+
+        std::span<const std::int64_t> instants() const {
+            return instants_;
+        }
+
+        int size() const {
+            return static_cast<int>(taus_.size());
+        }
+
+        datetime const& valuation() const {
+            return valuation_;
+        }
+    };
 }
 
 
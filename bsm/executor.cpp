@@ -0,0 +1,127 @@
+#include "executor.h"
+
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace bsm {
+
+    namespace {
+
+        std::mutex executor_mutex;
+        executor_config configuration;
+        std::unique_ptr<tf::Executor> executor;
+
+        //Parses a cpulist such as "0-3,8-11"
+        std::vector<int> parse_cpu_list(std::string const& list) {
+            std::vector<int> cpus;
+            std::stringstream ss{list};
+            std::string range;
+            while (std::getline(ss, range, ',')) {
+                auto dash = range.find('-');
+                int first = std::stoi(range.substr(0, dash));
+                int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for (int cpu = first; cpu <= last; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+
+        std::vector<int> allowed_cpus(executor_config const& config) {
+            std::vector<int> cpus;
+            if (config.numa_node >= 0) {
+                std::ifstream file{"/sys/devices/system/node/node" + std::to_string(config.numa_node) + "/cpulist"};
+                std::string list;
+                if (file and std::getline(file, list) and not list.empty()) {
+                    cpus = parse_cpu_list(list);
+                }
+            }
+            if (cpus.empty()) {
+                for (int cpu = 0; cpu < static_cast<int>(std::thread::hardware_concurrency()); ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+
+        /**
+         * Sets the affinity of each worker the first time it runs a task. Memory first touched by a worker is then
+         * allocated on its NUMA node by the kernel.
+         */
+        class affinity_observer: public tf::ObserverInterface {
+            std::vector<int> cpus;
+            bool pin;
+        public:
+            affinity_observer(std::vector<int> cpus, bool pin): cpus{std::move(cpus)}, pin{pin} {}
+
+            void set_up(size_t) override {}
+
+            void on_entry(tf::WorkerView wv, tf::TaskView) override {
+                thread_local bool placed = false;
+                if (placed) {
+                    return;
+                }
+                placed = true;
+#ifdef __linux__
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                if (pin) {
+                    CPU_SET(cpus[wv.id() % cpus.size()], &set);
+                } else {
+                    for (auto cpu: cpus) {
+                        CPU_SET(cpu, &set);
+                    }
+                }
+                pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+            }
+
+            void on_exit(tf::WorkerView, tf::TaskView) override {}
+        };
+
+    }
+
+    bool configure_executor(executor_config const& config) {
+        std::lock_guard lock{executor_mutex};
+        if (executor) {
+            return false;
+        }
+        configuration = config;
+        return true;
+    }
+
+    executor_config executor_configuration() {
+        std::lock_guard lock{executor_mutex};
+        return configuration;
+    }
+
+    tf::Executor& shared_executor() {
+        static tf::Executor& instance = [] () -> tf::Executor& {
+            std::lock_guard lock{executor_mutex};
+            executor = std::make_unique<tf::Executor>(std::max<std::size_t>(1, configuration.threads));
+            if (configuration.pin_threads or configuration.numa_node >= 0) {
+                executor->make_observer<affinity_observer>(allowed_cpus(configuration), configuration.pin_threads);
+            }
+            return *executor;
+        }();
+        return instance;
+    }
+
+    void run_and_wait(tf::Taskflow& taskflow) {
+        auto& executor = shared_executor();
+        if (executor.this_worker_id() < 0) {
+            executor.run(taskflow).wait();
+        } else {
+            executor.corun(taskflow);
+        }
+    }
+
+}
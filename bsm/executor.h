@@ -0,0 +1,64 @@
+#ifndef BSM_EXECUTOR_H
+#define BSM_EXECUTOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include <taskflow/taskflow.hpp>
+
+namespace bsm {
+
+    struct executor_config {
+        //Number of worker threads
+        std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        //Pin each worker to a single CPU (round robin over the allowed CPUs)
+        bool pin_threads = false;
+        //Restrict the workers to the CPUs of this NUMA node, -1 for no restriction (Linux only)
+        int numa_node = -1;
+    };
+
+    /**
+     * Configures the library-wide executor. It only has an effect before the executor is first used, it returns
+     * false (and leaves the configuration untouched) otherwise.
+     */
+    bool configure_executor(executor_config const& config);
+
+    executor_config executor_configuration();
+
+    /**
+     * Library-wide Taskflow executor. All solvers submit their parallel work to it, so workers are started once and
+     * concurrent pricing calls share the same set of threads.
+     */
+    tf::Executor& shared_executor();
+
+    /**
+     * Runs a taskflow on the shared executor and waits for it. When called from one of its workers (a nested pricing
+     * call) the worker coruns the taskflow: it keeps executing tasks while it waits, so it never blocks on tasks
+     * queued behind itself and no thread is started besides the workers.
+     */
+    void run_and_wait(tf::Taskflow& taskflow);
+
+    /**
+     * Parallel loop over [first, last) on the shared executor, through run_and_wait. Small ranges, and loops issued
+     * from inside a worker (whose enclosing loop is already spread over the workers), run inline on the calling thread.
+     */
+    template<typename F>
+    void parallel_for(int first, int last, F const& f, int grain = 512) {
+        if (last - first <= grain or shared_executor().this_worker_id() >= 0) {
+            for (int i = first; i < last; ++i) {
+                f(i);
+            }
+            return;
+        }
+        tf::Taskflow taskflow;
+        taskflow.for_each_index(first, last, 1, [&f](int i) {
+            f(i);
+        });
+        run_and_wait(taskflow);
+    }
+
+}
+
+#endif //BSM_EXECUTOR_H
@@ -0,0 +1,28 @@
+#include "instrument_table.h"
+
+namespace bsm {
+
+    void instrument_table::reserve(std::size_t contracts) {
+        strikes_.reserve(contracts);
+        expiry_.reserve(contracts);
+        types_.reserve(contracts);
+        styles_.reserve(contracts);
+    }
+
+    std::size_t instrument_table::add(double K, datetime const& maturity, instrument_type type, exercise_style style) {
+        strikes_.push_back(K);
+        expiry_.push_back(expiries_.index(maturity));
+        types_.push_back(static_cast<std::uint8_t>(type));
+        styles_.push_back(style);
+        return strikes_.size() - 1;
+    }
+
+    std::size_t instrument_table::add(european const& instrument) {
+        return add(static_cast<double>(instrument.K), instrument.maturity, instrument.type, european_exercise);
+    }
+
+    std::size_t instrument_table::add(american const& instrument) {
+        return add(static_cast<double>(instrument.K), instrument.maturity, instrument.type, american_exercise);
+    }
+
+}
@@ -0,0 +1,131 @@
+#ifndef BSM_INSTRUMENT_TABLE_H
+#define BSM_INSTRUMENT_TABLE_H
+
+#include "chrono.h"
+#include "instruments.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace bsm {
+
+    enum exercise_style : std::uint8_t {
+        european_exercise, american_exercise
+    };
+
+    /**
+     * Read-only view of the columns of a chain, where the batch solvers read it: instrument_table and the memory
+     * mapped chain_file both provide one. taus holds the year fraction of each expiry index.
+     */
+    struct instrument_columns {
+        std::span<const double> strikes;
+        std::span<const std::int32_t> expiries;
+        std::span<const std::uint8_t> types;
+        std::span<const std::uint8_t> styles;
+        std::span<const double> taus;
+
+        std::size_t size() const {
+            return strikes.size();
+        }
+
+        double strike(std::size_t row) const {
+            return strikes[row];
+        }
+
+        double tau(std::size_t row) const {
+            return taus[expiries[row]];
+        }
+
+        instrument_type type(std::size_t row) const {
+            return static_cast<instrument_type>(types[row]);
+        }
+
+        exercise_style style(std::size_t row) const {
+            return static_cast<exercise_style>(styles[row]);
+        }
+    };
+
+    /**
+     * Options stored by columns: a double strike, the int32 index of the expiry in an expiry_table (which holds the
+     * year fraction of each distinct expiry once) and one byte each for the type and the exercise style, 14 bytes
+     * per contract against the 48 of an instrument object (long double strike, time point, type and vtable). The
+     * columns are plain arrays, so a chain can be filtered, sorted or handed to a batch solver without building an
+     * object per contract.
+     */
+    class instrument_table {
+        expiry_table expiries_;
+        std::vector<double> strikes_;
+        std::vector<std::int32_t> expiry_;
+        std::vector<std::uint8_t> types_;
+        std::vector<std::uint8_t> styles_;
+    public:
+        static constexpr std::size_t bytes_per_contract = sizeof(double) + sizeof(std::int32_t) + 2 * sizeof(std::uint8_t);
+
+        //The year fractions are taken from the valuation instant, on the trading time of cal if given
+        explicit instrument_table(datetime const& valuation, calendar const* cal = nullptr): expiries_{valuation, cal} {}
+
+        void reserve(std::size_t contracts);
+
+        //Adds a contract and returns its row
+        std::size_t add(double K, datetime const& maturity, instrument_type type, exercise_style style);
+        std::size_t add(european const& instrument);
+        std::size_t add(american const& instrument);
+
+        std::size_t size() const {
+            return strikes_.size();
+        }
+
+        double strike(std::size_t row) const {
+            return strikes_[row];
+        }
+
+        double tau(std::size_t row) const {
+            return expiries_.tau(expiry_[row]);
+        }
+
+        int expiry(std::size_t row) const {
+            return expiry_[row];
+        }
+
+        instrument_type type(std::size_t row) const {
+            return static_cast<instrument_type>(types_[row]);
+        }
+
+        exercise_style style(std::size_t row) const {
+            return static_cast<exercise_style>(styles_[row]);
+        }
+
+        std::span<const double> strikes() const {
+            return strikes_;
+        }
+
+        std::span<const std::int32_t> expiries() const {
+            return expiry_;
+        }
+
+        std::span<const std::uint8_t> types() const {
+            return types_;
+        }
+
+        std::span<const std::uint8_t> styles() const {
+            return styles_;
+        }
+
+        expiry_table const& expiry_index() const {
+            return expiries_;
+        }
+
+        instrument_columns columns() const {
+            return {strikes_, expiry_, types_, styles_, expiries_.taus()};
+        }
+
+        operator instrument_columns() const {
+            return columns();
+        }
+    };
+
+}
+
+#endif //BSM_INSTRUMENT_TABLE_H
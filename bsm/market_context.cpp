@@ -0,0 +1,17 @@
+#include "market_context.h"
+
+#include <cmath>
+
+namespace bsm {
+
+    market_context::market_context(mkt_params<double> const& mkt, std::span<const double> taus):
+            S_{mkt.S}, sigma_{mkt.sigma}, r_{mkt.r}, q_{mkt.q}, expiries_(taus.size()) {
+        for (std::size_t e = 0; e < taus.size(); e++) {
+            auto tau = taus[e];
+            auto df_r = std::exp(-r_ * tau);
+            auto df_q = std::exp(-q_ * tau);
+            expiries_[e] = {tau, df_r, df_q, S_ * df_q / df_r, sigma_ * std::sqrt(tau)};
+        }
+    }
+
+}
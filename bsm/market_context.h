@@ -0,0 +1,64 @@
+#ifndef BSM_MARKET_CONTEXT_H
+#define BSM_MARKET_CONTEXT_H
+
+#include "common.h"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace bsm {
+
+    //Market of an underlying at one expiry, shared by every strike of the expiry
+    struct expiry_market {
+        double tau;
+        //exp(-r tau) and exp(-q tau)
+        double df_r;
+        double df_q;
+        //S exp((r - q) tau)
+        double forward;
+        //sigma sqrt(tau)
+        double v;
+    };
+
+    /**
+     * Market of an underlying at each expiry of a chain, indexed like the expiries of its columns. The discount
+     * factors, the forward and sigma sqrt(tau) are computed once per (underlying, expiry), so the batch solvers
+     * price a contract from its strike with one log and two cdf, instead of the exp, log and sqrt of a pricing<T>.
+     * A context is built from the taus of a chain and can be reused for every chain sharing them (the chains of an
+     * underlying in a chain_file, a chain priced again after a move of the strikes).
+     */
+    class market_context {
+        double S_, sigma_, r_, q_;
+        std::vector<expiry_market> expiries_;
+    public:
+        market_context(mkt_params<double> const& mkt, std::span<const double> taus);
+
+        double S() const {
+            return S_;
+        }
+
+        double sigma() const {
+            return sigma_;
+        }
+
+        double r() const {
+            return r_;
+        }
+
+        double q() const {
+            return q_;
+        }
+
+        std::size_t size() const {
+            return expiries_.size();
+        }
+
+        expiry_market const& operator[](std::size_t expiry) const {
+            return expiries_[expiry];
+        }
+    };
+
+}
+
+#endif //BSM_MARKET_CONTEXT_H
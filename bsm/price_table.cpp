@@ -0,0 +1,518 @@
+#include "price_table.h"
+#include "solver_fastamerican_internals.h"
+#include "solver_analytical_internals.h"
+#include "solver_quadrature_internals.h"
+#include "executor.h"
+
+#include <vector>
+#include <random>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace bsm::internals;
+
+namespace bsm {
+
+    struct american_price_table::header {
+        char magic[8];
+        std::uint32_t version;
+        std::int32_t type;
+        double lower[price_table_domain::dimensions];
+        double upper[price_table_domain::dimensions];
+        std::int32_t nodes[price_table_domain::dimensions];
+        std::int32_t l, m, n;
+        std::int32_t error_samples;
+        double error_price;
+        double error_delta;
+        //nodes of the table, and slices (nodes of the sqrt(tau), sigma, r and q dimensions)
+        std::uint64_t count;
+        std::uint64_t slices;
+        //offset of the values from the start of the file
+        std::uint64_t data_offset;
+    };
+
+    namespace {
+
+        constexpr char table_magic[8] = {'B', 'S', 'M', 'A', 'P', 'T', 'B', 'L'};
+        constexpr std::uint32_t table_version = 1;
+        constexpr int D = price_table_domain::dimensions;
+
+        //Price, delta and gamma of the option of strike 1
+        struct normalized {
+            double price;
+            double delta;
+            double gamma;
+        };
+
+        /**
+         * Spectral collocation solve of the option of strike 1 for one (tau, sigma, r, q). Calls are priced as the
+         * put with the rates swapped: C(S, 1, r, q) = S P(1/S, 1, q, r).
+         */
+        struct slice_solver {
+            const instrument_type type;
+            const alo_put_engine put;
+
+            slice_solver(instrument_type type, double tau, double sigma, double r, double q, price_table_settings const& s):
+                    type{type}, put{1.0, sigma, type == instrument_type::put ? r : q, type == instrument_type::put ? q : r, tau, s.l, s.m, s.n} {}
+
+            //ln(B/K) of the exercise boundary, -inf or +inf when never exercised early
+            double log_boundary() const {
+                auto B = put.boundary(put.tau);
+                return type == instrument_type::put ? log(B) : -log(B);
+            }
+
+            normalized operator()(double x) const {
+                auto S = exp(x);
+                if (type == instrument_type::put) {
+                    return {put.price(S), put.delta(S), put.gamma(S)};
+                }
+                auto y = 1.0 / S;
+                auto P = put.price(y);
+                return {S * P, P - put.delta(y) / S, put.gamma(y) / (S * S * S)};
+            }
+        };
+
+        //Black-Scholes price and greeks of the european option of strike 1
+        price_table_greeks black_scholes(instrument_type type, double x, double tau, double sigma, double r, double q) {
+            pricing<double> p{exp(x), 1.0, sigma, tau, r, q};
+            auto d1 = calculate_d1(p);
+            auto d2 = calculate_d2(p);
+            auto sign = type == instrument_type::put ? -1.0 : 1.0;
+            return {type == instrument_type::put ? calculate_european_put(p) : calculate_european_call(p),
+                    sign * exp(-q * tau) * cdf<double>(sign * d1),
+                    calculate_gamma(p),
+                    calculate_theta(p, sign),
+                    calculate_vega(p),
+                    sign * tau * exp(-r * tau) * cdf<double>(sign * d2),
+                    -sign * tau * p.S * exp(-q * tau) * cdf<double>(sign * d1)};
+        }
+
+        //Greeks of the option of strike 1 straight from the solver, for the points outside the domain
+        price_table_greeks solve_greeks(instrument_type type, double x, double tau, double sigma, double r, double q,
+                                        price_table_settings const& s) {
+            constexpr double h = 1e-4;
+            auto price = [&](double _tau, double _sigma, double _r, double _q) {
+                return slice_solver{type, _tau, _sigma, _r, _q, s}(x).price;
+            };
+            auto v = slice_solver{type, tau, sigma, r, q, s}(x);
+            auto dt = std::min(h, 0.5 * tau);
+            return {v.price, v.delta, v.gamma,
+                    dt > 0 ? -(price(tau + dt, sigma, r, q) - price(tau - dt, sigma, r, q)) / (2.0 * dt) : 0.0,
+                    (price(tau, sigma + h, r, q) - price(tau, sigma - h, r, q)) / (2.0 * h),
+                    (price(tau, sigma, r + h, q) - price(tau, sigma, r - h, q)) / (2.0 * h),
+                    (price(tau, sigma, r, q + h) - price(tau, sigma, r, q - h)) / (2.0 * h)};
+        }
+
+        std::size_t round_up(std::size_t size, std::size_t alignment) {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+        std::size_t data_size(std::size_t count, std::size_t slices) {
+            return (3 * count + slices) * sizeof(double);
+        }
+
+        /**
+         * Lagrange weights of the nodes z[0..P) at x, and of the derivative at x. inverse[j * stride + m] holds
+         * 1/(z[j] - z[m]).
+         */
+        void lagrange_weights(double const* z, double const* inverse, int stride, int P, double x, double* w, double* dw) {
+            for (int j = 0; j < P; j++) {
+                double weight = 1.0, derivative = 0.0;
+                for (int m = 0; m < P; m++) {
+                    if (m == j) {
+                        continue;
+                    }
+                    auto factor = inverse[j * stride + m];
+                    derivative = (derivative * (x - z[m]) + weight) * factor;
+                    weight *= (x - z[m]) * factor;
+                }
+                w[j] = weight;
+                dw[j] = derivative;
+            }
+        }
+
+        //Largest stencil of the slices: 4 nodes of sqrt(tau), 3 of sigma, r and q
+        constexpr int max_slice_terms = 4 * 3 * 3 * 3;
+
+    }
+
+    american_price_table american_price_table::build(instrument_type type, price_table_domain const& domain, price_table_settings settings, int error_samples) {
+        assert(("Price tables are for american calls and puts", type == instrument_type::call or type == instrument_type::put));
+        assert(("The moneyness dimension must contain the strike", domain.nodes[0] >= 2 and domain.lower[0] < 0 and domain.upper[0] > 0));
+        std::size_t count = 1;
+        for (int d = 0; d < D; d++) {
+            assert(("Every dimension needs a node", domain.nodes[d] >= 1));
+            count *= domain.nodes[d];
+        }
+        std::size_t slices = count / domain.nodes[0];
+        auto data_offset = round_up(sizeof(header), 64);
+        auto buffer = std::make_shared<std::vector<double>>((data_offset + data_size(count, slices)) / sizeof(double));
+        auto* h = reinterpret_cast<header*>(buffer->data());
+        std::memcpy(h->magic, table_magic, sizeof(table_magic));
+        h->version = table_version;
+        h->type = type;
+        for (int d = 0; d < D; d++) {
+            h->lower[d] = domain.lower[d];
+            h->upper[d] = domain.nodes[d] > 1 ? domain.upper[d] : domain.lower[d];
+            h->nodes[d] = domain.nodes[d];
+        }
+        h->l = settings.l;
+        h->m = settings.m;
+        h->n = settings.n;
+        h->error_samples = 0;
+        h->error_price = h->error_delta = 0;
+        h->count = count;
+        h->slices = slices;
+        h->data_offset = data_offset;
+
+        american_price_table table;
+        auto* values = buffer->data() + data_offset / sizeof(double);
+        table.attach(buffer, h, values);
+
+        //One solve per slice, its boundary anchors the moneyness nodes of the slice
+        auto k_lower = h->lower[0], k_upper = h->upper[0];
+        parallel_for(0, static_cast<int>(slices), [&table, values, type, settings, count, slices, k_lower, k_upper](int slice) {
+            double coordinates[D];
+            std::size_t rest = slice;
+            for (int d = D - 1; d >= 1; d--) {
+                auto N = table.domain_.nodes[d];
+                coordinates[d] = table.nodes[d][rest % N];
+                rest /= N;
+            }
+            auto [_, u, sigma, r, q] = coordinates;
+            slice_solver solve{type, u * u, sigma, r, q, settings};
+            auto anchor = std::clamp(solve.log_boundary() / (sigma * u), k_lower, k_upper);
+            values[3 * count + slice] = anchor;
+            auto direction = type == instrument_type::put ? 1.0 : -1.0;
+            auto span = type == instrument_type::put ? k_upper - anchor : anchor - k_lower;
+            for (int i = 0; i < table.domain_.nodes[0]; i++) {
+                auto x = (anchor + direction * table.nodes[0][i] * span) * sigma * u;
+                if (i == 0) {
+                    //the values on the continuation side of the boundary
+                    x += direction * 1e-12;
+                }
+                auto v = solve(x);
+                auto e = black_scholes(type, x, u * u, sigma, r, q);
+                auto index = i * slices + slice;
+                values[index] = v.price - e.price;
+                values[count + index] = v.delta - e.delta;
+                values[2 * count + index] = v.gamma - e.gamma;
+            }
+        }, 1);
+
+        auto error = table.measure_error(error_samples);
+        h->error_samples = error.samples;
+        h->error_price = error.price;
+        h->error_delta = error.delta;
+        return table;
+    }
+
+    american_price_table american_price_table::open(std::string const& path) {
+        american_price_table table;
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open price table " + path);
+        }
+        struct stat st{};
+        if (fstat(fd, &st) != 0 or static_cast<std::size_t>(st.st_size) < sizeof(header)) {
+            ::close(fd);
+            throw std::runtime_error("Invalid price table " + path);
+        }
+        std::size_t size = st.st_size;
+        void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            throw std::runtime_error("Cannot map price table " + path);
+        }
+        std::shared_ptr<const void> storage{address, [size](const void* p) { munmap(const_cast<void*>(p), size); }};
+#else
+        std::ifstream file{path, std::ios::binary | std::ios::ate};
+        if (not file) {
+            throw std::runtime_error("Cannot open price table " + path);
+        }
+        std::size_t size = file.tellg();
+        auto buffer = std::make_shared<std::vector<double>>((size + sizeof(double) - 1) / sizeof(double));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(buffer->data()), size);
+        std::shared_ptr<const void> storage{buffer, buffer->data()};
+#endif
+        auto const* h = static_cast<header const*>(storage.get());
+        //count and slices must be those of the nodes, and the values must fit in the file
+        auto consistent = [h, size]() {
+            if (h->type != instrument_type::call and h->type != instrument_type::put) {
+                return false;
+            }
+            std::uint64_t count = 1;
+            for (int d = 0; d < D; d++) {
+                if (h->nodes[d] < (d == 0 ? 2 : 1) or static_cast<std::uint64_t>(h->nodes[d]) > size / (count * sizeof(double))) {
+                    return false;
+                }
+                count *= h->nodes[d];
+            }
+            if (h->count != count or h->slices != count / h->nodes[0] or h->data_offset % sizeof(double) != 0
+                or h->data_offset < sizeof(header) or h->data_offset > size) {
+                return false;
+            }
+            auto room = (size - h->data_offset) / sizeof(double);
+            return h->count <= room / 3 and h->slices <= room - 3 * h->count;
+        };
+        if (size < sizeof(header) or std::memcmp(h->magic, table_magic, sizeof(table_magic)) != 0 or h->version != table_version
+            or not consistent()) {
+            throw std::runtime_error("Invalid price table " + path);
+        }
+        auto const* values = reinterpret_cast<double const*>(static_cast<char const*>(storage.get()) + h->data_offset);
+        table.attach(storage, h, values);
+        return table;
+    }
+
+    void american_price_table::save(std::string const& path) const {
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
+        file.write(reinterpret_cast<char const*>(header_), header_->data_offset + data_size(header_->count, header_->slices));
+        if (not file) {
+            throw std::runtime_error("Cannot write price table " + path);
+        }
+    }
+
+    void american_price_table::attach(std::shared_ptr<const void> _storage, header const* h, double const* _values) {
+        storage = std::move(_storage);
+        header_ = h;
+        values = _values;
+        anchors = _values + 3 * h->count;
+        std::size_t stride = 1;
+        for (int d = D - 1; d >= 0; d--) {
+            domain_.lower[d] = h->lower[d];
+            domain_.upper[d] = h->upper[d];
+            domain_.nodes[d] = h->nodes[d];
+            strides[d] = stride;
+            stride *= h->nodes[d];
+
+            //the moneyness nodes are fractions of the distance from the boundary to the edge of the domain
+            grid_lower[d] = d == 0 ? 0.0 : h->lower[d];
+            grid_upper[d] = d == 0 ? 1.0 : h->upper[d];
+            int N = h->nodes[d];
+            nodes[d] = std::shared_ptr<double[]>(new double[N]);
+            if (N == 1) {
+                nodes[d][0] = grid_lower[d];
+                continue;
+            }
+            auto z = chebyshev_nodes(N - 1);
+            for (int i = 0; i < N; i++) {
+                nodes[d][i] = grid_lower[d] + (grid_upper[d] - grid_lower[d]) * 0.5 * (1.0 + z[i]);
+            }
+            inverse_differences[d] = std::shared_ptr<double[]>(new double[N * N]);
+            for (int i = 0; i < N; i++) {
+                for (int j = 0; j < N; j++) {
+                    inverse_differences[d][i * N + j] = i == j ? 0.0 : 1.0 / (nodes[d][i] - nodes[d][j]);
+                }
+            }
+        }
+    }
+
+    bool american_price_table::contains(double S, double K, double tau, double sigma, double r, double q) const {
+        if (not (tau > 0 and sigma > 0)) {
+            return false;
+        }
+        double coordinates[D] = {log(S / K) / (sigma * sqrt(tau)), sqrt(tau), sigma, r, q};
+        for (int d = 0; d < D; d++) {
+            if (domain_.nodes[d] == 1) {
+                if (std::abs(coordinates[d] - domain_.lower[d]) > 1e-12 * std::max(1.0, std::abs(domain_.lower[d]))) {
+                    return false;
+                }
+            } else if (coordinates[d] < domain_.lower[d] or coordinates[d] > domain_.upper[d]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    double american_price_table::price(double S, double K, double tau, double sigma, double r, double q) const {
+        if (not contains(S, K, tau, sigma, r, q)) {
+            price_table_settings settings{header_->l, header_->m, header_->n};
+            return K * slice_solver{type(), tau, sigma, r, q, settings}(log(S / K)).price;
+        }
+        return K * interpolate(log(S / K), sqrt(tau), sigma, r, q, false).price;
+    }
+
+    price_table_greeks american_price_table::greeks(double S, double K, double tau, double sigma, double r, double q) const {
+        price_table_greeks g;
+        if (not contains(S, K, tau, sigma, r, q)) {
+            price_table_settings settings{header_->l, header_->m, header_->n};
+            g = solve_greeks(type(), log(S / K), tau, sigma, r, q, settings);
+        } else {
+            g = interpolate(log(S / K), sqrt(tau), sigma, r, q, true);
+        }
+        return {K * g.price, g.delta, g.gamma / K, K * g.theta, K * g.vega, K * g.rho, K * g.psi};
+    }
+
+    /**
+     * Price and greeks of the option of strike 1: the boundary of the slice is interpolated first, points beyond it
+     * are worth their payoff and the others the Black-Scholes value plus the interpolated early exercise premium.
+     * With all = false only the price is computed. Derivatives along a dimension with a single node are NaN.
+     */
+    price_table_greeks american_price_table::interpolate(double x, double u, double sigma, double r, double q, bool all) const {
+        auto k = x / (sigma * u);
+        double coordinates[D] = {0.0, u, sigma, r, q};
+        int first[D], points[D];
+        double w[D][4], dw[D][4];
+        auto stencil = [&](int d) {
+            int N = domain_.nodes[d];
+            if (N == 1) {
+                first[d] = 0;
+                points[d] = 1;
+                w[d][0] = 1.0;
+                dw[d][0] = NAN;
+                return;
+            }
+            int P = std::min(N, d < 2 ? 4 : 3);
+            auto const* z = nodes[d].get();
+            auto c = coordinates[d];
+            //the cell [z[i], z[i+1]] of the point, centered in the stencil (the nearest node for odd stencils)
+            int i = std::clamp(static_cast<int>(std::upper_bound(z, z + N, c) - z) - 1, 0, N - 2);
+            int start = P % 2 == 0 ? i - (P / 2 - 1) : i + (c - z[i] > z[i + 1] - c) - P / 2;
+            first[d] = std::clamp(start, 0, N - P);
+            points[d] = P;
+            lagrange_weights(z + first[d], &inverse_differences[d][first[d] * (N + 1)], N, P, c, w[d], dw[d]);
+        };
+
+        //Offsets and weights of the slices around the point: the outer product of the weights of dimensions 1 to 4
+        auto expand = [this, &first, &points](std::array<double const*, D> const& weights, std::size_t* offsets, double* products) {
+            int n = 0;
+            for (int i1 = 0; i1 < points[1]; i1++) {
+                auto o1 = (first[1] + i1) * strides[1];
+                for (int i2 = 0; i2 < points[2]; i2++) {
+                    auto w2 = weights[1][i1] * weights[2][i2];
+                    auto o2 = o1 + (first[2] + i2) * strides[2];
+                    for (int i3 = 0; i3 < points[3]; i3++) {
+                        auto w3 = w2 * weights[3][i3];
+                        auto o3 = o2 + (first[3] + i3) * strides[3];
+                        for (int i4 = 0; i4 < points[4]; i4++) {
+                            offsets[n] = o3 + (first[4] + i4) * strides[4];
+                            products[n++] = w3 * weights[4][i4];
+                        }
+                    }
+                }
+            }
+            return n;
+        };
+        auto dot = [](double const* array, std::size_t const* offsets, double const* products, int n) {
+            double sum = 0;
+            for (int t = 0; t < n; t++) {
+                sum += products[t] * array[offsets[t]];
+            }
+            return sum;
+        };
+        for (int d = 1; d < D; d++) {
+            stencil(d);
+        }
+        std::array<double const*, D> value_weights{w[0], w[1], w[2], w[3], w[4]};
+        std::size_t offsets[max_slice_terms];
+        double products[max_slice_terms];
+        auto terms = expand(value_weights, offsets, products);
+
+        auto anchor = dot(anchors, offsets, products, terms);
+        auto put = type() == instrument_type::put;
+        auto direction = put ? 1.0 : -1.0;
+        auto span = put ? domain_.upper[0] - anchor : anchor - domain_.lower[0];
+        auto xi = direction * (k - anchor) / span;
+        if (xi < 0) {
+            //Beyond the exercise boundary the option is worth its payoff
+            auto payoff = direction * (1.0 - exp(x));
+            return {payoff, -direction, 0.0, 0.0, 0.0, 0.0, 0.0};
+        }
+        coordinates[0] = std::min(xi, 1.0);
+        stencil(0);
+
+        auto slices = header_->slices;
+        //Contraction of an array of the table with the moneyness weights and the slice weights
+        auto contract = [&](double const* array, std::size_t const* _offsets, double const* _products) {
+            double sum = 0;
+            for (int i0 = 0; i0 < points[0]; i0++) {
+                sum += w[0][i0] * dot(array + (first[0] + i0) * slices, _offsets, _products, terms);
+            }
+            return sum;
+        };
+
+        auto premium = contract(values, offsets, products);
+        if (not all) {
+            pricing<double> p{exp(x), 1.0, sigma, u * u, r, q};
+            return {(put ? calculate_european_put(p) : calculate_european_call(p)) + premium};
+        }
+        auto count = header_->count;
+        auto g = black_scholes(type(), x, u * u, sigma, r, q);
+        auto premium_delta = contract(values + count, offsets, products);
+        g.price += premium;
+        g.delta += premium_delta;
+        g.gamma += contract(values + 2 * count, offsets, products);
+
+        /*
+         * The premium F(xi, u, sigma, r, q) is tabulated at constant xi, with xi = (k - anchor)/span and k = x/(sigma u).
+         * At constant x, dF/dtheta = F_theta + F_xi dxi/dtheta = F_theta + dF/dx sigma u (dk/dtheta - danchor/dtheta (1 - xi)),
+         * with dF/dx = S premium_delta.
+         */
+        auto dF_dx = exp(x) * premium_delta;
+        auto derivative = [&](int d, double dk) {
+            auto weights = value_weights;
+            weights[d] = dw[d];
+            std::size_t d_offsets[max_slice_terms];
+            double d_products[max_slice_terms];
+            expand(weights, d_offsets, d_products);
+            auto d_anchor = dot(anchors, d_offsets, d_products, terms);
+            return contract(values, d_offsets, d_products) + dF_dx * sigma * u * (dk - d_anchor * (1.0 - xi));
+        };
+        //d/dtau = d/du / (2u), theta is calendar time
+        g.theta -= derivative(1, -k / u) / (2.0 * u);
+        g.vega += derivative(2, -k / sigma);
+        g.rho += derivative(3, 0.0);
+        g.psi += derivative(4, 0.0);
+        return g;
+    }
+
+    price_table_error american_price_table::error() const {
+        return {header_->error_price, header_->error_delta, header_->error_samples};
+    }
+
+    price_table_error american_price_table::measure_error(int samples, unsigned seed) const {
+        std::mt19937 generator{seed};
+        std::uniform_real_distribution<double> uniform{0.0, 1.0};
+        price_table_settings settings{header_->l, header_->m, header_->n};
+        price_table_error error{0, 0, samples};
+        for (int i = 0; i < samples; i++) {
+            double coordinates[D];
+            for (int d = 0; d < D; d++) {
+                coordinates[d] = domain_.lower[d] + (domain_.upper[d] - domain_.lower[d]) * uniform(generator);
+            }
+            auto [k, u, sigma, r, q] = coordinates;
+            auto x = k * sigma * u;
+            auto exact = slice_solver{type(), u * u, sigma, r, q, settings}(x);
+            auto interpolated = interpolate(x, u, sigma, r, q, true);
+            error.price = std::max(error.price, std::abs(interpolated.price - exact.price));
+            error.delta = std::max(error.delta, std::abs(interpolated.delta - exact.delta));
+        }
+        return error;
+    }
+
+    instrument_type american_price_table::type() const {
+        return static_cast<instrument_type>(header_->type);
+    }
+
+    price_table_domain const& american_price_table::domain() const {
+        return domain_;
+    }
+
+    std::size_t american_price_table::size() const {
+        return header_->count;
+    }
+
+}
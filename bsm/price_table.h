@@ -0,0 +1,113 @@
+#ifndef BSM_PRICE_TABLE_H
+#define BSM_PRICE_TABLE_H
+
+#include "instruments.h"
+
+#include <array>
+#include <memory>
+#include <string>
+
+namespace bsm {
+
+    /**
+     * Domain of an american price table. By homogeneity in the strike the normalized price V/K only depends on the
+     * moneyness, tau, sigma, r and q. The five dimensions of the table are the standardized moneyness
+     * ln(S/K)/(sigma sqrt(tau)), whose range must contain 0, sqrt(tau) (which absorbs the square root behaviour next
+     * to the maturity), sigma, r and q. Dimension d is sampled at nodes[d] Chebyshev points of [lower[d], upper[d]];
+     * a single node fixes the dimension at lower[d], eg the rates of a table built for one trading day.
+     */
+    struct price_table_domain {
+        static constexpr int dimensions = 5;
+        std::array<double, dimensions> lower;
+        std::array<double, dimensions> upper;
+        std::array<int, dimensions> nodes;
+    };
+
+    //Largest absolute errors of the normalized price V/K and of delta found at random points of the domain
+    struct price_table_error {
+        double price = 0;
+        double delta = 0;
+        int samples = 0;
+    };
+
+    struct price_table_greeks {
+        double price;
+        double delta;
+        double gamma;
+        double theta;
+        double vega;
+        double rho;
+        double psi;
+    };
+
+    //Settings (l, m, n) of the spectral collocation solver a table is built with, see fastamerican_solver
+    struct price_table_settings {
+        int l = 16;
+        int m = 3;
+        int n = 8;
+    };
+
+    /**
+     * Chebyshev tensor table of american prices, deltas and gammas, built offline with the spectral collocation
+     * solver (in parallel on the shared executor) and saved to a file that is memory mapped when opened.
+     * The table holds the early exercise premium over Black-Scholes, which is smooth in the continuation region but
+     * not across the exercise boundary (gamma jumps there). So each slice (sqrt(tau), sigma, r, q) stores its boundary
+     * and spreads its moneyness nodes from the boundary to the edge of the domain; points beyond the boundary are
+     * worth their payoff.
+     * A lookup interpolates locally: in each dimension it uses the 4 (3 for sigma, r and q) Chebyshev nodes around
+     * the point, so a price costs a few hundred flops whatever the size of the table. Theta, vega, rho and psi are
+     * derivatives of the interpolated price. Points outside the domain fall back to the solver.
+     * Tables are immutable and cheap to copy (the values are shared), so they can be used from any thread.
+     */
+    class american_price_table {
+    public:
+        static american_price_table build(instrument_type type, price_table_domain const& domain, price_table_settings settings = {}, int error_samples = 256);
+
+        //Maps a table saved by save(). The file layout is native (same endianness and doubles as the writer).
+        static american_price_table open(std::string const& path);
+
+        void save(std::string const& path) const;
+
+        bool contains(double S, double K, double tau, double sigma, double r, double q) const;
+
+        double price(double S, double K, double tau, double sigma, double r, double q) const;
+
+        price_table_greeks greeks(double S, double K, double tau, double sigma, double r, double q) const;
+
+        //Interpolation error measured when the table was built
+        price_table_error error() const;
+
+        //Measures the interpolation error again, against the solver at `samples` random points
+        price_table_error measure_error(int samples, unsigned seed = 1) const;
+
+        instrument_type type() const;
+
+        price_table_domain const& domain() const;
+
+        std::size_t size() const;
+
+    private:
+        struct header;
+        std::shared_ptr<const void> storage;
+        header const* header_ = nullptr;
+        //early exercise premium of the price, delta and gamma at every node, one array after the other
+        double const* values = nullptr;
+        //standardized moneyness of the exercise boundary of every slice, clamped to the domain
+        double const* anchors = nullptr;
+        //Chebyshev nodes of each dimension, the intervals they span and their strides in the arrays
+        std::array<std::shared_ptr<double[]>, price_table_domain::dimensions> nodes;
+        //1/(z[i] - z[j]) for the nodes z of each dimension
+        std::array<std::shared_ptr<double[]>, price_table_domain::dimensions> inverse_differences;
+        std::array<double, price_table_domain::dimensions> grid_lower;
+        std::array<double, price_table_domain::dimensions> grid_upper;
+        std::array<std::size_t, price_table_domain::dimensions> strides;
+        price_table_domain domain_;
+
+        american_price_table() = default;
+        void attach(std::shared_ptr<const void> storage, header const* header, double const* values);
+        price_table_greeks interpolate(double x, double u, double sigma, double r, double q, bool all) const;
+    };
+
+}
+
+#endif //BSM_PRICE_TABLE_H
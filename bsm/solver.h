@@ -3,13 +3,18 @@
 
 #include "common.h"
 #include "instruments.h"
+#include "instrument_table.h"
+#include "market_context.h"
 #include "bintree.h"
 
 #include <concepts>
 #include <iostream>
 #include <sstream>
 #include <memory>
+#include <vector>
+#include <functional>
 #include <cmath>
+#include <cstdint>
 
 namespace bsm {
 
@@ -28,6 +33,8 @@ namespace bsm {
     }
 
     struct method {
+        virtual ~method() = default;
+
         virtual double price() = 0;
         virtual double delta() = 0;
         virtual double gamma() = 0;
@@ -37,10 +44,55 @@ namespace bsm {
         virtual double psi() = 0;
     };
 
+    /**
+     * Exercise boundary of an American option over the times to maturity [0, tau], built once from n+1 samples of
+     * the boundary. Like the spectral collocation method it interpolates H = ln(B/B0)^2 (B0 is the boundary at the
+     * maturity) with a Chebyshev polynomial in sqrt(tau), which absorbs the square root behaviour next to the
+     * maturity. H is clamped to its monotone envelope on a fine grid, so the curve is monotone (decreasing in tau for
+     * puts, increasing for calls) even when the samples are noisy, as lattice boundaries are.
+     * The curve is immutable: a query is a few tens of flops and it can be shared across threads.
+     */
+    class boundary_curve {
+        instrument_type type;
+        double tau_;
+        double B0;
+        bool constant;
+        //Chebyshev coefficients of H and its monotone envelope on a uniform grid of sqrt(tau)
+        std::vector<double> coefficients;
+        std::vector<double> envelope;
+    public:
+        boundary_curve(std::function<double(double)> const& boundary, double tau, instrument_type type, int n = 16);
+
+        double operator()(double _tau) const;
+
+        double tau() const {
+            return tau_;
+        }
+    };
+
     struct american_method: method {
         virtual long double exercise_boundary(long double _tau) = 0;
+        //The whole exercise boundary, built on the first call and shared afterwards
+        virtual std::shared_ptr<const boundary_curve> exercise_boundary_curve() = 0;
     };
 
+    struct mc_method: method {
+        //Standard error of the price estimate
+        virtual double standard_error() = 0;
+        //Standard errors of the greeks estimated with the price
+        virtual double delta_error() = 0;
+        virtual double gamma_error() = 0;
+        virtual double vega_error() = 0;
+    };
+
+    struct american_mc_method: american_method {
+        //Standard error of the price estimate
+        virtual double standard_error() = 0;
+    };
+
+    //Payoff of a simulated path: S holds the prices at the times tau/steps, 2 tau/steps, ..., tau
+    using path_payoff = std::function<double(double const* S, int steps)>;
+
     template<typename T = double>
     struct pricing {
         T S;
@@ -88,19 +140,34 @@ namespace bsm {
         std::unique_ptr<method> operator()(european_forward& instrument);
         std::unique_ptr<method> operator()(european_call& instrument);
         std::unique_ptr<method> operator()(european_put& instrument);
+
+        //Prices of the contracts of a chain, in its order, read straight from its columns. American contracts are NaN
+        std::vector<double> operator()(instrument_columns const& chain);
+        //Same, with the market of each expiry of the chain already computed
+        std::vector<double> operator()(instrument_columns const& chain, market_context const& context);
     };
 
+    /**
+     * Cox-Ross-Rubinstein binomial tree solver.
+     * With std_devs > 0 the tree is truncated: nodes further than std_devs standard deviations (of log S at maturity)
+     * from the spot are not computed and the edges of the band use analytic values instead.
+     * With control_variate the american options are priced as American - European + Black-Scholes, the european
+     * price being computed in the same backward induction: it is about ten times more accurate for the same steps.
+     */
     template<typename AD = autodiff_off>
     struct crr_solver {
         mkt_params<double> mktParams;
         const int steps;
         const int extra_steps;
+        const double std_devs;
+        const bool control_variate;
     public:
-        inline crr_solver(mkt_params<double> const& mktParams, int steps, int extra_steps = 0):
-            mktParams{mktParams}, steps{steps}, extra_steps{extra_steps} {
+        inline crr_solver(mkt_params<double> const& mktParams, int steps, int extra_steps = 0, double std_devs = 0, bool control_variate = false):
+            mktParams{mktParams}, steps{steps}, extra_steps{extra_steps}, std_devs{std_devs}, control_variate{control_variate} {
             assert(("Extra steps must be even",extra_steps%2==0));
         }
-        inline crr_solver(mkt_params<long double> const& mktParams, int steps, int extra_steps = 0): mktParams{mktParams}, steps{steps}, extra_steps{extra_steps} {}
+        inline crr_solver(mkt_params<long double> const& mktParams, int steps, int extra_steps = 0, double std_devs = 0, bool control_variate = false):
+            mktParams{mktParams}, steps{steps}, extra_steps{extra_steps}, std_devs{std_devs}, control_variate{control_variate} {}
         inline crr_solver(crr_solver const&) = default;
         inline crr_solver(crr_solver &&) noexcept = default;
 
@@ -109,21 +176,93 @@ namespace bsm {
         std::unique_ptr<method> operator()(european_put& instrument);
         std::unique_ptr<american_method> operator()(american_call& instrument);
         std::unique_ptr<american_method> operator()(american_put& instrument);
+
+        /**
+         * Prices of the contracts of a chain. On the full tree the lattice of each expiry (the powers of u, the
+         * probabilities and the discount factors of a step) is built once and shared by all its strikes, so a
+         * contract only costs its backward induction. A truncated tree (std_devs > 0) prices each contract on its own.
+         */
+        std::vector<double> operator()(instrument_columns const& chain);
+        std::vector<double> operator()(instrument_columns const& chain, market_context const& context);
+
+        //Upper bound of the price error introduced by the truncation (zero for the full tree)
+        double truncation_error(instrument const& instrument) const;
+    };
+
+    //Kamrad-Ritchken trinomial lattice solver
+    template<typename AD = autodiff_off>
+    struct trinomial_solver {
+        mkt_params<double> mktParams;
+        const int steps;
+    public:
+        inline trinomial_solver(mkt_params<double> const& mktParams, int steps): mktParams{mktParams}, steps{steps} {}
+        inline trinomial_solver(mkt_params<long double> const& mktParams, int steps): mktParams{mktParams}, steps{steps} {}
+        inline trinomial_solver(trinomial_solver const&) = default;
+        inline trinomial_solver(trinomial_solver &&) noexcept = default;
+
+        std::unique_ptr<method> operator()(european_call& instrument);
+        std::unique_ptr<method> operator()(european_put& instrument);
+        std::unique_ptr<american_method> operator()(american_call& instrument);
+        std::unique_ptr<american_method> operator()(american_put& instrument);
     };
 
-    //Superpositioned Binomial Lattice solver
+    /**
+     * Superpositioned Binomial Lattice solver. The lattice is a Taskflow graph built once per solution and re-run
+     * for the bumped greeks. With control_variate the european lattice is rolled back in the same graph and the
+     * american values are corrected by its error against Black-Scholes.
+     */
     template<typename AD = autodiff_off>
     struct sbl_solver {
         mkt_params<double> mktParams;
         const int steps;
-        inline sbl_solver(mkt_params<double> const& mktParams, int steps) : mktParams{mktParams}, steps{steps} {}
+        const bool control_variate;
+        inline sbl_solver(mkt_params<double> const& mktParams, int steps, bool control_variate = false) :
+            mktParams{mktParams}, steps{steps}, control_variate{control_variate} {}
         inline sbl_solver(sbl_solver const&) = default;
         inline sbl_solver(sbl_solver &&) noexcept = default;
 
         std::unique_ptr<american_method> operator()(american_put& instrument);
+        std::unique_ptr<american_method> operator()(american_call& instrument);
 
     };
 
+    /**
+     * Crank-Nicolson finite difference solver of the Black-Scholes PDE on a uniform grid of ln S with space_steps
+     * intervals spanning std_devs standard deviations on each side of the spot, and time_steps time steps. The first
+     * steps are Rannacher (implicit Euler) half steps and early exercise is handled by the Brennan-Schwartz algorithm.
+     * Delta, gamma and theta are read off the grid.
+     */
+    template<typename AD = autodiff_off>
+    struct cranknicolson_solver {
+        mkt_params<double> mktParams;
+        const int space_steps;
+        const int time_steps;
+        const double std_devs;
+    public:
+        inline cranknicolson_solver(mkt_params<double> const& mktParams, int space_steps, int time_steps, double std_devs = 6.0):
+                mktParams{mktParams}, space_steps{space_steps}, time_steps{time_steps}, std_devs{std_devs} {}
+        inline cranknicolson_solver(cranknicolson_solver const&) = default;
+        inline cranknicolson_solver(cranknicolson_solver &&) noexcept = default;
+
+        std::unique_ptr<method> operator()(european_call& instrument);
+        std::unique_ptr<method> operator()(european_put& instrument);
+        std::unique_ptr<american_method> operator()(american_call& instrument);
+        std::unique_ptr<american_method> operator()(american_put& instrument);
+
+        /**
+         * Prices a chain of options with the same maturity from one solve. Prices are homogeneous of degree one in
+         * (S, K), so V(S, K) = K/K0 V(S K0/K, K0): the grid is solved once for the strike K0 = S, spanning the
+         * moneyness of the whole chain, and every strike interpolates it (cubic in ln S) at S K0/K, its boundary
+         * being K/K0 times the one of K0. A strike whose interpolation error estimate is above tolerance (in price
+         * units), eg next to the exercise boundary where gamma jumps, is solved on its own grid instead. American
+         * calls are priced as their symmetric puts, which all have the strike S and share its grid.
+         */
+        std::vector<std::unique_ptr<method>> operator()(std::vector<european_call> const& chain, double tolerance = 1e-4);
+        std::vector<std::unique_ptr<method>> operator()(std::vector<european_put> const& chain, double tolerance = 1e-4);
+        std::vector<std::unique_ptr<american_method>> operator()(std::vector<american_call> const& chain, double tolerance = 1e-4);
+        std::vector<std::unique_ptr<american_method>> operator()(std::vector<american_put> const& chain, double tolerance = 1e-4);
+    };
+
     template<typename AD = autodiff_off>
     struct qdplus_solver {
         mkt_params<long double> mktParams;
@@ -134,8 +273,19 @@ namespace bsm {
         std::unique_ptr<american_method> operator()(american_put& instrument);
         std::unique_ptr<american_method> operator()(american_call& instrument);
 
+        //Prices of the contracts of a chain, in its order, by the batch solver of the whole chain. Contracts other
+        //than american calls and puts are NaN
+        std::vector<double> operator()(instrument_columns const& chain);
+        std::vector<double> operator()(instrument_columns const& chain, market_context const& context);
+
     };
 
+    /**
+     * Spectral collocation solver of Andersen, Lake and Offengenden. l is the number of Gauss-Legendre quadrature
+     * points of the integrals, m the number of fixed point iterations of the exercise boundary and n the number of
+     * Chebyshev intervals of the boundary. (8,2,6) prices to about 1e-4, (16,3,8) to about 1e-6 and (25,5,12) to
+     * about 1e-8, in tens to hundreds of microseconds.
+     */
     template<typename AD = autodiff_off>
     struct fastamerican_solver {
         mkt_params<double> mktParams;
@@ -146,6 +296,69 @@ namespace bsm {
         inline fastamerican_solver(fastamerican_solver const&) = default;
         inline fastamerican_solver(fastamerican_solver &&) noexcept = default;
 
+        std::unique_ptr<american_method> operator()(american_put& instrument);
+        std::unique_ptr<american_method> operator()(american_call& instrument);
+    };
+
+    /**
+     * Monte Carlo solver of the Black-Scholes dynamics, exact in log S on time steps of tau/steps. The paths run in
+     * blocks on the shared executor, block b drawing from the stream b of the seed, so the estimates don't depend on
+     * the number of threads. Antithetic pairs the paths of the normals z and -z. The control variate is the vanilla
+     * payoff of the instrument (on the same paths), whose price is known in closed form: for a vanilla it leaves no
+     * variance, for a path payoff it removes the part explained by the vanilla. Delta and vega are pathwise and gamma
+     * a likelihood ratio, all estimated on the paths of the price; only theta, rho and psi bump and revalue, on the
+     * same random numbers.
+     */
+    template<typename AD = autodiff_off>
+    struct mc_solver {
+        mkt_params<double> mktParams;
+        const int paths;
+        const int steps;
+        const bool antithetic;
+        const bool control_variate;
+        const std::uint64_t seed;
+    public:
+        inline mc_solver(mkt_params<double> const& mktParams, int paths, int steps = 1, bool antithetic = false, bool control_variate = false, std::uint64_t seed = 1):
+                mktParams{mktParams}, paths{paths}, steps{steps}, antithetic{antithetic}, control_variate{control_variate}, seed{seed} {
+            assert(("Monte Carlo needs at least 2 paths and 1 step", paths >= 2 and steps >= 1));
+        }
+        inline mc_solver(mc_solver const&) = default;
+        inline mc_solver(mc_solver &&) noexcept = default;
+
+        std::unique_ptr<mc_method> operator()(european_forward& instrument);
+        std::unique_ptr<mc_method> operator()(european_call& instrument);
+        std::unique_ptr<mc_method> operator()(european_put& instrument);
+
+        //Prices the payoff of the paths up to the maturity of the instrument, whose payoff is the control variate
+        std::unique_ptr<mc_method> operator()(european_call& instrument, path_payoff const& payoff);
+        std::unique_ptr<mc_method> operator()(european_put& instrument, path_payoff const& payoff);
+    };
+
+
+    /**
+     * Least-squares Monte Carlo solver of Longstaff and Schwartz. The paths are simulated on steps exercise dates
+     * and stored date by date; going backwards, the discounted cash flows of the paths in the money are regressed on
+     * the polynomials of degree up to degree in S/K, and a path is exercised where its payoff beats the regressed
+     * continuation value. The exercise boundary is the root of payoff = continuation at each date. Paths and
+     * regressions run in blocks on the shared executor, block b drawing from the stream b of the seed.
+     */
+    template<typename AD = autodiff_off>
+    struct lsm_solver {
+        mkt_params<double> mktParams;
+        const int paths;
+        const int steps;
+        const int degree;
+        const std::uint64_t seed;
+    public:
+        inline lsm_solver(mkt_params<double> const& mktParams, int paths, int steps = 50, int degree = 3, std::uint64_t seed = 1):
+                mktParams{mktParams}, paths{paths}, steps{steps}, degree{degree}, seed{seed} {
+            assert(("Least-squares Monte Carlo needs at least 2 paths, 1 step and a degree of 1 to 8", paths >= 2 and steps >= 1 and degree >= 1 and degree <= 8));
+        }
+        inline lsm_solver(lsm_solver const&) = default;
+        inline lsm_solver(lsm_solver &&) noexcept = default;
+
+        std::unique_ptr<american_mc_method> operator()(american_put& instrument);
+        std::unique_ptr<american_mc_method> operator()(american_call& instrument);
     };
 
 }
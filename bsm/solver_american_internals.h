@@ -4,6 +4,11 @@
 #include "solver.h"
 
 #include <cassert>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
 
 namespace bsm {
     namespace internals {
@@ -44,6 +49,190 @@ namespace bsm {
             }
         }
 
+        /**
+         * Exercise boundary curve of a method, built by the first caller of get and shared afterwards, also when
+         * several threads ask for it at once. A copy of the method starts without a curve and builds its own.
+         */
+        class lazy_boundary_curve {
+            std::once_flag built;
+            std::shared_ptr<const boundary_curve> curve;
+        public:
+            lazy_boundary_curve() = default;
+            lazy_boundary_curve(lazy_boundary_curve const&) {}
+
+            template<typename F>
+            std::shared_ptr<const boundary_curve> get(F const& build) {
+                std::call_once(built, [this, &build] {
+                    curve = build();
+                });
+                return curve;
+            }
+        };
+
+        /**
+         * American call priced through the put-call symmetry of McDonald and Schroder, C(S, K, r, q) = P(K, S, q, r):
+         * the put with spot and strike exchanged and the rates swapped, so the solvers only need a put kernel. The
+         * greeks are mapped back by homogeneity of the put in (spot, strike): delta = (P - K delta_P)/S and
+         * gamma = K^2 gamma_P/S^2, vega and theta are those of the put, rho is its psi and psi its rho. The call is
+         * exercised above S K/B, where B is the boundary of the put.
+         */
+        struct symmetric_call_method: pricing<double>, american_method {
+            std::unique_ptr<american_method> put;
+            lazy_boundary_curve curve_;
+
+            symmetric_call_method(american_call const& instrument, mkt_params<double> const& mp, std::unique_ptr<american_method> put):
+                    pricing{instrument, mp}, put{std::move(put)} {}
+
+            double price() override {
+                return put->price();
+            }
+
+            double delta() override {
+                return (put->price() - K * put->delta()) / S;
+            }
+
+            double gamma() override {
+                return K * K * put->gamma() / (S * S);
+            }
+
+            double vega() override {
+                return put->vega();
+            }
+
+            double theta() override {
+                return put->theta();
+            }
+
+            double rho() override {
+                return put->psi();
+            }
+
+            double psi() override {
+                return put->rho();
+            }
+
+            std::shared_ptr<const boundary_curve> exercise_boundary_curve() override {
+                return curve_.get([this] {
+                    return std::make_shared<const boundary_curve>([this](double _tau) { return static_cast<double>(exercise_boundary(_tau)); }, tau, instrument_type::call);
+                });
+            }
+
+            long double exercise_boundary(long double _tau) override {
+                auto B = put->exercise_boundary(_tau);
+                if (std::isnan(B)) {
+                    return NAN;
+                }
+                return B > 0 ? S * K / B : INFINITY;
+            }
+        };
+
+        //The symmetric put of an american call and its market, see symmetric_call_method
+        inline american_put symmetric_put(american_call const& instrument, mkt_params<double> const& mp) {
+            return {mp.S, instrument.maturity};
+        }
+
+        inline mkt_params<double> symmetric_market(american_call const& instrument, mkt_params<double> const& mp) {
+            return {static_cast<double>(instrument.K), mp.sigma, mp.t, mp.q, mp.r};
+        }
+
+        //Prices an american call with the put of a solver, solve_put(put, market) returning its american_method
+        template<typename F>
+        inline std::unique_ptr<american_method> solve_by_symmetry(american_call const& instrument, mkt_params<double> const& mp, F const& solve_put) {
+            auto put = symmetric_put(instrument, mp);
+            return std::make_unique<symmetric_call_method>(instrument, mp, solve_put(put, symmetric_market(instrument, mp)));
+        }
+
+        /**
+         * Tracks the exercise frontier of a lattice from one time step to the previous one. Node 0 of a layer is the
+         * highest spot, so the exercise region of a put is a suffix of the layer and that of a call is a prefix. The
+         * frontier is monotone in time and moves by about one node per step, hence walking from the previous frontier
+         * costs O(1) per step instead of a scan of the whole layer.
+         */
+        struct exercise_frontier_tracker {
+            const instrument_type type;
+            int hint = -1;
+
+            explicit exercise_frontier_tracker(instrument_type type): type{type} {}
+
+            /**
+             * Index of the frontier node of the layer [first,last], ie the exercised node nearest to the continuation
+             * region, or -1 when no node is exercised. The shift maps an index of the next step to the node with the
+             * same spot in this step.
+             */
+            template<typename Exercised>
+            int track(int first, int last, int shift, Exercised const& exercised) {
+                if (type == instrument_type::put) {
+                    if (not exercised(last)) {
+                        return hint = -1;
+                    }
+                    int i = hint < 0 ? last : std::clamp(hint + shift, first, last);
+                    if (exercised(i)) {
+                        while (i > first and exercised(i - 1)) i--;
+                    } else {
+                        while (not exercised(i)) i++;
+                    }
+                    return hint = i;
+                } else if (type == instrument_type::call) {
+                    if (not exercised(first)) {
+                        return hint = -1;
+                    }
+                    int i = hint < 0 ? first : std::clamp(hint + shift, first, last);
+                    if (exercised(i)) {
+                        while (i < last and exercised(i + 1)) i++;
+                    } else {
+                        while (not exercised(i)) i--;
+                    }
+                    return hint = i;
+                }
+                return -1;
+            }
+        };
+
+        /**
+         * Exercise boundary between the frontier node b and its neighbour c in the continuation region: the spot where
+         * the linear interpolation of premium minus payoff crosses zero. This approximation is based on paper
+         * "Discrete and continuous time approximations of the optimal exercise boundary of American options - Basso,
+         * Nardon, Pianca"
+         */
+        template<typename T>
+        inline T interpolate_frontier(T const& S_b, T const& V_b, T const& payoff_b, T const& S_c, T const& V_c, T const& payoff_c) {
+            auto den = (V_c - payoff_c) - (V_b - payoff_b);
+            if (den == 0) {
+                //both nodes sit on the payoff (eg. next to the maturity), no better guess than the frontier node
+                return S_b;
+            }
+            auto w1 = (V_c - payoff_c) / den;
+            auto w2 = (payoff_b - V_b) / den;
+            return w1 * S_b + w2 * S_c;
+        }
+
+        /**
+         * Continuous exercise boundary from the per-step boundary of a lattice: boundary[k] is the boundary k steps after
+         * the valuation date, ie at time to maturity tau*(1-k/steps), and in between the curve is linear. Times outside
+         * [0,tau] take the boundary at the nearest end.
+         */
+        template<typename T>
+        struct lattice_boundary_curve {
+            T tau;
+            std::vector<T> boundary;
+
+            lattice_boundary_curve(T const& tau, std::vector<T> boundary): tau{tau}, boundary{std::move(boundary)} {}
+
+            T operator()(T const& _tau) const {
+                if (boundary.empty()) {
+                    return NAN;
+                }
+                int steps = boundary.size() - 1;
+                if (steps == 0) {
+                    return boundary[0];
+                }
+                T x = std::clamp<T>(steps * (1.0 - _tau / tau), 0.0, steps);
+                int k = std::min(static_cast<int>(x), steps - 1);
+                T w = x - k;
+                return (1.0 - w) * boundary[k] + w * boundary[k + 1];
+            }
+        };
+
     }
 }
 
@@ -1,5 +1,6 @@
 #include "solver.h"
 #include "solver_analytical_internals.h"
+#include "executor.h"
 
 #include <memory>
 #include <cmath>
@@ -126,4 +127,36 @@ namespace bsm {
         return std::make_unique<ep_analytical_pricing_method>(fp);
     }
 
+    template<>
+    std::vector<double> analytical_solver<autodiff_off>::operator()(instrument_columns const& chain, market_context const& context) {
+        std::vector<double> prices(chain.size());
+        parallel_for(0, static_cast<int>(chain.size()), [&chain, &context, &prices](int row) {
+            //Black-Scholes doesn't price the early exercise
+            if (chain.style(row) != european_exercise) {
+                prices[row] = NAN;
+                return;
+            }
+            auto const& market = context[chain.expiries[row]];
+            switch (chain.type(row)) {
+                case instrument_type::forward:
+                    prices[row] = calculate_european_forward(market, chain.strike(row));
+                    break;
+                case instrument_type::call:
+                    prices[row] = calculate_european_call(market, chain.strike(row));
+                    break;
+                case instrument_type::put:
+                    prices[row] = calculate_european_put(market, chain.strike(row));
+                    break;
+                default:
+                    prices[row] = NAN;
+            }
+        }, 4096);
+        return prices;
+    }
+
+    template<>
+    std::vector<double> analytical_solver<autodiff_off>::operator()(instrument_columns const& chain) {
+        return (*this)(chain, market_context{mktParams, chain.taus});
+    }
+
 }
@@ -45,6 +45,26 @@ namespace bsm {
             auto const d1 = calculate_d1<T>(p);
             return p.S*exp(-p.q*p.tau)*pdf<T>(d1)*sqrt(p.tau);
         }
+        /**
+         * Prices from the market of the expiry (see market_context), a log and two cdf per strike:
+         * C = df_r (F N(d1) - K N(d2)) with d1 = (log(F/K) + v^2/2) / v and d2 = d1 - v.
+         */
+        inline double calculate_european_forward(expiry_market const& m, double K) {
+            return m.df_r * (m.forward - K);
+        }
+
+        inline double calculate_european_call(expiry_market const& m, double K) {
+            auto d1 = (log(m.forward / K) + 0.5 * m.v * m.v) / m.v;
+            auto d2 = d1 - m.v;
+            return m.df_r * (m.forward * cdf<double>(d1) - K * cdf<double>(d2));
+        }
+
+        inline double calculate_european_put(expiry_market const& m, double K) {
+            auto d1 = (log(m.forward / K) + 0.5 * m.v * m.v) / m.v;
+            auto d2 = d1 - m.v;
+            return m.df_r * (K * cdf<double>(-d2) - m.forward * cdf<double>(-d1));
+        }
+
         template<typename T>
         T calculate_theta(pricing<T> const& p, double sign) {
             auto d1 = calculate_d1(p);
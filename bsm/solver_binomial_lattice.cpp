@@ -14,7 +14,7 @@ namespace bsm {
         pricing<long double> p;
         superpositioned_binomial_lattice_method<long double> sbl;
 
-        sbl_method(american_put const& instrument, mkt_params<double> const& mp, int steps): sbl{instrument, steps}, p{instrument,mp} {
+        sbl_method(american_put const& instrument, mkt_params<double> const& mp, int steps, bool control_variate = false): sbl{instrument, steps, control_variate}, p{instrument,mp} {
             sbl.solve(p);
         }
         sbl_method(sbl_method const&) = default;
@@ -51,13 +51,25 @@ namespace bsm {
         long double exercise_boundary(long double _tau) override {
             return sbl.exercise_boundary(_tau);
         }
+
+        std::shared_ptr<const boundary_curve> exercise_boundary_curve() override {
+            return sbl.exercise_boundary_curve();
+        }
     };
 
     template<>
     std::unique_ptr<american_method> sbl_solver<autodiff_off>::operator()(american_put& instrument) {
-        sbl_method gp{instrument, mktParams, steps};
+        sbl_method gp{instrument, mktParams, steps, control_variate};
         return std::make_unique<sbl_method>(gp);
     }
 
+    template<>
+    std::unique_ptr<american_method> sbl_solver<autodiff_off>::operator()(american_call& instrument) {
+        return solve_by_symmetry(instrument, mktParams, [this](american_put& put, mkt_params<double> const& mp) {
+            sbl_solver<autodiff_off> solve{mp, steps, control_variate};
+            return solve(put);
+        });
+    }
+
 }
 
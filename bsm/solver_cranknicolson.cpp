@@ -0,0 +1,381 @@
+#include "solver.h"
+
+#include "solver_cranknicolson_internals.h"
+#include "solver_american_internals.h"
+
+#include <optional>
+#include <array>
+#include <mutex>
+#include <cassert>
+#include <iterator>
+
+using namespace bsm::internals;
+
+namespace bsm {
+
+    struct cranknicolson_method: pricing<double>, american_method {
+        const instrument_type type;
+        const bool early_exercise;
+        const crank_nicolson_grid grid;
+        crank_nicolson_values values;
+        std::optional<lattice_boundary_curve<double>> boundary;
+        //vega, rho and psi bumps (up and down) solved together on the same grid, on demand
+        std::optional<std::array<crank_nicolson_values, 6>> bumped;
+        lazy_boundary_curve curve_;
+
+        cranknicolson_method(instrument const& instrument, mkt_params<double> mp, bool early_exercise, int space_steps, int time_steps, double std_devs):
+                pricing{instrument, mp}, type{instrument.type}, early_exercise{early_exercise},
+                grid{instrument.type, early_exercise, S, K, sigma, tau, space_steps, time_steps, std_devs} {
+            crank_nicolson_solver<1> solve;
+            if (early_exercise) {
+                std::vector<double> steps_boundary;
+                values = solve(grid, {{{sigma, r, q}}}, &steps_boundary)[0];
+                boundary.emplace(tau, std::move(steps_boundary));
+            } else {
+                values = solve(grid, {{{sigma, r, q}}})[0];
+            }
+        }
+
+        double price() override {
+            return values.price;
+        }
+
+        double delta() override {
+            return values.delta;
+        }
+
+        double gamma() override {
+            return values.gamma;
+        }
+
+        double vega() override {
+            auto const& b = bumps();
+            return (b[0].price - b[1].price) / (2.0 * bump);
+        }
+
+        double theta() override {
+            return values.theta;
+        }
+
+        double rho() override {
+            auto const& b = bumps();
+            return (b[2].price - b[3].price) / (2.0 * bump);
+        }
+
+        double psi() override {
+            auto const& b = bumps();
+            return (b[4].price - b[5].price) / (2.0 * bump);
+        }
+
+        std::shared_ptr<const boundary_curve> exercise_boundary_curve() override {
+            return curve_.get([this] {
+                return std::make_shared<const boundary_curve>([this](double _tau) { return static_cast<double>(exercise_boundary(_tau)); }, tau, type);
+            });
+        }
+
+        long double exercise_boundary(long double _tau) override {
+            bool call = type == instrument_type::call;
+            if (never_optimal_exercise<double>(*this, type)) {
+                return call ? INFINITY : 0.0;
+            }
+            if (tau == 0) {
+                return exercise_boundary_at_maturity<double>(*this, type);
+            }
+            if (boundary) {
+                return boundary.value()(_tau);
+            }
+            return NAN;
+        }
+
+    private:
+        static constexpr double bump = 1e-4;
+
+        std::array<crank_nicolson_values, 6> const& bumps() {
+            if (not bumped) {
+                crank_nicolson_solver<6> solve;
+                bumped.emplace(solve(grid, {{{sigma + bump, r, q}, {sigma - bump, r, q},
+                                             {sigma, r + bump, q}, {sigma, r - bump, q},
+                                             {sigma, r, q + bump}, {sigma, r, q - bump}}}));
+            }
+            return *bumped;
+        }
+    };
+
+    /**
+     * Solution of a chain for the strike K0, shared by the methods of its strikes. The price and greeks of every
+     * node are read off once, vega, rho and psi from the bumped solves when first needed.
+     */
+    struct cranknicolson_chain {
+        const crank_nicolson_grid grid;
+        const crank_nicolson_lane lane;
+        std::vector<crank_nicolson_values> nodes;
+        std::optional<lattice_boundary_curve<double>> boundary;
+
+        cranknicolson_chain(instrument_type type, bool early_exercise, pricing<double> const& p, double K0, int space_steps, int time_steps, double std_devs, double reach):
+                grid{type, early_exercise, K0, K0, p.sigma, p.tau, space_steps, time_steps, std_devs, reach}, lane{p.sigma, p.r, p.q} {
+            crank_nicolson_solver<1> solve;
+            std::vector<double> line, steps_boundary;
+            solve(grid, {{lane}}, early_exercise ? &steps_boundary : nullptr, &line);
+            if (early_exercise) {
+                boundary.emplace(grid.tau, std::move(steps_boundary));
+            }
+            nodes.resize(grid.space_steps + 1);
+            for (int i = 1; i < grid.space_steps; i++) {
+                nodes[i] = crank_nicolson_node(grid, lane, line.data(), 1, i);
+            }
+        }
+
+        //Position of the spot S K0/K, equivalent for the strike K0 to the spot S for the strike K, in grid steps
+        double position(double _S, double K) const {
+            return (log(_S * grid.K / K) - grid.x_min) / grid.dx;
+        }
+
+        //The 4 nodes around a position are away from the edges of the grid and on the same side of the boundary
+        bool covers(double position) const {
+            auto k = static_cast<int>(std::floor(position));
+            return k >= 2 and k + 3 <= grid.space_steps and exercised(k - 1) == exercised(k + 2);
+        }
+
+        //Cubic interpolation of f(node) at a position, and the difference with the quadratic on the 3 nearest nodes
+        template<typename F>
+        std::pair<double, double> interpolate(double position, F const& f) const {
+            auto k = static_cast<int>(std::floor(position));
+            auto t = position - k;
+            double y[4] = {f(k - 1), f(k), f(k + 1), f(k + 2)};
+            auto cubic = -t * (t - 1) * (t - 2) / 6.0 * y[0] + (t + 1) * (t - 1) * (t - 2) / 2.0 * y[1]
+                         - (t + 1) * t * (t - 2) / 2.0 * y[2] + (t + 1) * t * (t - 1) / 6.0 * y[3];
+            double quadratic;
+            if (t < 0.5) {
+                quadratic = t * (t - 1) / 2.0 * y[0] - (t + 1) * (t - 1) * y[1] + (t + 1) * t / 2.0 * y[2];
+            } else {
+                quadratic = (t - 1) * (t - 2) / 2.0 * y[1] - t * (t - 2) * y[2] + t * (t - 1) / 2.0 * y[3];
+            }
+            return {cubic, std::abs(cubic - quadratic)};
+        }
+
+        //Whether the spot S K0/K of a position is in the exercise region at the valuation date
+        bool exercised(double position) const {
+            if (not boundary) {
+                return false;
+            }
+            auto B = boundary.value()(grid.tau);
+            auto _S = exp(grid.x_min + position * grid.dx);
+            return grid.type == instrument_type::put ? _S <= B : _S >= B;
+        }
+
+        //Vega, rho and psi of every node
+        std::vector<std::array<double, 3>> const& sensitivities() {
+            std::call_once(bumped, [this] {
+                crank_nicolson_solver<6> solve;
+                std::vector<double> line;
+                solve(grid, {{{lane.sigma + bump, lane.r, lane.q}, {lane.sigma - bump, lane.r, lane.q},
+                              {lane.sigma, lane.r + bump, lane.q}, {lane.sigma, lane.r - bump, lane.q},
+                              {lane.sigma, lane.r, lane.q + bump}, {lane.sigma, lane.r, lane.q - bump}}}, nullptr, &line);
+                sensitivities_.resize(grid.space_steps + 1);
+                for (int i = 0; i <= grid.space_steps; i++) {
+                    auto const* b = line.data() + 6 * i;
+                    sensitivities_[i] = {(b[0] - b[1]) / (2.0 * bump), (b[2] - b[3]) / (2.0 * bump), (b[4] - b[5]) / (2.0 * bump)};
+                }
+            });
+            return sensitivities_;
+        }
+
+    private:
+        static constexpr double bump = 1e-4;
+        std::once_flag bumped;
+        std::vector<std::array<double, 3>> sensitivities_;
+    };
+
+    /**
+     * A strike of a chain, read off the shared solution: with the scale K/K0, the price is scale V(S K0/K), delta
+     * V_S(S K0/K), gamma V_SS(S K0/K)/scale and theta, vega, rho and psi are scaled like the price.
+     */
+    struct cranknicolson_chain_method: pricing<double>, american_method {
+        const instrument_type type;
+        std::shared_ptr<cranknicolson_chain> chain;
+        const double scale;
+        const double position;
+        const bool exercised;
+        lazy_boundary_curve curve_;
+
+        cranknicolson_chain_method(instrument const& instrument, mkt_params<double> mp, std::shared_ptr<cranknicolson_chain> chain, double position):
+                pricing{instrument, mp}, type{instrument.type}, chain{std::move(chain)}, scale{K / this->chain->grid.K}, position{position},
+                exercised{this->chain->exercised(position)} {}
+
+        double price() override {
+            if (exercised) {
+                return type == instrument_type::put ? K - S : S - K;
+            }
+            return scale * chain->interpolate(position, [this](int i) { return chain->nodes[i].price; }).first;
+        }
+
+        double delta() override {
+            if (exercised) {
+                return type == instrument_type::put ? -1.0 : 1.0;
+            }
+            return chain->interpolate(position, [this](int i) { return chain->nodes[i].delta; }).first;
+        }
+
+        double gamma() override {
+            if (exercised) {
+                return 0.0;
+            }
+            return chain->interpolate(position, [this](int i) { return chain->nodes[i].gamma; }).first / scale;
+        }
+
+        double vega() override {
+            return sensitivity(0);
+        }
+
+        double theta() override {
+            if (exercised) {
+                return 0.0;
+            }
+            return scale * chain->interpolate(position, [this](int i) { return chain->nodes[i].theta; }).first;
+        }
+
+        double rho() override {
+            return sensitivity(1);
+        }
+
+        double psi() override {
+            return sensitivity(2);
+        }
+
+        std::shared_ptr<const boundary_curve> exercise_boundary_curve() override {
+            return curve_.get([this] {
+                return std::make_shared<const boundary_curve>([this](double _tau) { return static_cast<double>(exercise_boundary(_tau)); }, tau, type);
+            });
+        }
+
+        long double exercise_boundary(long double _tau) override {
+            bool call = type == instrument_type::call;
+            if (never_optimal_exercise<double>(*this, type)) {
+                return call ? INFINITY : 0.0;
+            }
+            if (tau == 0) {
+                return exercise_boundary_at_maturity<double>(*this, type);
+            }
+            if (chain->boundary) {
+                return scale * chain->boundary.value()(_tau);
+            }
+            return NAN;
+        }
+
+    private:
+        double sensitivity(int greek) {
+            if (exercised) {
+                return 0.0;
+            }
+            auto const& sensitivities = chain->sensitivities();
+            return scale * chain->interpolate(position, [&sensitivities, greek](int i) { return sensitivities[i][greek]; }).first;
+        }
+    };
+
+    /**
+     * Solves the chain once for the strike K0 (the spot, or the strike of the symmetric puts of calls), on a grid
+     * reaching the moneyness of every option, and reads the options off it. An option with the market markets[i] the
+     * interpolation can't price within tolerance is solved on its own.
+     */
+    template<typename I>
+    std::vector<std::unique_ptr<american_method>> price_chain(std::vector<I> const& chain, std::vector<mkt_params<double>> const& markets, double K0,
+                                                              bool early_exercise, int space_steps, int time_steps, double std_devs, double tolerance) {
+        std::vector<std::unique_ptr<american_method>> methods;
+        methods.reserve(chain.size());
+        if (chain.empty()) {
+            return methods;
+        }
+        pricing<double> p{chain.front(), markets.front()};
+        double reach = 0;
+        for (std::size_t i = 0; i < chain.size(); i++) {
+            assert(("The options of a chain must have the same maturity", chain[i].maturity == chain.front().maturity));
+            reach = std::max(reach, std::abs(log(markets[i].S / static_cast<double>(chain[i].K))));
+        }
+        std::shared_ptr<cranknicolson_chain> shared;
+        if (p.tau > 0) {
+            shared = std::make_shared<cranknicolson_chain>(chain.front().type, early_exercise, p, K0, space_steps, time_steps, std_devs, reach);
+        }
+        for (std::size_t i = 0; i < chain.size(); i++) {
+            if (shared) {
+                auto K = static_cast<double>(chain[i].K);
+                auto position = shared->position(markets[i].S, K);
+                if (shared->exercised(position) or shared->covers(position)) {
+                    auto error = K / K0 * shared->interpolate(position, [&shared](int j) { return shared->nodes[j].price; }).second;
+                    if (shared->exercised(position) or error <= tolerance) {
+                        methods.push_back(std::make_unique<cranknicolson_chain_method>(chain[i], markets[i], shared, position));
+                        continue;
+                    }
+                }
+            }
+            methods.push_back(std::make_unique<cranknicolson_method>(chain[i], markets[i], early_exercise, space_steps, time_steps, std_devs));
+        }
+        return methods;
+    }
+
+    template<typename I>
+    std::vector<std::unique_ptr<method>> price_european_chain(std::vector<I> const& chain, mkt_params<double> const& mp,
+                                                              int space_steps, int time_steps, double std_devs, double tolerance) {
+        auto american_methods = price_chain(chain, std::vector<mkt_params<double>>(chain.size(), mp), mp.S, false, space_steps, time_steps, std_devs, tolerance);
+        return {std::make_move_iterator(american_methods.begin()), std::make_move_iterator(american_methods.end())};
+    }
+
+    template<>
+    std::unique_ptr<method> cranknicolson_solver<autodiff_off>::operator()(european_call& instrument) {
+        cranknicolson_method gp{instrument, mktParams, false, space_steps, time_steps, std_devs};
+        return std::make_unique<cranknicolson_method>(gp);
+    }
+
+    template<>
+    std::unique_ptr<method> cranknicolson_solver<autodiff_off>::operator()(european_put& instrument) {
+        cranknicolson_method gp{instrument, mktParams, false, space_steps, time_steps, std_devs};
+        return std::make_unique<cranknicolson_method>(gp);
+    }
+
+    template<>
+    std::unique_ptr<american_method> cranknicolson_solver<autodiff_off>::operator()(american_put& instrument) {
+        cranknicolson_method gp{instrument, mktParams, true, space_steps, time_steps, std_devs};
+        return std::make_unique<cranknicolson_method>(gp);
+    }
+
+    template<>
+    std::unique_ptr<american_method> cranknicolson_solver<autodiff_off>::operator()(american_call& instrument) {
+        return solve_by_symmetry(instrument, mktParams, [this](american_put& put, mkt_params<double> const& mp) {
+            cranknicolson_solver<autodiff_off> solve{mp, space_steps, time_steps, std_devs};
+            return solve(put);
+        });
+    }
+
+    template<>
+    std::vector<std::unique_ptr<method>> cranknicolson_solver<autodiff_off>::operator()(std::vector<european_call> const& chain, double tolerance) {
+        return price_european_chain(chain, mktParams, space_steps, time_steps, std_devs, tolerance);
+    }
+
+    template<>
+    std::vector<std::unique_ptr<method>> cranknicolson_solver<autodiff_off>::operator()(std::vector<european_put> const& chain, double tolerance) {
+        return price_european_chain(chain, mktParams, space_steps, time_steps, std_devs, tolerance);
+    }
+
+    template<>
+    std::vector<std::unique_ptr<american_method>> cranknicolson_solver<autodiff_off>::operator()(std::vector<american_call> const& chain, double tolerance) {
+        //The symmetric puts have the strikes of the chain as spots and the spot as strike, so they share the grid of that strike
+        std::vector<american_put> puts;
+        std::vector<mkt_params<double>> markets;
+        puts.reserve(chain.size());
+        markets.reserve(chain.size());
+        for (auto const& instrument: chain) {
+            puts.push_back(symmetric_put(instrument, mktParams));
+            markets.push_back(symmetric_market(instrument, mktParams));
+        }
+        auto methods = price_chain(puts, markets, mktParams.S, true, space_steps, time_steps, std_devs, tolerance);
+        for (std::size_t i = 0; i < chain.size(); i++) {
+            methods[i] = std::make_unique<symmetric_call_method>(chain[i], mktParams, std::move(methods[i]));
+        }
+        return methods;
+    }
+
+    template<>
+    std::vector<std::unique_ptr<american_method>> cranknicolson_solver<autodiff_off>::operator()(std::vector<american_put> const& chain, double tolerance) {
+        return price_chain(chain, std::vector<mkt_params<double>>(chain.size(), mktParams), mktParams.S, true, space_steps, time_steps, std_devs, tolerance);
+    }
+
+}
@@ -0,0 +1,346 @@
+#ifndef BSM_SOLVER_CRANKNICOLSON_INTERNALS_H
+#define BSM_SOLVER_CRANKNICOLSON_INTERNALS_H
+
+#include "common.h"
+#include "instruments.h"
+#include "solver.h"
+#include "solver_american_internals.h"
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace bsm {
+    namespace internals {
+
+        /**
+         * Uniform grid of x = ln S shared by every lane of a Crank-Nicolson solve. The spot is the node `spot`, in the
+         * middle of the grid, so the greeks are read off the nodes around it. The grid spans std_devs standard
+         * deviations (of ln S at maturity) on each side of the spot, plus the distance to the strike or, if larger,
+         * `reach` (a chain of strikes is read off the grid up to that distance from the spot).
+         */
+        struct crank_nicolson_grid {
+            const instrument_type type;
+            const bool early_exercise;
+            const double S, K, tau;
+            const int space_steps, time_steps;
+            const int spot;
+            const double dx, x_min;
+
+            crank_nicolson_grid(instrument_type type, bool early_exercise, double S, double K, double sigma, double tau,
+                                int space_steps, int time_steps, double std_devs, double reach = 0):
+                    type{type}, early_exercise{early_exercise}, S{S}, K{K}, tau{tau},
+                    space_steps{space_steps}, time_steps{time_steps}, spot{space_steps / 2},
+                    dx{(std_devs * sigma * sqrt(std::max(tau, 0.0)) + std::max(std::abs(log(K / S)), reach)) / spot},
+                    x_min{log(S) - spot * dx} {
+                assert(("The grid needs an even number of space steps", space_steps >= 4 and space_steps % 2 == 0));
+                assert(("The grid needs at least 2 time steps", time_steps >= 2));
+            }
+
+            double underlying(int i) const {
+                return exp(x_min + i * dx);
+            }
+
+            double payoff(double _S) const {
+                return std::max(type == instrument_type::put ? K - _S : _S - K, 0.0);
+            }
+        };
+
+        //Volatility and rates of one lane
+        struct crank_nicolson_lane {
+            double sigma, r, q;
+        };
+
+        struct crank_nicolson_values {
+            double price, delta, gamma, theta;
+        };
+
+        /**
+         * Price and greeks at node i (0 < i < space_steps) of the values V of one lane, the values of node j being
+         * V[j * stride]: V_S = V_x/S, V_SS = (V_xx - V_x)/S^2 and theta = -dV/dtau = -L V, which is 0 where exercised.
+         */
+        inline crank_nicolson_values crank_nicolson_node(crank_nicolson_grid const& grid, crank_nicolson_lane const& lane, double const* V, int stride, int i) {
+            auto alpha = 0.5 * lane.sigma * lane.sigma / (grid.dx * grid.dx);
+            auto beta = (lane.r - lane.q - 0.5 * lane.sigma * lane.sigma) / (2.0 * grid.dx);
+            auto _S = grid.underlying(i);
+            auto payoff = grid.payoff(_S);
+            auto value = V[i * stride];
+            auto up = V[(i + 1) * stride];
+            auto down = V[(i - 1) * stride];
+            auto V_x = (up - down) / (2.0 * grid.dx);
+            auto V_xx = (up - 2.0 * value + down) / (grid.dx * grid.dx);
+            auto exercised = grid.early_exercise and payoff > 0 and value <= payoff;
+            return {value, V_x / _S, (V_xx - V_x) / (_S * _S),
+                    exercised ? 0.0 : -((alpha - beta) * down + (-2.0 * alpha - lane.r) * value + (alpha + beta) * up)};
+        }
+
+        /**
+         * Crank-Nicolson solve of the Black-Scholes PDE in ln S for Lanes sets of (sigma, r, q) on the same grid, eg
+         * the bumps of vega, rho and psi. The lanes are interleaved (node i of lane l is element i*Lanes+l of the
+         * buffers), so every step of the Thomas sweeps below is a loop over the lanes that the compiler vectorizes.
+         *
+         * The first two Crank-Nicolson steps are replaced by four implicit Euler half steps (Rannacher), which damps
+         * the oscillations the kink of the payoff causes in delta and gamma. Early exercise is handled by the
+         * Brennan-Schwartz algorithm: the tridiagonal system is eliminated from the continuation end of the grid and
+         * the back substitution, which runs from the exercise end, takes the max with the payoff node by node.
+         *
+         * The buffers are thread local and reused from one solve to the next, so a solve doesn't allocate once the
+         * thread has seen a grid as large. With a boundary vector, the exercise boundary of lane 0 is stored at every
+         * time step (index k is k steps after the valuation date, see lattice_boundary_curve). With a line vector, the
+         * values of every node at the valuation date are copied to it, interleaved like the buffers.
+         */
+        template<int Lanes>
+        struct crank_nicolson_solver {
+            //Fully implicit half steps replacing the first Crank-Nicolson steps
+            static constexpr int rannacher_half_steps = 4;
+
+            std::array<crank_nicolson_values, Lanes> operator()(crank_nicolson_grid const& grid, std::array<crank_nicolson_lane, Lanes> const& lanes,
+                                                                std::vector<double>* boundary = nullptr, std::vector<double>* line = nullptr) const {
+                std::array<crank_nicolson_values, Lanes> values;
+                if (grid.tau <= 0) {
+                    auto payoff = grid.payoff(grid.S);
+                    auto delta = payoff > 0 ? (grid.type == instrument_type::put ? -1.0 : 1.0) : 0.0;
+                    values.fill({payoff, delta, 0.0, 0.0});
+                    if (boundary) {
+                        boundary->assign(1, grid.early_exercise ? grid.K : NAN);
+                    }
+                    if (line) {
+                        line->resize((grid.space_steps + 1) * Lanes);
+                        for (int i = 0; i <= grid.space_steps; i++) {
+                            std::fill_n(line->begin() + i * Lanes, Lanes, grid.payoff(grid.underlying(i)));
+                        }
+                    }
+                    return values;
+                }
+
+                const int M = grid.space_steps;
+                auto& w = buffers();
+                w.resize(M, Lanes);
+                for (int i = 0; i <= M; i++) {
+                    w.underlying[i] = grid.underlying(i);
+                    w.payoff[i] = grid.payoff(w.underlying[i]);
+                    for (int l = 0; l < Lanes; l++) {
+                        w.V[i * Lanes + l] = w.payoff[i];
+                    }
+                }
+
+                //Operator L V = l V[i-1] + d V[i] + u V[i+1] of each lane
+                double lower[Lanes], diagonal[Lanes], upper[Lanes];
+                for (int l = 0; l < Lanes; l++) {
+                    auto alpha = 0.5 * lanes[l].sigma * lanes[l].sigma / (grid.dx * grid.dx);
+                    auto beta = (lanes[l].r - lanes[l].q - 0.5 * lanes[l].sigma * lanes[l].sigma) / (2.0 * grid.dx);
+                    lower[l] = alpha - beta;
+                    diagonal[l] = -2.0 * alpha - lanes[l].r;
+                    upper[l] = alpha + beta;
+                }
+
+                auto dt = grid.tau / grid.time_steps;
+                scheme implicit{grid, lower, diagonal, upper, 1.0, 0.5 * dt, w.factors[0]};
+                scheme cn{grid, lower, diagonal, upper, 0.5, dt, w.factors[1]};
+
+                if (boundary) {
+                    boundary->assign(grid.time_steps + 1, NAN);
+                    (*boundary)[grid.time_steps] = grid.early_exercise ? exercise_boundary_at_maturity<double>(pricing<double>{grid.S, grid.K, lanes[0].sigma, 0.0, lanes[0].r, lanes[0].q}, grid.type) : NAN;
+                }
+                exercise_frontier_tracker tracker{grid.type};
+                double elapsed = 0;
+                int half_steps = std::min(rannacher_half_steps, 2 * grid.time_steps);
+                for (int n = 0; n < half_steps; n++) {
+                    elapsed += 0.5 * dt;
+                    step(grid, lanes, implicit, elapsed, w);
+                    if (n % 2 == 1 and boundary) {
+                        (*boundary)[grid.time_steps - (n + 1) / 2] = frontier(grid, tracker, w, (*boundary)[grid.time_steps - (n - 1) / 2]);
+                    }
+                }
+                for (int n = half_steps / 2; n < grid.time_steps; n++) {
+                    elapsed = (n + 1) * dt;
+                    step(grid, lanes, cn, elapsed, w);
+                    if (boundary) {
+                        (*boundary)[grid.time_steps - n - 1] = frontier(grid, tracker, w, (*boundary)[grid.time_steps - n]);
+                    }
+                }
+
+                for (int l = 0; l < Lanes; l++) {
+                    values[l] = crank_nicolson_node(grid, lanes[l], w.V.data() + l, Lanes, grid.spot);
+                }
+                if (line) {
+                    line->assign(w.V.begin(), w.V.begin() + (M + 1) * Lanes);
+                }
+                return values;
+            }
+
+        private:
+            struct workspace {
+                std::vector<double> underlying, payoff, V, rhs;
+                //inverse pivots and multipliers of the elimination, implicit half steps then Crank-Nicolson steps
+                std::array<std::vector<double>, 2> factors;
+
+                void resize(int M, int lanes) {
+                    underlying.resize(M + 1);
+                    payoff.resize(M + 1);
+                    V.resize((M + 1) * lanes);
+                    rhs.resize((M + 1) * lanes);
+                    for (auto& f: factors) {
+                        f.resize(2 * (M + 1) * lanes);
+                    }
+                }
+            };
+
+            static workspace& buffers() {
+                thread_local workspace w;
+                return w;
+            }
+
+            /**
+             * The theta scheme (I - theta h L) V(tau + h) = (I + (1 - theta) h L) V(tau), with the elimination of its
+             * left hand side done once. A put is exercised at the low end of the grid, so its system is eliminated
+             * from the top (row i keeps V[i-1] and V[i]) and solved from the bottom; a call the other way around.
+             */
+            struct scheme {
+                const double theta, h;
+                double a_lower[Lanes], a_diagonal[Lanes], a_upper[Lanes];
+                double explicit_lower[Lanes], explicit_diagonal[Lanes], explicit_upper[Lanes];
+                //inverse pivot of row i at [2 (i Lanes + l)], multiplier at [2 (i Lanes + l) + 1]
+                double* factors;
+
+                scheme(crank_nicolson_grid const& grid, double const* lower, double const* diagonal, double const* upper,
+                       double theta, double h, std::vector<double>& storage): theta{theta}, h{h}, factors{storage.data()} {
+                    const int M = grid.space_steps;
+                    for (int l = 0; l < Lanes; l++) {
+                        a_lower[l] = -theta * h * lower[l];
+                        a_diagonal[l] = 1.0 - theta * h * diagonal[l];
+                        a_upper[l] = -theta * h * upper[l];
+                        explicit_lower[l] = (1.0 - theta) * h * lower[l];
+                        explicit_diagonal[l] = 1.0 + (1.0 - theta) * h * diagonal[l];
+                        explicit_upper[l] = (1.0 - theta) * h * upper[l];
+                    }
+                    if (grid.type == instrument_type::put) {
+                        for (int l = 0; l < Lanes; l++) {
+                            factors[2 * ((M - 1) * Lanes + l)] = 1.0 / a_diagonal[l];
+                            factors[2 * ((M - 1) * Lanes + l) + 1] = 0.0;
+                        }
+                        for (int i = M - 2; i >= 1; i--) {
+                            for (int l = 0; l < Lanes; l++) {
+                                auto m = a_upper[l] * factors[2 * ((i + 1) * Lanes + l)];
+                                factors[2 * (i * Lanes + l)] = 1.0 / (a_diagonal[l] - m * a_lower[l]);
+                                factors[2 * (i * Lanes + l) + 1] = m;
+                            }
+                        }
+                    } else {
+                        for (int l = 0; l < Lanes; l++) {
+                            factors[2 * (Lanes + l)] = 1.0 / a_diagonal[l];
+                            factors[2 * (Lanes + l) + 1] = 0.0;
+                        }
+                        for (int i = 2; i <= M - 1; i++) {
+                            for (int l = 0; l < Lanes; l++) {
+                                auto m = a_lower[l] * factors[2 * ((i - 1) * Lanes + l)];
+                                factors[2 * (i * Lanes + l)] = 1.0 / (a_diagonal[l] - m * a_upper[l]);
+                                factors[2 * (i * Lanes + l) + 1] = m;
+                            }
+                        }
+                    }
+                }
+            };
+
+            //Value of the far ends of the grid: the discounted forward intrinsic value, or the payoff if exercised
+            static double edge(crank_nicolson_grid const& grid, crank_nicolson_lane const& lane, double _S, double _tau) {
+                auto forward = _S * exp(-lane.q * _tau) - grid.K * exp(-lane.r * _tau);
+                auto value = std::max(grid.type == instrument_type::put ? -forward : forward, 0.0);
+                return grid.early_exercise ? std::max(value, grid.payoff(_S)) : value;
+            }
+
+            static void step(crank_nicolson_grid const& grid, std::array<crank_nicolson_lane, Lanes> const& lanes, scheme const& s, double _tau, workspace& w) {
+                const int M = grid.space_steps;
+                double* V = w.V.data();
+                double* rhs = w.rhs.data();
+                double const* f = s.factors;
+                double const* payoff = w.payoff.data();
+                auto project = grid.early_exercise;
+
+                for (int i = 1; i < M; i++) {
+                    for (int l = 0; l < Lanes; l++) {
+                        rhs[i * Lanes + l] = s.explicit_lower[l] * V[(i - 1) * Lanes + l] + s.explicit_diagonal[l] * V[i * Lanes + l]
+                                             + s.explicit_upper[l] * V[(i + 1) * Lanes + l];
+                    }
+                }
+                for (int l = 0; l < Lanes; l++) {
+                    V[l] = edge(grid, lanes[l], w.underlying[0], _tau);
+                    V[M * Lanes + l] = edge(grid, lanes[l], w.underlying[M], _tau);
+                }
+
+                if (grid.type == instrument_type::put) {
+                    for (int l = 0; l < Lanes; l++) {
+                        rhs[(M - 1) * Lanes + l] -= s.a_upper[l] * V[M * Lanes + l];
+                    }
+                    for (int i = M - 2; i >= 1; i--) {
+                        for (int l = 0; l < Lanes; l++) {
+                            rhs[i * Lanes + l] -= f[2 * (i * Lanes + l) + 1] * rhs[(i + 1) * Lanes + l];
+                        }
+                    }
+                    for (int i = 1; i < M; i++) {
+                        for (int l = 0; l < Lanes; l++) {
+                            auto v = (rhs[i * Lanes + l] - s.a_lower[l] * V[(i - 1) * Lanes + l]) * f[2 * (i * Lanes + l)];
+                            V[i * Lanes + l] = project ? std::max(v, payoff[i]) : v;
+                        }
+                    }
+                } else {
+                    for (int l = 0; l < Lanes; l++) {
+                        rhs[Lanes + l] -= s.a_lower[l] * V[l];
+                    }
+                    for (int i = 2; i <= M - 1; i++) {
+                        for (int l = 0; l < Lanes; l++) {
+                            rhs[i * Lanes + l] -= f[2 * (i * Lanes + l) + 1] * rhs[(i - 1) * Lanes + l];
+                        }
+                    }
+                    for (int i = M - 1; i >= 1; i--) {
+                        for (int l = 0; l < Lanes; l++) {
+                            auto v = (rhs[i * Lanes + l] - s.a_upper[l] * V[(i + 1) * Lanes + l]) * f[2 * (i * Lanes + l)];
+                            V[i * Lanes + l] = project ? std::max(v, payoff[i]) : v;
+                        }
+                    }
+                }
+            }
+
+            /**
+             * Exercise boundary of lane 0. By smooth pasting the time value V - payoff grows like (S - B)^2 next to
+             * the boundary, so its square root is extrapolated linearly from the first two continuation nodes, which
+             * locates the boundary inside a grid interval. The tracker numbers the nodes from the highest spot,
+             * like a lattice layer.
+             */
+            static double frontier(crank_nicolson_grid const& grid, exercise_frontier_tracker& tracker, workspace const& w, double fallback) {
+                if (not grid.early_exercise) {
+                    return NAN;
+                }
+                const int M = grid.space_steps;
+                auto exercised = [&w, M](int j) {
+                    auto i = M - j;
+                    return w.payoff[i] > 0 and w.V[i * Lanes] <= w.payoff[i];
+                };
+                int b = tracker.track(1, M - 1, 0, exercised);
+                if (b < 0) {
+                    return fallback;
+                }
+                int i = M - b;
+                int direction = grid.type == instrument_type::put ? 1 : -1;
+                int c1 = i + direction, c2 = i + 2 * direction;
+                if (c2 < 0 or c2 > M) {
+                    return w.underlying[i];
+                }
+                auto g1 = sqrt(std::max(w.V[c1 * Lanes] - w.payoff[c1], 0.0));
+                auto g2 = sqrt(std::max(w.V[c2 * Lanes] - w.payoff[c2], 0.0));
+                if (g2 <= g1) {
+                    return w.underlying[i];
+                }
+                auto B = w.underlying[c1] - g1 * (w.underlying[c2] - w.underlying[c1]) / (g2 - g1);
+                //the projection can leave the frontier node on the payoff although the boundary is a bit past it
+                auto e = std::clamp(i - direction, 0, M);
+                return std::clamp(B, std::min(w.underlying[e], w.underlying[c1]), std::max(w.underlying[e], w.underlying[c1]));
+            }
+        };
+
+    }
+}
+
+#endif //BSM_SOLVER_CRANKNICOLSON_INTERNALS_H
@@ -3,6 +3,7 @@
 #include "solver_crr_internals.h"
 #include "solver_american_internals.h"
 
+#include <algorithm>
 #include <optional>
 
 using namespace bsm::internals;
@@ -14,22 +15,26 @@ namespace bsm {
         generic_crr_pricing_method<double> crr;
         const instrument instrument_;
         const int steps;
+        const double std_devs;
         const bool early_exercise;
-        std::optional<std::vector<double>> boundary;
+        const bool control_variate;
+        std::optional<lattice_boundary_curve<double>> boundary;
+        lazy_boundary_curve curve_;
 
-        crr_pricing_method(european const& instrument, mkt_params<double> mp, int steps):
-        pricing{instrument,mp}, crr{instrument, mp, steps}, calc_payoff{[&instrument](double price) { return instrument.payoff(price); }}, steps{steps}, instrument_{instrument}, early_exercise{false}
+        crr_pricing_method(european const& instrument, mkt_params<double> mp, int steps, double std_devs = 0):
+        pricing{instrument,mp}, crr{instrument, mp, steps, 0, std_devs}, calc_payoff{[&instrument](double price) { return instrument.payoff(price); }}, steps{steps}, std_devs{std_devs}, instrument_{instrument}, early_exercise{false}, control_variate{false}
         {
             crr.solve(calc_payoff, early_exercise);
         }
 
-        crr_pricing_method(american const& instrument, mkt_params<double> mp, int steps, int extra = 0):
-                pricing{instrument,mp}, crr{instrument, mp, steps+extra, extra}, calc_payoff{[&instrument](double price) { return instrument.payoff(price); }}, steps{steps}, instrument_{instrument}, early_exercise{true}
+        crr_pricing_method(american const& instrument, mkt_params<double> mp, int steps, int extra = 0, double std_devs = 0, bool control_variate = false):
+                pricing{instrument,mp}, crr{instrument, mp, steps+extra, extra, std_devs, control_variate}, calc_payoff{[K = static_cast<double>(instrument.K), type = instrument.type](double price) { return std::max(type == instrument_type::call ? price - K : K - price, 0.0); }}, steps{steps}, std_devs{std_devs}, instrument_{instrument}, early_exercise{true}, control_variate{control_variate}
         {
-            boundary = crr.solve(calc_payoff, early_exercise);
+            auto steps_boundary = crr.solve(calc_payoff, early_exercise);
             if(extra>0) {
-                boundary->erase(boundary->begin(), boundary->begin()+extra);
+                steps_boundary.erase(steps_boundary.begin(), steps_boundary.begin()+extra);
             }
+            boundary.emplace(tau, std::move(steps_boundary));
         }
 
         double price() override {
@@ -47,7 +52,7 @@ namespace bsm {
         double vega() override {
             pricing_params<double> bumped_up {crr.pp };
             bumped_up.sigma *= exp(0.01);
-            generic_crr_pricing_method<double> bumped_up_crr{instrument_, bumped_up, steps};
+            generic_crr_pricing_method<double> bumped_up_crr{instrument_, bumped_up, steps, 0, std_devs, control_variate};
             bumped_up_crr.solve(calc_payoff, early_exercise);
             return (bumped_up_crr.price() - crr.price()) / (bumped_up.sigma - crr.pp.sigma);
         }
@@ -58,8 +63,11 @@ namespace bsm {
 
         double rho() override {
             pricing_params<double> bumped_up {crr.pp };
-            bumped_up.r *= exp(0.01);
-            generic_crr_pricing_method<double> bumped_up_crr{instrument_, bumped_up, steps};
+            if(bumped_up.r!=0)
+                bumped_up.r *= exp(0.01);
+            else
+                bumped_up.r += 0.01;
+            generic_crr_pricing_method<double> bumped_up_crr{instrument_, bumped_up, steps, 0, std_devs, control_variate};
             bumped_up_crr.solve(calc_payoff,early_exercise);
             return (bumped_up_crr.price() - crr.price()) / (bumped_up.r - crr.pp.r);
         }
@@ -70,11 +78,17 @@ namespace bsm {
                 bumped_up.q *= exp(0.01);
             else
                 bumped_up.q += 0.01;
-            generic_crr_pricing_method<double> bumped_up_crr{instrument_, bumped_up, steps};
+            generic_crr_pricing_method<double> bumped_up_crr{instrument_, bumped_up, steps, 0, std_devs, control_variate};
             bumped_up_crr.solve(calc_payoff,early_exercise);
             return (bumped_up_crr.price() - crr.price()) / (bumped_up.q - crr.pp.q);
         }
 
+        std::shared_ptr<const boundary_curve> exercise_boundary_curve() override {
+            return curve_.get([this] {
+                return std::make_shared<const boundary_curve>([this](double _tau) { return static_cast<double>(exercise_boundary(_tau)); }, tau, instrument_.type);
+            });
+        }
+
         long double exercise_boundary(long double _tau) override {
             bool call = instrument_.type==instrument_type::call;
             bool put = instrument_.type==instrument_type::put;
@@ -86,11 +100,7 @@ namespace bsm {
             }
 
             if(boundary) {
-                std::cout << "Boundary size: "<< boundary.value().size() << std::endl;
-                int index = steps*(1.0- _tau/tau);
-                if(index >=0 && index <=steps) {
-                    return boundary.value()[index];
-                }
+                return boundary.value()(_tau);
             }
 
             return NAN;
@@ -100,33 +110,118 @@ namespace bsm {
 
     template<>
     std::unique_ptr<method> crr_solver<autodiff_off>::operator()(european_forward& instrument) {
-        crr_pricing_method gp{instrument, mktParams, steps};
+        crr_pricing_method gp{instrument, mktParams, steps, std_devs};
         return std::make_unique<crr_pricing_method>(gp);
     }
 
     template<>
     std::unique_ptr<method> crr_solver<autodiff_off>::operator()(european_call& instrument) {
-        crr_pricing_method gp{instrument, mktParams, steps };
+        crr_pricing_method gp{instrument, mktParams, steps, std_devs};
         return std::make_unique<crr_pricing_method>(gp);
     }
 
     template<>
     std::unique_ptr<method> crr_solver<autodiff_off>::operator()(european_put& instrument) {
-        crr_pricing_method gp{instrument, mktParams, steps };
+        crr_pricing_method gp{instrument, mktParams, steps, std_devs};
         return std::make_unique<crr_pricing_method>(gp);
     }
 
     template<>
-    std::unique_ptr<american_method> crr_solver<autodiff_off>::operator()(american_call& instrument) {
-        crr_pricing_method gp{instrument, mktParams, steps, extra_steps };
+    std::unique_ptr<american_method> crr_solver<autodiff_off>::operator()(american_put& instrument) {
+        crr_pricing_method gp{instrument, mktParams, steps, extra_steps, std_devs, control_variate};
         return std::make_unique<crr_pricing_method>(gp);
     }
 
     template<>
-    std::unique_ptr<american_method> crr_solver<autodiff_off>::operator()(american_put& instrument) {
-        crr_pricing_method gp{instrument, mktParams, steps, extra_steps };
-        return std::make_unique<crr_pricing_method>(gp);
+    std::unique_ptr<american_method> crr_solver<autodiff_off>::operator()(american_call& instrument) {
+        return solve_by_symmetry(instrument, mktParams, [this](american_put& put, mkt_params<double> const& mp) {
+            crr_solver<autodiff_off> solve{mp, steps, extra_steps, std_devs, control_variate};
+            return solve(put);
+        });
     }
 
-}
+    template<>
+    std::vector<double> crr_solver<autodiff_off>::operator()(instrument_columns const& chain, market_context const& context) {
+        if (std_devs > 0) {
+            //The band of a truncated tree depends on the contract, so each one is priced on its own tree
+            crr_solver<autodiff_off> solve{mkt_params<double>{context.S(), context.sigma(), mktParams.t, context.r(), context.q()},
+                                           steps, extra_steps, std_devs, control_variate};
+            std::vector<double> prices(chain.size());
+            parallel_for(0, static_cast<int>(chain.size()), [this, &solve, &chain, &context, &prices](int row) {
+                auto valuation = mktParams.t;
+                datetime maturity = valuation + frac_years{context[chain.expiries[row]].tau};
+                auto K = chain.strike(row);
+                bool american = chain.style(row) == american_exercise;
+                switch (chain.type(row)) {
+                    case instrument_type::call:
+                        if (american) {
+                            american_call call{K, maturity};
+                            prices[row] = solve(call)->price();
+                        } else {
+                            european_call call{K, maturity};
+                            prices[row] = solve(call)->price();
+                        }
+                        break;
+                    case instrument_type::put:
+                        if (american) {
+                            american_put put{K, maturity};
+                            prices[row] = solve(put)->price();
+                        } else {
+                            european_put put{K, maturity};
+                            prices[row] = solve(put)->price();
+                        }
+                        break;
+                    default:
+                        european_forward forward{K, maturity};
+                        prices[row] = solve(forward)->price();
+                }
+            }, 1);
+            return prices;
+        }
+        std::vector<crr_expiry_lattice> lattices;
+        lattices.reserve(context.size());
+        for (std::size_t e = 0; e < context.size(); e++) {
+            lattices.emplace_back(context.sigma(), context.r(), context.q(), context[e], steps, extra_steps);
+        }
+        std::vector<double> prices(chain.size());
+        parallel_for(0, static_cast<int>(chain.size()), [this, &chain, &context, &lattices, &prices](int row) {
+            auto levels = steps + extra_steps;
+            thread_local std::vector<double> scratch;
+            scratch.resize(2 * (levels + 1));
+            auto const& market = context[chain.expiries[row]];
+            auto S = context.S();
+            auto K = chain.strike(row);
+            auto type = chain.type(row);
+            bool american = chain.style(row) == american_exercise;
+            if (market.tau <= 0) {
+                prices[row] = type == instrument_type::call ? std::max(S - K, 0.0) : type == instrument_type::put ? std::max(K - S, 0.0) : S - K;
+                return;
+            }
+            auto const& lattice = lattices[chain.expiries[row]];
+            double value, european;
+            if (american and type == instrument_type::call) {
+                //Symmetric put, rooted at the strike with the rates swapped, as the american calls of the tree
+                value = lattice.price(1, K, S, instrument_type::put, true, control_variate, scratch.data(), scratch.data() + levels + 1, european);
+            } else {
+                value = lattice.price(0, S, K, type, american, control_variate, scratch.data(), scratch.data() + levels + 1, european);
+            }
+            if (american and control_variate) {
+                value += (type == instrument_type::call ? calculate_european_call(market, K) : calculate_european_put(market, K)) - european;
+            }
+            prices[row] = value;
+        }, 8);
+        return prices;
+    }
+
+    template<>
+    std::vector<double> crr_solver<autodiff_off>::operator()(instrument_columns const& chain) {
+        return (*this)(chain, market_context{mktParams, chain.taus});
+    }
+
+    template<>
+    double crr_solver<autodiff_off>::truncation_error(instrument const& instrument) const {
+        pricing_params<double> pp{instrument, mktParams};
+        return truncation_error_bound<double>(pp, instrument.type, std_devs);
+    }
 
+}
\ No newline at end of file
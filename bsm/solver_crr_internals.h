@@ -5,12 +5,16 @@
 #include "common.h"
 #include "instruments.h"
 #include "solver.h"
+#include "solver_analytical_internals.h"
+#include "solver_american_internals.h"
+
+#include "executor.h"
 
 #include <vector>
 #include <iostream>
 #include <algorithm>
-#include <execution>
 #include <utility>
+#include <optional>
 
 namespace bsm {
     namespace internals {
@@ -34,30 +38,78 @@ namespace bsm {
             pricing_params(pricing_params &&) noexcept = default;
         };
 
+        /**
+         * Half width, in lattice levels, of a tree truncated at std_devs standard deviations of log(S) at maturity.
+         * Zero standard deviations means the full tree.
+         */
+        inline int truncation_width(int steps, double std_devs) {
+            if (std_devs <= 0) {
+                return steps;
+            }
+            return std::min(steps, std::max(2, static_cast<int>(std::ceil(std_devs * std::sqrt(steps)))));
+        }
+
+        /**
+         * Bound on the price error caused by replacing the lattice beyond std_devs standard deviations by analytic
+         * values. It is the probability (reflection principle, drift taken off the distance) of ever reaching the cut
+         * times the largest payoff found there.
+         */
+        template<typename T>
+        T truncation_error_bound(pricing_params<T> const& pp, instrument_type type, double std_devs) {
+            if (std_devs <= 0) {
+                return 0.0;
+            }
+            auto vol = pp.sigma * sqrt(pp.tau);
+            auto drift = std::abs(pp.r - pp.q - pp.sigma * pp.sigma / 2.0) * pp.tau;
+            auto distance = std::max(0.0, std_devs - drift / vol);
+            auto payoff = type == instrument_type::put ? static_cast<T>(pp.K) : pp.S * exp(std_devs * vol);
+            return 2.0 * cdf<T>(-distance) * payoff;
+        }
+
+        /**
+         * Cox-Ross-Rubinstein tree. With control_variate, an american solve also runs the european backward induction
+         * in the same pass and the nodes read by the greeks are worth american - european + Black-Scholes: the lattice
+         * error of the european price, known exactly, is taken off the american one.
+         */
         template<typename T>
         struct generic_crr_pricing_method {
         protected:
             const int steps;
             const int shift;
+            const double std_devs;
             const instrument_type type;
+            const bool control_variate;
             bintree<T> underlying_tree;
             bintree<std::pair<T,bool>> premium_tree;
+            std::optional<bintree<T>> european_tree;
             T u_, d_, p_, discount_factor_;
         public:
             pricing_params<T> pp;
-            generic_crr_pricing_method(instrument const& instrument, mkt_params<double> mp, int steps, int shift = 0):
+            generic_crr_pricing_method(instrument const& instrument, mkt_params<double> mp, int steps, int shift = 0, double std_devs = 0, bool control_variate = false):
                     pp{instrument, mp},
-                    underlying_tree{steps + 1}, premium_tree{steps + 1}, steps{steps}, shift{shift}, type{instrument.type} {
+                    underlying_tree{steps + 1, truncation_width(steps, std_devs)}, premium_tree{steps + 1, truncation_width(steps, std_devs)},
+                    steps{steps}, shift{shift}, std_devs{std_devs}, type{instrument.type}, control_variate{control_variate} {
                 generate_underlying_tree();
             }
-            generic_crr_pricing_method(instrument const& instrument, pricing_params<T> pp, int steps, int shift = 0):
+            generic_crr_pricing_method(instrument const& instrument, pricing_params<T> pp, int steps, int shift = 0, double std_devs = 0, bool control_variate = false):
                     pp{pp},
-                    underlying_tree{steps + 1}, premium_tree{steps + 1}, steps{steps}, shift{shift}, type{instrument.type} {
+                    underlying_tree{steps + 1, truncation_width(steps, std_devs)}, premium_tree{steps + 1, truncation_width(steps, std_devs)},
+                    steps{steps}, shift{shift}, std_devs{std_devs}, type{instrument.type}, control_variate{control_variate} {
                 generate_underlying_tree();
             }
 
+            T truncation_error() const {
+                return truncation_error_bound<T>(pp, type, std_devs);
+            }
+
             T pt(int i, int j) {
-                return premium_tree(i + shift, j + shift / 2).first;
+                auto t = i + shift;
+                auto k = j + shift / 2;
+                if (european_tree) {
+                    auto dt = pp.tau / (steps - shift);
+                    return premium_tree(t, k).first - (*european_tree)(t, k) + european_value(underlying_tree(t, k), (steps - t) * dt);
+                }
+                return premium_tree(t, k).first;
             }
 
             T ut(int i, int j) {
@@ -73,14 +125,11 @@ namespace bsm {
                 discount_factor_ = exp(-pp.r * dt);
                 auto S = pp.S;
                 underlying_tree.set(0, 0, S);
-                std::vector<int> indices(steps+1);
-                std::iota(indices.begin(),indices.end(), 0);
                 for (int t = 1; t <= steps; ++t) {
-                    auto start = indices.begin();
-                    auto end = start+t+1;
+                    auto first = underlying_tree.first(t);
                     auto [output, _ ] = underlying_tree(t);
-                    transform(std::execution::par_unseq, start, end, output, [&S,&u,&d,&t](int i) {
-                        return S*pow(u,t-i)*pow(d,i);
+                    parallel_for(first, underlying_tree.last(t)+1, [&S,&u,&d,&t,first,output](int i) {
+                        *(output+(i-first)) = S*pow(u,t-i)*pow(d,i);
                     });
                 }
             }
@@ -118,86 +167,78 @@ namespace bsm {
                 auto last_t = steps;
                 auto p = p_;
                 auto discount_factor = discount_factor_;
+                if (control_variate and early_exercise_possible) {
+                    european_tree.emplace(premium_tree.size(), truncation_width(steps, std_devs));
+                } else {
+                    european_tree.reset();
+                }
+                auto european = european_tree ? &*european_tree : nullptr;
                 {
-                    auto [start, end] = underlying_tree(last_t);
+                    auto first = premium_tree.first(last_t);
                     auto [output, _] = premium_tree(last_t);
-                    std::transform(std::execution::par_unseq, start, end, output, [&calc_payoff](T const& price) {
-                        return std::make_pair(calc_payoff(price),false);
+                    parallel_for(first, premium_tree.last(last_t)+1, [&calc_payoff, first, output, last_t, european, this](int i) {
+                        auto payoff = calc_payoff(this->underlying_tree(last_t,i));
+                        *(output+(i-first)) = std::make_pair(payoff,false);
+                        if (european) {
+                            european->set(last_t, i, payoff);
+                        }
                     }); //calc_payoff
                 }
 
-                std::vector<int> indices(premium_tree.size());
                 std::vector<T> boundary(premium_tree.size());
-                std::iota(indices.begin(),indices.end(), 0);
+                exercise_frontier_tracker tracker{type};
+                if(early_exercise_possible) {
+                    pricing<T> at_maturity{pp.S, static_cast<T>(pp.K), pp.sigma, 0.0, pp.r, pp.q};
+                    boundary[last_t] = exercise_boundary_at_maturity<T>(at_maturity, type);
+                }
+                auto dt = pp.tau / (steps - shift);
                 for(int t = last_t-1; t>=0; t--) {
-                    auto start = indices.begin();
-                    auto end = start+t+1;
-
-                    auto [output, _] = premium_tree(t);
-                    auto premium_next_step = get<0>(premium_tree(t+1));
-
-                    std::transform(std::execution::par_unseq, start, end, output,
-                              [premium_next_step, p, discount_factor, early_exercise_possible, &calc_payoff, t, this](int i) {
-                                  std::pair<T,bool> premium_up = *(premium_next_step+i);
-                                  //auto premium_up = *(premium_next_step+i);
-                                  std::pair<T,bool> premium_down = *(premium_next_step+i+1);
-                                  auto continuation = (p*premium_up.first + (1.0-p)*premium_down.first)*discount_factor;
+                    auto first = premium_tree.first(t);
+                    auto [start, end] = premium_tree(t);
+
+                    parallel_for(first, premium_tree.last(t)+1,
+                              [p, discount_factor, early_exercise_possible, &calc_payoff, t, dt, first, output = start, european, this](int i) {
+                                  T continuation;
+                                  bool smoothed = european and t == this->steps - 1;
+                                  if(not smoothed and this->premium_tree.contains(t+1,i) and this->premium_tree.contains(t+1,i+1)) {
+                                      std::pair<T,bool> premium_up = this->premium_tree(t+1,i);
+                                      std::pair<T,bool> premium_down = this->premium_tree(t+1,i+1);
+                                      continuation = (p*premium_up.first + (1.0-p)*premium_down.first)*discount_factor;
+                                      if (european) {
+                                          european->set(t, i, (p*(*european)(t+1,i) + (1.0-p)*(*european)(t+1,i+1))*discount_factor);
+                                      }
+                                  } else {
+                                      //Truncated lattice: beyond the band the continuation value is the analytic european price.
+                                      //The control variate also smooths the last step with it: the errors of both lattices
+                                      //then move together instead of oscillating with the position of the strike.
+                                      continuation = this->european_value(this->underlying_tree(t,i), (this->steps - t)*dt);
+                                      if (european) {
+                                          european->set(t, i, continuation);
+                                      }
+                                  }
+                                  auto node = std::make_pair(continuation,false);
                                   if(early_exercise_possible) {
                                       T payoff = calc_payoff(this->underlying_tree(t,i));
                                       if(payoff > continuation) {
-                                          return std::make_pair(payoff, true);
-                                      } else {
-                                          return std::make_pair(continuation,false);
+                                          node = std::make_pair(payoff, true);
                                       }
-                                  } else {
-                                      return std::make_pair(continuation,false);
                                   }
-                                  //return early_exercise_possible? std::make_pair(std::max(continuation, calc_payoff(this->underlying_tree(t,i))),true) : std::make_pair(continuation,false);
+                                  *(output+(i-first)) = node;
                               });
 
                     if(early_exercise_possible) {
-                        //calc exercise boundary
-                        auto[start, end] = premium_tree(t);
-
-                        int b = -1;
-                        if (type == instrument_type::put) {
-                            for (auto it = start; it != end; it++) {
-                                if (it->second) {
-                                    b = it - start;
-                                    break;
-                                }
-                            }
-                            if(b>0) {
-                                //This approximation is based on paper "Discrete and continuous time approximations of the optiomal exercise boundary of American options - Basso, Nardon, Pianca"
-                                auto den = premium_tree(t, b - 1).first - premium_tree(t, b).first + underlying_tree(t, b - 1) - underlying_tree(t, b);
-                                auto w1 = (premium_tree(t, b - 1).first - calc_payoff(underlying_tree(t, b - 1))) / den;
-                                auto w2 = (-premium_tree(t, b).first + calc_payoff(underlying_tree(t, b))) / den;
-                                boundary[t] = w1 * underlying_tree(t, b) + w2 * underlying_tree(t, b - 1);
-                            } else if (b==0) {
-                                boundary[t] = underlying_tree(t,b);
-                            } else {
-                                //dont know, we could repeat from the next step or use nan
-                                boundary[t] = boundary[t+1]*discount_factor;
-                            }
-
-                        } else if (type == instrument_type::call) {
-                            for (auto it = start; it != end; it++) {
-                                if (it->second) {
-                                    b = it - start;
-                                }
-                            }
-                            if(b>0 and b<t) {
-                                //Not sure this is correct, the paper didnt have a formula for it.
-                                auto den = premium_tree(t, b + 1).first - premium_tree(t, b).first + underlying_tree(t, b + 1) - underlying_tree(t, b);
-                                auto w1 = (premium_tree(t, b + 1).first - calc_payoff(underlying_tree(t, b + 1))) / den;
-                                auto w2 = (-premium_tree(t, b).first + calc_payoff(underlying_tree(t, b))) / den;
-                                boundary[t] = w1 * underlying_tree(t, b) + w2 * underlying_tree(t, b + 1);
-                            } else if (b==0) {
-                                boundary[t] = underlying_tree(t,b);
-                            } else {
-                                //dont know, we could repeat from the next step or use nan
-                                boundary[t] = boundary[t+1]*discount_factor;
-                            }
+                        //calc exercise boundary, walking from the frontier of the next step
+                        auto last = premium_tree.last(t);
+                        int b = tracker.track(first, last, 0, [t, this](int i) { return this->premium_tree(t, i).second; });
+                        int c = type == instrument_type::put ? b - 1 : b + 1;
+                        if (b >= 0 and c >= first and c <= last) {
+                            boundary[t] = interpolate_frontier<T>(underlying_tree(t, b), premium_tree(t, b).first, calc_payoff(underlying_tree(t, b)),
+                                                                  underlying_tree(t, c), premium_tree(t, c).first, calc_payoff(underlying_tree(t, c)));
+                        } else if (b >= 0) {
+                            boundary[t] = underlying_tree(t, b);
+                        } else {
+                            //dont know, we could repeat from the next step or use nan
+                            boundary[t] = boundary[t+1]*discount_factor;
                         }
                     }
                 }
@@ -205,6 +246,24 @@ namespace bsm {
                 return boundary;
             }
 
+            /**
+             * Analytic value used at the edges of a truncated lattice. For the american style the exercise check that
+             * follows floors it at the intrinsic value.
+             */
+            T european_value(T const& S, T const& tau) const {
+                pricing<T> p{S, static_cast<T>(pp.K), pp.sigma, tau, pp.r, pp.q};
+                switch (type) {
+                    case instrument_type::call:
+                        return calculate_european_call<T>(p);
+                    case instrument_type::put:
+                        return calculate_european_put<T>(p);
+                    case instrument_type::forward:
+                        return calculate_european_forward<T>(p);
+                    default:
+                        return 0.0;
+                }
+            }
+
             auto underlying() const {
                 return underlying_tree;
             }
@@ -215,6 +274,100 @@ namespace bsm {
 
         };
 
+        /**
+         * CRR lattice of one expiry, shared by every strike of the expiry. The node (t, i), after t steps of which i
+         * down, of a lattice rooted at the spot S is worth S u^(t - 2i): the 2 steps + 1 powers of u are the whole
+         * lattice for any root, so it also holds the symmetric puts of the american calls, rooted at their strikes.
+         * Each side of the lattice has the probability of an up move and the discount factor of a step for the
+         * rates (r, q), side 0, or swapped (q, r), side 1, and the market over the last step for the control variate.
+         * As the tree of a contract with extra steps, the lattice may start extra (even) steps of the same length
+         * before the valuation date, the price being read at the node of the spot after them.
+         */
+        struct crr_expiry_lattice {
+            struct side {
+                double p;
+                double discount_factor;
+                //Market of the last step, its forward per unit of spot
+                expiry_market last_step;
+            };
+
+            //steps of the lattice, the extra ones included
+            int steps;
+            int extra;
+            //powers[steps + k] = u^k
+            std::vector<double> powers;
+            side sides[2];
+
+            crr_expiry_lattice(double sigma, double r, double q, expiry_market const& market, int steps, int extra = 0):
+                    steps{steps + extra}, extra{extra}, powers(2 * (steps + extra) + 1) {
+                auto dt = market.tau / steps;
+                //sigma sqrt(dt) from the sigma sqrt(tau) of the expiry
+                auto x = market.v / std::sqrt(static_cast<double>(steps));
+                for (int k = -this->steps; k <= this->steps; k++) {
+                    powers[this->steps + k] = std::exp(k * x);
+                }
+                auto u = powers[this->steps + 1], d = powers[this->steps - 1];
+                auto df_r = std::exp(-r * dt), df_q = std::exp(-q * dt);
+                sides[0] = {(df_q / df_r - d) / (u - d), df_r, {dt, df_r, df_q, df_q / df_r, x}};
+                sides[1] = {(df_r / df_q - d) / (u - d), df_q, {dt, df_q, df_r, df_r / df_q, x}};
+            }
+
+            /**
+             * Backward induction of a contract of strike K on the lattice rooted at S, with the rates of a side. With
+             * control_variate (american contracts) the european induction runs in the same pass, both are smoothed
+             * on the last step by the Black-Scholes value, and european holds the european lattice price.
+             * values (and european_values) are scratch arrays of steps + 1 elements.
+             */
+            double price(int side, double S, double K, instrument_type type, bool american, bool control_variate,
+                         double* values, double* european_values, double& european) const {
+                auto const& rates = sides[side];
+                auto payoff = [type, K](double spot) {
+                    switch (type) {
+                        case instrument_type::call:
+                            return std::max(spot - K, 0.0);
+                        case instrument_type::put:
+                            return std::max(K - spot, 0.0);
+                        default:
+                            return spot - K;
+                    }
+                };
+                auto at = [this, S](int t, int i) {
+                    return S * powers[steps + t - 2 * i];
+                };
+                bool smoothed = american and control_variate;
+                int last = steps;
+                if (smoothed) {
+                    //Black-Scholes over the last step, the forward of the market scaled by the spot of the node
+                    last = steps - 1;
+                    for (int i = 0; i <= last; i++) {
+                        auto m = rates.last_step;
+                        m.forward *= at(last, i);
+                        auto value = type == instrument_type::call ? calculate_european_call(m, K) : calculate_european_put(m, K);
+                        european_values[i] = value;
+                        values[i] = std::max(value, payoff(at(last, i)));
+                    }
+                } else {
+                    for (int i = 0; i <= last; i++) {
+                        values[i] = payoff(at(last, i));
+                    }
+                }
+                auto up = rates.p * rates.discount_factor, down = (1.0 - rates.p) * rates.discount_factor;
+                for (int t = last - 1; t >= extra; t--) {
+                    for (int i = 0; i <= t; i++) {
+                        auto continuation = up * values[i] + down * values[i + 1];
+                        values[i] = american ? std::max(continuation, payoff(at(t, i))) : continuation;
+                    }
+                    if (smoothed) {
+                        for (int i = 0; i <= t; i++) {
+                            european_values[i] = up * european_values[i] + down * european_values[i + 1];
+                        }
+                    }
+                }
+                european = smoothed ? european_values[extra / 2] : NAN;
+                return values[extra / 2];
+            }
+        };
+
         template<typename T>
         std::ostream& operator<<(std::ostream& out, generic_crr_pricing_method<T> const& crrtree) {
             out << crrtree.underlying();
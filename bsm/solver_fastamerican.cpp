@@ -1,31 +1,95 @@
 #include "solver.h"
+#include "solver_fastamerican_internals.h"
 
-#include <vector>
+#include <memory>
 #include <algorithm>
 
+using namespace bsm::internals;
+
 namespace bsm {
 
-    struct fastamerican_method: pricing<double> {
+    /**
+     * American put priced by the spectral collocation engine. Calls are priced as their symmetric puts (see
+     * symmetric_call_method).
+     */
+    struct fastamerican_method: pricing<double>, american_method {
         const int l;
         const int m;
         const int n;
-        const double tau_max;
+        //The engine is immutable and shared between the copies of the method
+        std::shared_ptr<const alo_put_engine> engine;
+        lazy_boundary_curve curve_;
+
+        fastamerican_method(american_put const& instrument, mkt_params<double> mp, int l, int m, int n):
+                pricing{instrument,mp}, l{l}, m{m}, n{n},
+                engine{make_engine(sigma, r, q)} {}
+
+        double price() override {
+            return engine->price(S);
+        }
+
+        double delta() override {
+            return engine->delta(S);
+        }
 
-        fastamerican_method(american const& instrument, mkt_params<double> mp, int l, int m, int n):
-        pricing{instrument,mp},
-        l{l}, m{m}, n{n}, tau_max{tau}
-        {
+        double gamma() override {
+            return engine->gamma(S);
+        }
 
+        double vega() override {
+            return (make_engine(sigma + bump, r, q)->price(S) - make_engine(sigma - bump, r, q)->price(S)) / (2.0 * bump);
         }
 
-        std::vector<double> get_chebyshev_nodes(int _n) {
-            std::vector<double> z(_n+1);
-            std::generate(z.begin(), z.end(), [i = 0,_n] () mutable { return -cos(i++*std::numbers::pi/_n); });
-            return z;
+        //Calendar theta from the Black-Scholes PDE, which holds in the continuation region
+        double theta() override {
+            if (tau <= 0 or exercised()) {
+                return 0.0;
+            }
+            return r * price() - (r - q) * S * delta() - 0.5 * sigma * sigma * S * S * gamma();
         }
 
+        double rho() override {
+            return (make_engine(sigma, r + bump, q)->price(S) - make_engine(sigma, r - bump, q)->price(S)) / (2.0 * bump);
+        }
+
+        double psi() override {
+            return (make_engine(sigma, r, q + bump)->price(S) - make_engine(sigma, r, q - bump)->price(S)) / (2.0 * bump);
+        }
 
+        std::shared_ptr<const boundary_curve> exercise_boundary_curve() override {
+            return curve_.get([this] {
+                return std::make_shared<const boundary_curve>([this](double _tau) { return static_cast<double>(exercise_boundary(_tau)); }, tau, instrument_type::put, std::max(n, 16));
+            });
+        }
+
+        long double exercise_boundary(long double _tau) override {
+            return engine->boundary(std::clamp<double>(_tau, 0.0, tau));
+        }
+
+    private:
+        static constexpr double bump = 1e-4;
+
+        std::shared_ptr<const alo_put_engine> make_engine(double _sigma, double _r, double _q) const {
+            return std::make_shared<const alo_put_engine>(K, _sigma, _r, _q, tau, l, m, n);
+        }
+
+        bool exercised() const {
+            return S <= engine->boundary(tau);
+        }
     };
 
+    template<>
+    std::unique_ptr<american_method> fastamerican_solver<autodiff_off>::operator()(american_put& instrument) {
+        fastamerican_method gp{instrument, mktParams, l, m, n};
+        return std::make_unique<fastamerican_method>(gp);
+    }
+
+    template<>
+    std::unique_ptr<american_method> fastamerican_solver<autodiff_off>::operator()(american_call& instrument) {
+        return solve_by_symmetry(instrument, mktParams, [this](american_put& put, mkt_params<double> const& mp) {
+            fastamerican_method gp{put, mp, l, m, n};
+            return std::make_unique<fastamerican_method>(gp);
+        });
+    }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,347 @@
+#ifndef BSM_SOLVER_FASTAMERICAN_INTERNALS_H
+#define BSM_SOLVER_FASTAMERICAN_INTERNALS_H
+
+#include "solver.h"
+#include "solver_analytical_internals.h"
+#include "solver_american_internals.h"
+#include "solver_qdplus_internals.h"
+#include "solver_quadrature_internals.h"
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <numbers>
+#include <cmath>
+
+namespace bsm {
+    namespace internals {
+
+        /**
+         * Everything of the collocation that depends only on (l, n): the Gauss-Legendre rule, the Chebyshev nodes and
+         * the Lagrange basis of those nodes at the quadrature points of the boundary equation. The quadrature points
+         * are fixed fractions of the time to maturity, so the tables are shared by all the engines of the same (l, n)
+         * through a process-wide cache, and pricing does no table setup once they exist.
+         */
+        struct alo_collocation_tables {
+            const int l, n;
+            std::vector<double> y, w;
+            //Chebyshev nodes z_i and the fraction of the time to maturity they stand for, ((1+z_i)/2)^2
+            std::vector<double> z, fraction;
+            //Lagrange basis at the quadrature point k of node i, p = (i-1)*l+k, node major: H(u_p) = sum_j basis[j*P+p] H_j
+            std::vector<double> basis;
+
+            alo_collocation_tables(int l, int n): l{l}, n{n}, z{chebyshev_nodes(n)}, fraction(n + 1), basis((n + 1) * n * l) {
+                gauss_legendre(l, y, w);
+                for (int i = 0; i <= n; i++) {
+                    auto x = 0.5 * (1.0 + z[i]);
+                    fraction[i] = x * x;
+                }
+                int P = n * l;
+                for (int i = 1; i <= n; i++) {
+                    for (int k = 0; k < l; k++) {
+                        auto x = 0.5 * (1.0 + y[k]);
+                        //u/tau of the quadrature point
+                        auto u = fraction[i] * (1.0 - x) * (1.0 - x) * (1.0 + 2.0 * x);
+                        lagrange_basis(std::min(1.0, 2.0 * sqrt(u) - 1.0), &basis[(i - 1) * l + k], P);
+                    }
+                }
+            }
+
+            static std::shared_ptr<const alo_collocation_tables> get(int l, int n) {
+                static std::mutex mutex;
+                static std::map<std::pair<int,int>, std::shared_ptr<const alo_collocation_tables>> cache;
+                std::lock_guard lock{mutex};
+                auto& tables = cache[{l, n}];
+                if (not tables) {
+                    tables = std::make_shared<const alo_collocation_tables>(l, n);
+                }
+                return tables;
+            }
+
+        private:
+            /**
+             * Lagrange basis of the n+1 Chebyshev nodes at x, by the barycentric formula (the weights of the extrema
+             * nodes are (-1)^j, halved at both ends)
+             */
+            void lagrange_basis(double x, double* out, int stride) const {
+                for (int j = 0; j <= n; j++) {
+                    if (x == z[j]) {
+                        for (int i = 0; i <= n; i++) {
+                            out[i * stride] = i == j ? 1.0 : 0.0;
+                        }
+                        return;
+                    }
+                }
+                double sum = 0;
+                for (int j = 0; j <= n; j++) {
+                    double weight = (j % 2 == 0 ? 1.0 : -1.0) * ((j == 0 or j == n) ? 0.5 : 1.0);
+                    out[j * stride] = weight / (x - z[j]);
+                    sum += out[j * stride];
+                }
+                for (int j = 0; j <= n; j++) {
+                    out[j * stride] /= sum;
+                }
+            }
+        };
+
+        /**
+         * Spectral collocation pricer of the American put of Andersen, Lake and Offengenden, "High-performance American
+         * option pricing" (2016). The exercise boundary is represented by the Chebyshev interpolation of
+         * H(sqrt(tau)) = ln(B(tau)/X)^2 on n+1 nodes, where X = K min(1, r/q) is the boundary right before the
+         * maturity. This transformation removes the square root behaviour of the boundary near the maturity.
+         *
+         * At the nodes the boundary solves B = K exp(-(r-q) tau) N(tau,B)/D(tau,B), which is iterated m times as a
+         * fixed point of the FP-A form of the paper, starting from the QD+ boundary. The integrals over the boundary
+         * use the l points Gauss-Legendre quadrature after the change of variable tau-u = tau x^2 (3-2x), x = (1+y)/2,
+         * which removes the 1/sqrt(tau-u) singularity and the square root behaviour of B(u) next to the maturity.
+         *
+         * The price is the european price plus the early exercise premium integral, again with l quadrature points.
+         * American calls are priced through the put-call symmetry, see fastamerican_method.
+         */
+        struct alo_put_engine {
+            const double K, sigma, r, q, tau;
+            const int l, m, n;
+            //boundary right before the maturity
+            const double X;
+            //false when the put is never exercised early (or has expired), it is then priced as an european put
+            const bool early_exercise;
+
+            alo_put_engine(double K, double sigma, double r, double q, double tau, int l, int m, int n):
+                    K{K}, sigma{sigma}, r{r}, q{q}, tau{tau}, l{l}, m{m}, n{n},
+                    X{q > r ? K * r / q : K},
+                    early_exercise{tau > 0 and not never_optimal_exercise<double>(pricing<double>{K, K, sigma, tau, r, q}, false)} {
+                if (early_exercise) {
+                    tables = alo_collocation_tables::get(l, n);
+                    solve();
+                }
+            }
+
+            //Exercise boundary at time to maturity t in [0, tau]
+            double boundary(double t) const {
+                if (not early_exercise) {
+                    return tau > 0 ? 0.0 : X;
+                }
+                if (t <= 0) {
+                    return X;
+                }
+                return exp(log_boundary(std::min(1.0, 2.0 * sqrt(t / tau) - 1.0)));
+            }
+
+            //Boundary at the collocation nodes, from the shortest time to maturity to tau
+            std::vector<double> const& nodes() const {
+                return B;
+            }
+
+            double price(double S) const {
+                if (tau <= 0) {
+                    return std::max(K - S, 0.0);
+                }
+                if (S <= boundary(tau)) {
+                    return K - S;
+                }
+                pricing<double> p{S, K, sigma, tau, r, q};
+                return calculate_european_put<double>(p) + premium(S, 0);
+            }
+
+            double delta(double S) const {
+                if (tau <= 0) {
+                    return S < K ? -1.0 : 0.0;
+                }
+                if (S <= boundary(tau)) {
+                    return -1.0;
+                }
+                auto d1 = calculate_d1<double>(pricing<double>{S, K, sigma, tau, r, q});
+                return -exp(-q * tau) * cdf<double>(-d1) + premium(S, 1);
+            }
+
+            double gamma(double S) const {
+                if (tau <= 0 or S <= boundary(tau)) {
+                    return 0.0;
+                }
+                return calculate_gamma<double>(pricing<double>{S, K, sigma, tau, r, q}) + premium(S, 2);
+            }
+
+        private:
+            std::shared_ptr<const alo_collocation_tables> tables;
+            const double log_X = log(X);
+            //boundary at the collocation nodes and its interpolation
+            std::vector<double> t, B;
+            chebyshev_interpolation H;
+
+            //Quadrature of the boundary equation at node i, point k (row major), independent of the boundary
+            struct boundary_point {
+                double s;       //tau_i - u
+                double v;       //sigma sqrt(s)
+                double eru;     //w_k e^{ru} sqrt(tau_i)/sigma
+                double equ;     //w_k e^{qu} sqrt(tau_i)/sigma
+                double eqj;     //w_k e^{qu} times the jacobian of the change of variable
+                double growth;  //e^{(r-q)s}
+            };
+            std::vector<boundary_point> points;
+            //H at the quadrature points
+            std::vector<double> H_points;
+
+            //Quadrature of the early exercise premium, point k
+            struct premium_point {
+                double z;       //Chebyshev abscissa of u
+                double s;       //tau - u
+                double v;       //sigma sqrt(s)
+                double dfr;     //e^{-rs}
+                double dfq;     //e^{-qs}
+                double weight;  //w_k times the jacobian of the change of variable
+                double logB;    //ln B(u), set once the boundary is solved
+            };
+            std::vector<premium_point> premium_points;
+
+            double log_boundary(double z) const {
+                return log_X - sqrt(std::max(H(z), 0.0));
+            }
+
+            void fit() {
+                std::vector<double> values(n + 1);
+                for (int i = 0; i <= n; i++) {
+                    auto x = log(B[i] / X);
+                    values[i] = x * x;
+                }
+                H.fit(values);
+                //The quadrature points don't move between iterations, so H is interpolated there with the precomputed
+                //basis instead of one Clenshaw recurrence per point
+                int P = n * l;
+                std::fill(H_points.begin(), H_points.end(), 0.0);
+                for (int j = 1; j <= n; j++) {
+                    auto const* row = &tables->basis[j * P];
+                    auto value = values[j];
+                    for (int p = 0; p < P; p++) {
+                        H_points[p] += row[p] * value;
+                    }
+                }
+            }
+
+            void solve() {
+                auto const& y = tables->y;
+                auto const& w = tables->w;
+                t.resize(n + 1);
+                B.resize(n + 1);
+                for (int i = 0; i <= n; i++) {
+                    t[i] = tau * tables->fraction[i];
+                }
+
+                int P = n * l;
+                points.resize(P);
+                H_points.resize(P);
+                for (int i = 1; i <= n; i++) {
+                    auto sqrt_t = sqrt(t[i]);
+                    for (int k = 0; k < l; k++) {
+                        auto x = 0.5 * (1.0 + y[k]);
+                        auto s = t[i] * x * x * (3.0 - 2.0 * x);
+                        auto u = t[i] * (1.0 - x) * (1.0 - x) * (1.0 + 2.0 * x);
+                        auto jacobian = 3.0 * t[i] * x * (1.0 - x);
+                        points[(i - 1) * l + k] = {
+                            s,
+                            sigma * sqrt_t * x * sqrt(3.0 - 2.0 * x),
+                            w[k] * exp(r * u) * jacobian / (sigma * sqrt(s)),
+                            w[k] * exp(q * u) * jacobian / (sigma * sqrt(s)),
+                            w[k] * exp(q * u) * jacobian,
+                            exp((r - q) * s)
+                        };
+                    }
+                }
+
+                //QD+ starting boundary, each node warm started from the previous one
+                qdplus_boundary_solver qdplus{K, sigma, r, q};
+                double guess = NAN;
+                B[0] = X;
+                for (int i = 1; i <= n; i++) {
+                    guess = qdplus(t[i], guess).Sb;
+                    B[i] = std::min(guess, X);
+                }
+                fit();
+
+                auto drift = r - q + 0.5 * sigma * sigma;
+                std::vector<double> next(n + 1);
+                next[0] = X;
+                for (int j = 0; j < m; j++) {
+                    double change = 0;
+                    for (int i = 1; i <= n; i++) {
+                        auto log_Bi = log(B[i]);
+                        auto log_ratio_X = log_Bi - log_X;
+                        //K1 = int e^{ru} phi(d-)/(sigma sqrt(tau-u)), K2 = int e^{qu} N(d+), K3 = int e^{qu} phi(d+)/(sigma sqrt(tau-u))
+                        double K1 = 0, K2 = 0, K3 = 0;
+                        for (int k = 0; k < l; k++) {
+                            int p = (i - 1) * l + k;
+                            auto const& pt = points[p];
+                            //ln B(u) = ln X - sqrt(H)
+                            auto log_ratio = log_ratio_X + sqrt(std::max(H_points[p], 0.0));
+                            auto dp = (log_ratio + drift * pt.s) / pt.v;
+                            auto phi_p = pdf<double>(dp);
+                            //phi(d-) = phi(d+) B(tau)/B(u) e^{(r-q)(tau-u)}
+                            auto phi_m = phi_p * exp(log_ratio) * pt.growth;
+                            K1 += pt.eru * phi_m;
+                            K2 += pt.eqj * cdf<double>(dp);
+                            K3 += pt.equ * phi_p;
+                        }
+                        auto v = sigma * sqrt(t[i]);
+                        auto dp = (log_Bi - log(K) + drift * t[i]) / v;
+                        auto dm = dp - v;
+                        //FP-A
+                        auto N = pdf<double>(dm) / v + r * K1;
+                        auto D = pdf<double>(dp) / v + cdf<double>(dp) + q * (K2 + K3);
+                        next[i] = K * exp(-(r - q) * t[i]) * N / D;
+                        //the boundary of the put stays below X
+                        next[i] = std::clamp(next[i], 1e-6 * X, X);
+                        change = std::max(change, std::abs(next[i] - B[i]) / B[i]);
+                    }
+                    std::swap(B, next);
+                    fit();
+                    if (change < 1e-13) {
+                        break;
+                    }
+                }
+
+                premium_points.resize(l);
+                for (int k = 0; k < l; k++) {
+                    auto x = 0.5 * (1.0 + y[k]);
+                    auto u = tau * x * x * (3.0 - 2.0 * x);
+                    auto s = tau * (1.0 - x) * (1.0 - x) * (1.0 + 2.0 * x);
+                    auto jacobian = 3.0 * tau * x * (1.0 - x);
+                    auto z = std::min(1.0, 2.0 * sqrt(u / tau) - 1.0);
+                    premium_points[k] = {z, s, sigma * sqrt(s), exp(-r * s), exp(-q * s), w[k] * jacobian, log_boundary(z)};
+                }
+            }
+
+            /**
+             * Early exercise premium of the put (order 0) and its first two derivatives wrt the spot, with the same change
+             * of variable as the boundary equation (u and tau-u swap roles).
+             */
+            double premium(double S, int order) const {
+                if (not early_exercise) {
+                    return 0.0;
+                }
+                auto log_S = log(S);
+                auto drift = r - q + 0.5 * sigma * sigma;
+                double sum = 0;
+                for (auto const& pt: premium_points) {
+                    auto dp = (log_S - pt.logB + drift * pt.s) / pt.v;
+                    auto dm = dp - pt.v;
+                    auto v = pt.v;
+                    double f;
+                    if (order == 0) {
+                        f = r * K * pt.dfr * cdf<double>(-dm) - q * S * pt.dfq * cdf<double>(-dp);
+                    } else if (order == 1) {
+                        f = -r * K * pt.dfr * pdf<double>(dm) / (S * v) - q * pt.dfq * cdf<double>(-dp) + q * pt.dfq * pdf<double>(dp) / v;
+                    } else {
+                        f = r * K * pt.dfr * pdf<double>(dm) / (S * S * v) * (dm / v + 1.0) + q * pt.dfq * pdf<double>(dp) / (S * v)
+                            - q * pt.dfq * pdf<double>(dp) * dp / (S * v * v);
+                    }
+                    sum += pt.weight * f;
+                }
+                return sum;
+            }
+        };
+
+    }
+}
+
+#endif //BSM_SOLVER_FASTAMERICAN_INTERNALS_H
@@ -5,13 +5,18 @@
 #include "instruments.h"
 #include "solver.h"
 #include "solver_analytical_internals.h"
+#include "solver_american_internals.h"
+#include "executor.h"
 
 #include <vector>
 #include <iostream>
 #include <algorithm>
-#include <execution>
 #include <utility>
-#include <ranges>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <cassert>
 
 #include <taskflow/taskflow.hpp>
 
@@ -27,227 +32,281 @@ namespace bsm {
         template<typename T>
         struct superpositioned_binomial_lattice_method: american_method {
             const int steps;
+            const bool control_variate;
             std::shared_ptr<american> instrument;
             std::function<pricing_function<T>> blackScholes;
 
-            superpositioned_binomial_lattice_method(american_put const& instrument,int steps):
-                steps{steps}, instrument{std::make_shared<american_put>(instrument)} {
+            superpositioned_binomial_lattice_method(american_put const& instrument,int steps, bool control_variate = false):
+                steps{steps}, control_variate{control_variate}, instrument{std::make_shared<american_put>(instrument)} {
                 blackScholes = [](pricing<T> const& p) { return calculate_european_put<T>(p); };
             }
-            superpositioned_binomial_lattice_method(american_call const& instrument,int steps):
-                    steps{steps}, instrument{std::make_shared<american_call>(instrument)} {
+            superpositioned_binomial_lattice_method(american_call const& instrument,int steps, bool control_variate = false):
+                    steps{steps}, control_variate{control_variate}, instrument{std::make_shared<american_call>(instrument)} {
                 blackScholes = [](pricing<T> const& p) { return calculate_european_call<T>(p); };
             }
             superpositioned_binomial_lattice_method(superpositioned_binomial_lattice_method const&) = default;
             superpositioned_binomial_lattice_method(superpositioned_binomial_lattice_method &&) noexcept = default;
 
+            struct result {
+                T price;
+                T delta;
+                T gamma;
+                T theta;
+                std::vector<T> boundary;
+            };
+
+            /**
+             * The lattice as a Taskflow graph built once and re-run for every set of inputs (the solve itself and the
+             * bumped solves of vega, rho and psi). Instead of three tasks per time step, a condition task loops over
+             * the time steps:
+             *
+             *   start -> layer -> next --(0)--> layer
+             *                          --(1)--> (done)
+             *
+             * where layer is a parallel for over the height of the lattice and next records the exercise boundary,
+             * swaps the rolling layers and moves one step back in time.
+             * With control_variate the layer also rolls back the european lattice, and the values read at the end
+             * are American - European + Black-Scholes.
+             */
+            struct graph {
+                const int steps;
+                const bool control_variate;
+                std::shared_ptr<american> instrument;
+                std::function<pricing_function<T>> blackScholes;
+                int limit;
+                int height;
+
+                //inputs of the current run
+                std::optional<pricing<T>> p;
+                T dt, u, prob, df;
+
+                //state of the current run
+                std::vector<T> underlying;
+                std::vector<node<T>> layer1;
+                std::vector<node<T>> layer2;
+                std::vector<node<T>>* in;
+                std::vector<node<T>>* out;
+                std::vector<T> european1;
+                std::vector<T> european2;
+                std::vector<T>* european_in;
+                std::vector<T>* european_out;
+                int t;
+                exercise_frontier_tracker tracker;
+                T theta_premium;
+                T theta_european;
+                result output;
 
-            void solve(pricing<T> const& p) {
-
-                tf::Executor executor;
                 tf::Taskflow taskflow;
-
-                //This controls the height of the lattice
-//                auto max_S = p.S * exp(p.sigma * sqrt(p.tau) * 4);
-//                auto min_S = p.S * exp(p.sigma * sqrt(p.tau) * -8);
-//                std::cout << "Max S = " << max_S << ", Min S = " << min_S << std::endl;
-
-                //int limit_up = 6*sqrt(steps);
-                int limit = 8*sqrt(steps);
-                int height = 2 * limit + 1;
-                if(instrument->type==instrument_type::put)
-                    limit /= 2;
-                else if(instrument->type==instrument_type::call)
-                    limit *= 1.5;
-
-                auto map_index = [limit] (int i) {
-                    return limit-i;
-                };
-
-                auto dt = p.tau / steps;
-                auto dsigma = p.sigma * sqrt(dt);
-                auto u = exp(dsigma);
-                auto d = exp(-dsigma);
-                auto prob = (exp((p.r - p.q) * dt) - d) / (u - d);
-                auto df = exp(-p.r * dt); //discount factor
-
-                std::vector<T> underlying(height);
-                std::vector<node<T>> layer1(height);
-                std::vector<node<T>> layer2(height);
-                std::vector<T> boundary(steps);
-
-                std::vector<tf::Task> tasks;
-
-                //This is the last layer1 (before the maturity) hence
-                auto initialization_task = taskflow.for_each_index(0, height, 1, [&](int i) {
-                    auto k = map_index(i);
-                    T S = p.S*pow(u,k); //exp(dsigma*k);
-                    underlying[i] = S;
-                    auto p2 = p.clone(S,dt);
-                    T payoff = this->instrument->payoff(S);
-                    T continuation = this->blackScholes(*p2);
-                    if(payoff > continuation) {
-                        layer1[i] = std::make_pair(payoff, true);
-                    } else {
-                        layer1[i] = std::make_pair(continuation, false);
+                std::mutex mutex;
+
+                graph(int steps, std::shared_ptr<american> instrument, std::function<pricing_function<T>> blackScholes, bool control_variate = false):
+                        steps{steps}, control_variate{control_variate}, instrument{std::move(instrument)}, blackScholes{std::move(blackScholes)},
+                        tracker{this->instrument->type} {
+                    assert(("The lattice needs at least 3 steps", steps >= 3));
+                    //This controls the height of the lattice
+                    limit = 8*sqrt(steps);
+                    height = 2 * limit + 1;
+                    if(this->instrument->type==instrument_type::put)
+                        limit /= 2;
+                    else if(this->instrument->type==instrument_type::call)
+                        limit *= 1.5;
+
+                    underlying.resize(height);
+                    layer1.resize(height);
+                    layer2.resize(height);
+                    if (control_variate) {
+                        european1.resize(height);
+                        european2.resize(height);
                     }
-                });
 
-                tasks.push_back(initialization_task);
-
-                auto *out = &layer2;
-                auto *in = &layer1;
-
-                int tval = steps-2;
-                int *tptr = &tval;
-
-                for (int t = steps-2; t>=0; --t) {
+                    auto start = taskflow.emplace([this]() {
+                        in = &layer1;
+                        out = &layer2;
+                        european_in = &european1;
+                        european_out = &european2;
+                        t = this->steps - 1;
+                        tracker.hint = -1;
+                        output.boundary.assign(this->steps + 1, 0.0);
+                        output.boundary[this->steps] = exercise_boundary_at_maturity<T>(*p, this->instrument->type);
+                    });
 
-                    tf::Task processing_task = taskflow.for_each_index(0, height, 1, [&](int i) {
-                        auto k = map_index(i);
-                        T S = underlying[i];//p.S*pow(u,k); //this saves about 2%
+                    auto layer = taskflow.for_each_index(0, std::ref(height), 1, [this](int i) {
+                        if (t == this->steps - 1) {
+                            //This is the last layer before the maturity
+                            underlying[i] = p->S * pow(u, limit - i);
+                        }
+                        T S = underlying[i];
                         T payoff = this->instrument->payoff(S);
                         T continuation;
-
-                        if(i==0 or i==(height-1)) {
-                            auto p2 = p.clone(S,dt);
+                        if (t == this->steps - 1 or i == 0 or i == height - 1) {
+                            auto p2 = p->clone(S, dt);
                             continuation = this->blackScholes(*p2);
+                            if (this->control_variate) {
+                                (*european_out)[i] = continuation;
+                            }
                         } else {
                             T premium_up = (*in)[i-1].first;
                             T premium_down = (*in)[i+1].first;
                             continuation = (prob*premium_up + (1.0-prob)*premium_down) * df;
+                            if (this->control_variate) {
+                                (*european_out)[i] = (prob*(*european_in)[i-1] + (1.0-prob)*(*european_in)[i+1]) * df;
+                            }
                         }
 
-                        if(payoff > continuation) {
+                        if (payoff > continuation) {
                             (*out)[i] = std::make_pair(payoff, true);
                         } else {
-                            (*out)[i] = std::make_pair(continuation,false);
+                            (*out)[i] = std::make_pair(continuation, false);
                         }
-
-                    });
-
-                    tasks.back().precede(processing_task);
-                    tasks.push_back(processing_task);
-
-                    tf::Task swap_task = taskflow.emplace([&](){
-                        std::swap(in,out);
                     });
 
-                    tasks.back().precede(swap_task);
-                    tasks.push_back(swap_task);
-
-                    tf::Task boundary_task = taskflow.emplace([&]() {
-                        int b = -1;
-                        int t = *tptr;
-                        if(instrument->type==instrument_type::put) {
-                            auto B = std::max_element(std::execution::par_unseq, out->begin(), out->end(),
-                                [](node<T> const &a, node<T> const &b) {
-                                  if (a.second == false and b.second == true) {
-                                      return true;
-                                  } else if (a.second == false and b.second == false) {
-                                      return a.first > b.first;
-                                  } else if (a.second == true and b.second == false) {
-                                      return false;
-                                  } else if (a.second == true and b.second == true) {
-                                      return a.first > b.first;
-                                  }
-                                });
-                            b = B - out->begin();
-                            //b = 10;
-                            if(b>0) {
-                                auto& premium = *in;
-                                //This approximation is based on paper "Discrete and continuous time approximations of the optiomal exercise boundary of American options - Basso, Nardon, Pianca"
-                                auto den = premium[b-1].first - premium[b].first + underlying[b-1] - underlying[b];
-                                auto w1 = (premium[b-1].first - this->instrument->payoff(underlying[b-1])) / den;
-                                auto w2 = (-premium[b].first + this->instrument->payoff(underlying[b])) / den;
-                                boundary[t] = w1 * underlying[b] + w2 * underlying[b-1];
-                            } else if (b==0) {
-                                boundary[t] = underlying[b];
-                            } else {
-                                //don't know, we could repeat from the next step
-                                boundary[t] = boundary[t+1]*df;
-                            }
-                        } else if(instrument->type==instrument_type::call) {
-                            auto B = std::max_element(std::execution::par_unseq, out->begin(), out->end(),
-                                [](node<T> const &a, node<T> const &b) {
-                                  if (a.second == false and b.second == true) {
-                                      return true;
-                                  } else if (a.second == false and b.second == false) {
-                                      return a.first < b.first;
-                                  } else if (a.second == true and b.second == false) {
-                                      return false;
-                                  } else if (a.second == true and b.second == true) {
-                                      return a.first < b.first;
-                                  }
-                                });
-                            b = B - out->begin();
-                            if(b>0 and b<t) {
-                                //Not sure this is correct, the paper didnt have a formula for it.
-                                auto den = (*in)[b+1].first - (*in)[b].first + underlying[b+1] - underlying[b];
-                                auto w1 = ((*in)[b+1].first - this->instrument->payoff(underlying[b+1])) / den;
-                                auto w2 = (-(*in)[b].first + this->instrument->payoff(underlying[b])) / den;
-                                boundary[t] = w1 * underlying[b] + w2 * underlying[b+1];
-                            } else if (b==0) {
-                                boundary[t] = underlying[b];
-                            } else {
-                                //don't know, we could repeat from the next step or use nan
-                                boundary[t] = boundary[t+1]*df;
+                    auto next = taskflow.emplace([this]() {
+                        output.boundary[t] = frontier(*out, output.boundary[t + 1]);
+                        if (t == 1) {
+                            theta_premium = (*out)[limit].first;
+                            if (this->control_variate) {
+                                theta_european = (*european_out)[limit];
                             }
                         }
-                        (*tptr) -= 1;
+                        std::swap(in, out);
+                        std::swap(european_in, european_out);
+                        return --t >= 0 ? 0 : 1;
                     });
 
-                    tasks.back().precede(boundary_task);
-                    tasks.push_back(boundary_task);
-
+                    start.precede(layer);
+                    layer.precede(next);
+                    next.precede(layer);
                 }
 
-                executor.run(taskflow).wait();
+                result run(pricing<T> const& inputs) {
+                    std::lock_guard lock{mutex};
+                    p.emplace(inputs);
+                    dt = p->tau / steps;
+                    auto dsigma = p->sigma * sqrt(dt);
+                    u = exp(dsigma);
+                    auto d = exp(-dsigma);
+                    prob = (exp((p->r - p->q) * dt) - d) / (u - d);
+                    df = exp(-p->r * dt); //discount factor
+
+                    run_and_wait(taskflow);
+
+                    //At t=0 the lattice holds every level, so the greeks come from the levels around the spot
+                    auto V_u = value(limit-1);
+                    auto V = value(limit);
+                    auto V_d = value(limit+1);
+                    auto S_u = underlying[limit-1];
+                    auto S = underlying[limit];
+                    auto S_d = underlying[limit+1];
+                    auto V_theta = theta_premium;
+                    if (control_variate) {
+                        V_theta += this->blackScholes(*p->clone(S, p->tau - dt)) - theta_european;
+                    }
+                    output.price = V;
+                    output.delta = (V_u - V_d)/(S_u - S_d);
+                    output.gamma = ((V_u - V)/(S_u - S) - (V - V_d)/(S - S_d))/((S_u - S_d)/2.0);
+                    output.theta = (V_theta - V)/dt;
+                    return output;
+                }
 
-                std::cout << std::boolalpha;
-                std::cout << "Result:" << std::endl;
-                for(int i=0; i<height; i++) {
-                    std::cout << "index = " << map_index(i) << ", S = " << underlying[i] << ", P = " << (*in)[i].first << ", E = " << (*in)[i].second << std::endl;
+                //Value at level i of the first layer, corrected by the error of the european lattice
+                T value(int i) {
+                    auto V = (*in)[i].first;
+                    if (control_variate) {
+                        V += this->blackScholes(*p->clone(underlying[i], p->tau)) - (*european_in)[i];
+                    }
+                    return V;
                 }
-                std::cout << "Boundary:" << std::endl;
-                for(int i=0; i<steps; i++) {
-                    std::cout << "Sb["<< i <<"] = " << boundary[i] << std::endl;
+
+                /**
+                 * Exercise boundary of a layer, interpolated between the frontier node and its neighbour in the
+                 * continuation region. The rows of the lattice are fixed spots, so the frontier of the next step is
+                 * the starting point of the walk as is.
+                 */
+                T frontier(std::vector<node<T>> const& premium, T fallback) {
+                    int b = tracker.track(0, height - 1, 0, [&premium](int i) { return premium[i].second; });
+                    int c = instrument->type == instrument_type::put ? b - 1 : b + 1;
+                    if (b >= 0 and c >= 0 and c < height) {
+                        return interpolate_frontier<T>(underlying[b], premium[b].first, instrument->payoff(underlying[b]),
+                                                       underlying[c], premium[c].first, instrument->payoff(underlying[c]));
+                    }
+                    if (b >= 0) {
+                        return underlying[b];
+                    }
+                    //don't know, we repeat from the next step
+                    return fallback;
                 }
+            };
 
-                //TODO Complete this
+            std::optional<pricing<T>> p;
+            result solution;
+            std::optional<lattice_boundary_curve<T>> curve;
+            lazy_boundary_curve curve_;
+            std::shared_ptr<graph> lattice;
 
+            void solve(pricing<T> const& p) {
+                if (not lattice) {
+                    lattice = std::make_shared<graph>(steps, instrument, blackScholes, control_variate);
+                }
+                this->p.emplace(p);
+                solution = lattice->run(p);
+                curve.emplace(p.tau, solution.boundary);
             }
 
             double price() override {
-                return 0;
+                return solution.price;
             }
 
             double delta() override {
-                return 0;
+                return solution.delta;
             }
 
             double gamma() override {
-                return 0;
+                return solution.gamma;
             }
 
             double vega() override {
-                return 0;
+                pricing<T> bumped_up{*p};
+                bumped_up.sigma *= exp(0.01);
+                return (lattice->run(bumped_up).price - solution.price) / (bumped_up.sigma - p->sigma);
             }
 
             double theta() override {
-                return 0;
+                return solution.theta;
             }
 
             double rho() override {
-                return 0;
+                pricing<T> bumped_up{*p};
+                if(bumped_up.r!=0)
+                    bumped_up.r *= exp(0.01);
+                else
+                    bumped_up.r += 0.01;
+                return (lattice->run(bumped_up).price - solution.price) / (bumped_up.r - p->r);
             }
 
             double psi() override {
-                return 0;
+                pricing<T> bumped_up{*p};
+                if(bumped_up.q!=0)
+                    bumped_up.q *= exp(0.01);
+                else
+                    bumped_up.q += 0.01;
+                return (lattice->run(bumped_up).price - solution.price) / (bumped_up.q - p->q);
+            }
+
+            std::shared_ptr<const boundary_curve> exercise_boundary_curve() override {
+                return curve_.get([this] {
+                    return std::make_shared<const boundary_curve>([this](double _tau) { return static_cast<double>(exercise_boundary(_tau)); }, static_cast<double>(p->tau), instrument->type);
+                });
             }
 
             long double exercise_boundary(long double _tau) override {
-                return 0;
+                bool call = instrument->type==instrument_type::call;
+                if(never_optimal_exercise<T>(*p,instrument->type)) {
+                    return call? INFINITY : 0.0;
+                }
+                if(p->tau==0) {
+                    return exercise_boundary_at_maturity<T>(*p,instrument->type);
+                }
+                return (*curve)(_tau);
             }
 
         };
@@ -0,0 +1,125 @@
+#include "solver.h"
+#include "solver_lsm_internals.h"
+#include "solver_american_internals.h"
+
+#include <memory>
+#include <optional>
+#include <cmath>
+#include <algorithm>
+
+using namespace bsm::internals;
+
+namespace bsm {
+
+    struct lsm_pricing_method: pricing<double>, american_mc_method {
+        const instrument_type type;
+        const int paths, steps, degree;
+        const std::uint64_t seed;
+        lsm_estimate estimate;
+        std::optional<lattice_boundary_curve<double>> boundary;
+        lazy_boundary_curve curve_;
+
+        lsm_pricing_method(american const& instrument, mkt_params<double> mp, int paths, int steps, int degree, std::uint64_t seed):
+                pricing{instrument, mp}, type{instrument.type}, paths{paths}, steps{steps}, degree{degree}, seed{seed} {
+            estimate = simulate(*this);
+            if (tau > 0) {
+                boundary.emplace(tau, estimate.boundary);
+            }
+        }
+
+        double price() override {
+            return estimate.price;
+        }
+
+        double standard_error() override {
+            return estimate.standard_error;
+        }
+
+        double delta() override {
+            return estimate.delta;
+        }
+
+        double gamma() override {
+            //Central difference of the pathwise deltas, on the same paths
+            auto h = 0.01 * S;
+            pricing<double> up{*this}, down{*this};
+            up.S += h;
+            down.S -= h;
+            return (simulate(up).delta - simulate(down).delta) / (2 * h);
+        }
+
+        double vega() override {
+            pricing<double> bumped_up{*this};
+            bumped_up.sigma *= exp(0.01);
+            return (simulate(bumped_up).price - price()) / (bumped_up.sigma - sigma);
+        }
+
+        double theta() override {
+            //Calendar time forward, one day or what is left of the option
+            pricing<double> bumped{*this};
+            auto dt = std::min(tau, 1.0 / 365);
+            bumped.tau -= dt;
+            return (simulate(bumped).price - price()) / dt;
+        }
+
+        double rho() override {
+            pricing<double> bumped_up{*this};
+            if (bumped_up.r != 0)
+                bumped_up.r *= exp(0.01);
+            else
+                bumped_up.r += 0.01;
+            return (simulate(bumped_up).price - price()) / (bumped_up.r - r);
+        }
+
+        double psi() override {
+            pricing<double> bumped_up{*this};
+            if (bumped_up.q != 0)
+                bumped_up.q *= exp(0.01);
+            else
+                bumped_up.q += 0.01;
+            return (simulate(bumped_up).price - price()) / (bumped_up.q - q);
+        }
+
+        std::shared_ptr<const boundary_curve> exercise_boundary_curve() override {
+            return curve_.get([this] {
+                return std::make_shared<const boundary_curve>([this](double _tau) { return static_cast<double>(exercise_boundary(_tau)); }, tau, type);
+            });
+        }
+
+        long double exercise_boundary(long double _tau) override {
+            bool call = type == instrument_type::call;
+            if (never_optimal_exercise<double>(*this, type)) {
+                return call ? INFINITY : 0.0;
+            }
+            if (tau == 0) {
+                return exercise_boundary_at_maturity<double>(*this, type);
+            }
+            if (boundary) {
+                return boundary.value()(_tau);
+            }
+            return NAN;
+        }
+
+    private:
+        //The bumped solves draw the same normals, so the difference of two estimates is mostly the one of the prices
+        lsm_estimate simulate(pricing<double> const& p) const {
+            if (p.tau <= 0) {
+                auto value = vanilla_payoff(type, p.K, p.S);
+                auto delta = value > 0 ? (type == instrument_type::call ? 1.0 : -1.0) : 0.0;
+                return {value, 0.0, delta, {}};
+            }
+            return lsm_engine{p, type, paths, steps, degree, seed}();
+        }
+    };
+
+    template<>
+    std::unique_ptr<american_mc_method> lsm_solver<autodiff_off>::operator()(american_put& instrument) {
+        return std::make_unique<lsm_pricing_method>(instrument, mktParams, paths, steps, degree, seed);
+    }
+
+    template<>
+    std::unique_ptr<american_mc_method> lsm_solver<autodiff_off>::operator()(american_call& instrument) {
+        return std::make_unique<lsm_pricing_method>(instrument, mktParams, paths, steps, degree, seed);
+    }
+
+}
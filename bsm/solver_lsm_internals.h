@@ -0,0 +1,250 @@
+#ifndef BSM_SOLVER_LSM_INTERNALS_H
+#define BSM_SOLVER_LSM_INTERNALS_H
+
+#include "common.h"
+#include "instruments.h"
+#include "solver.h"
+#include "solver_american_internals.h"
+#include "solver_mc_internals.h"
+#include "executor.h"
+#include "../random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <taskflow/taskflow.hpp>
+
+namespace bsm {
+    namespace internals {
+
+        struct lsm_estimate {
+            double price;
+            double standard_error;
+            //Pathwise delta on the exercise policy of the estimate
+            double delta;
+            //Exercise boundary k dates after the valuation date, see lattice_boundary_curve
+            std::vector<double> boundary;
+        };
+
+        /**
+         * Longstaff-Schwartz engine. The prices of the paths are stored date by date (time major), so the backward
+         * sweep reads each date as one contiguous row. At each date the block of paths b fills its rows of the
+         * preallocated regression matrix X_b (the basis at the paths in the money) and y_b (their discounted cash
+         * flows), reduced into the normal equations X'X beta = X'y which Eigen solves by LDLT. The basis are the
+         * powers of S/K - 1, centred on the strike where the regressions matter.
+         */
+        struct lsm_engine {
+            static constexpr int block_size = mc_engine::block_size;
+            static constexpr int chunk_size = mc_engine::chunk_size;
+
+            pricing<double> p;
+            instrument_type type;
+            int paths;
+            int steps;
+            int degree;
+            std::uint64_t seed;
+
+            double payoff(double S) const {
+                return type == instrument_type::call ? std::max(S - p.K, 0.0) : std::max(p.K - S, 0.0);
+            }
+
+            //Regressed continuation value at S, by Horner on the powers of S/K - 1
+            double continuation(Eigen::VectorXd const& beta, double S) const {
+                auto x = S / p.K - 1.0;
+                double c = beta[degree];
+                for (int j = degree - 1; j >= 0; j--) {
+                    c = c * x + beta[j];
+                }
+                return c;
+            }
+
+            lsm_estimate operator()() const {
+                int blocks = (paths + block_size - 1) / block_size;
+                int basis = degree + 1;
+                auto dt = p.tau / steps;
+                auto df = std::exp(-p.r * dt);
+                bool call = type == instrument_type::call;
+
+                //S[(t - 1) paths + i] is the price of the path i at the date t = 1, ..., steps
+                std::vector<double> S(static_cast<std::size_t>(steps) * paths);
+                //Cash flow of each path and its derivative in the spot, discounted to the current date
+                std::vector<double> value(paths), derivative(paths);
+
+                tf::Taskflow simulation;
+                simulation.for_each_index(0, blocks, 1, [this, &S](int b) {
+                    simulate(b, S.data());
+                });
+                run_and_wait(simulation);
+
+                auto last = S.data() + static_cast<std::size_t>(steps - 1) * paths;
+                for (int i = 0; i < paths; i++) {
+                    value[i] = payoff(last[i]);
+                    derivative[i] = value[i] > 0 ? (call ? 1.0 : -1.0) * last[i] / p.S : 0.0;
+                }
+
+                std::vector<Eigen::MatrixXd> X(blocks, Eigen::MatrixXd(block_size, basis));
+                std::vector<Eigen::VectorXd> y(blocks, Eigen::VectorXd(block_size));
+                std::vector<Eigen::MatrixXd> XX(blocks, Eigen::MatrixXd(basis, basis));
+                std::vector<Eigen::VectorXd> Xy(blocks, Eigen::VectorXd(basis));
+                std::vector<int> in_the_money(blocks);
+                std::vector<double> lowest(blocks), highest(blocks);
+                Eigen::MatrixXd A(basis, basis);
+                Eigen::VectorXd c(basis), beta(basis);
+                Eigen::LDLT<Eigen::MatrixXd> ldlt(basis);
+
+                std::vector<double> boundary(steps + 1, NAN);
+                boundary[steps] = exercise_boundary_at_maturity<double>(p, type);
+
+                //The same two taskflows, regression and exercise, run at every date
+                int t = steps;
+                double const* row = nullptr;
+                tf::Taskflow regression, exercise;
+                regression.for_each_index(0, blocks, 1, [&](int b) {
+                    int first = b * block_size, count = std::min(block_size, paths - first);
+                    int n = 0;
+                    double lo = INFINITY, hi = 0;
+                    for (int i = first; i < first + count; i++) {
+                        value[i] *= df;
+                        derivative[i] *= df;
+                        if (payoff(row[i]) > 0) {
+                            auto x = row[i] / p.K - 1.0;
+                            double power = 1.0;
+                            for (int j = 0; j < basis; j++) {
+                                X[b](n, j) = power;
+                                power *= x;
+                            }
+                            y[b][n++] = value[i];
+                            lo = std::min(lo, row[i]);
+                            hi = std::max(hi, row[i]);
+                        }
+                    }
+                    in_the_money[b] = n;
+                    lowest[b] = lo;
+                    highest[b] = hi;
+                    XX[b].noalias() = X[b].topRows(n).transpose() * X[b].topRows(n);
+                    Xy[b].noalias() = X[b].topRows(n).transpose() * y[b].head(n);
+                });
+                exercise.for_each_index(0, blocks, 1, [&](int b) {
+                    int first = b * block_size, count = std::min(block_size, paths - first);
+                    for (int i = first; i < first + count; i++) {
+                        auto exercised = payoff(row[i]);
+                        if (exercised > 0 and exercised >= continuation(beta, row[i])) {
+                            value[i] = exercised;
+                            derivative[i] = (call ? 1.0 : -1.0) * row[i] / p.S;
+                        }
+                    }
+                });
+
+                for (t = steps - 1; t >= 1; t--) {
+                    row = S.data() + static_cast<std::size_t>(t - 1) * paths;
+                    run_and_wait(regression);
+                    int n = 0;
+                    A.setZero();
+                    c.setZero();
+                    for (int b = 0; b < blocks; b++) {
+                        n += in_the_money[b];
+                        A += XX[b];
+                        c += Xy[b];
+                    }
+                    if (n <= basis) {
+                        //Too few paths in the money to regress, none is exercised at this date
+                        continue;
+                    }
+                    ldlt.compute(A);
+                    beta = ldlt.solve(c);
+                    run_and_wait(exercise);
+                    boundary[t] = root(beta, *std::min_element(lowest.begin(), lowest.end()), *std::max_element(highest.begin(), highest.end()));
+                }
+
+                //Dates whose boundary is out of the simulated spots take the one of the nearest date with a root
+                for (int k = steps - 1; k >= 0; k--) {
+                    if (std::isnan(boundary[k])) {
+                        boundary[k] = boundary[k + 1];
+                    }
+                }
+
+                double sum = 0, squares = 0, delta = 0;
+                for (int i = 0; i < paths; i++) {
+                    auto v = df * value[i];
+                    sum += v;
+                    squares += v * v;
+                    delta += df * derivative[i];
+                }
+                auto mean = sum / paths;
+                auto variance = std::max((squares - paths * mean * mean) / (paths - 1), 0.0);
+                if (payoff(p.S) > mean) {
+                    //Exercised at once
+                    return {payoff(p.S), 0.0, call ? 1.0 : -1.0, std::move(boundary)};
+                }
+                return {mean, std::sqrt(variance / paths), delta / paths, std::move(boundary)};
+            }
+
+            /**
+             * Spot where payoff = continuation: the first one from the strike towards the farthest simulated spot in the
+             * money (lo for a put, hi for a call) where the payoff is at least the continuation value, bracketed on a
+             * grid and refined by bisection. NAN when there is none in that range. Both sides are tangent at the
+             * boundary (smooth pasting), so an error e of the regression moves the root by about sqrt(2e/gamma): the
+             * boundary is a diagnostic good to a few percent, much less accurate than the price.
+             */
+            double root(Eigen::VectorXd const& beta, double lo, double hi) const {
+                static constexpr int grid = 64;
+                bool call = type == instrument_type::call;
+                auto g = [this, &beta](double S) {
+                    return payoff(S) - continuation(beta, S);
+                };
+                double deep = call ? hi : lo;
+                if (call ? deep <= p.K : deep >= p.K) {
+                    return NAN;
+                }
+                double at = p.K;
+                if (g(at) >= 0) {
+                    return at;
+                }
+                for (int i = 1; i <= grid; i++) {
+                    auto S = p.K + (deep - p.K) * i / grid;
+                    if (g(S) >= 0) {
+                        deep = S;
+                        break;
+                    }
+                    if (i == grid) {
+                        return NAN;
+                    }
+                    at = S;
+                }
+                for (int i = 0; i < 60 and std::abs(deep - at) > 1e-10 * p.K; i++) {
+                    auto mid = 0.5 * (deep + at);
+                    (g(mid) >= 0 ? deep : at) = mid;
+                }
+                return 0.5 * (deep + at);
+            }
+
+            //Block b of paths, from the stream b of the seed, in chunks of vectorized time steps
+            void simulate(int b, double* S) const {
+                random_normal<double> normal{seed, static_cast<std::uint64_t>(b)};
+                auto dt = p.tau / steps;
+                auto drift = (p.r - p.q - 0.5 * p.sigma * p.sigma) * dt;
+                auto vol = p.sigma * std::sqrt(dt);
+                int block_first = b * block_size, count = std::min(block_size, paths - block_first);
+
+                double z[chunk_size], x[chunk_size];
+                for (int first = 0; first < count; first += chunk_size) {
+                    int n = std::min(chunk_size, count - first);
+                    std::fill(x, x + n, 0.0);
+                    for (int t = 0; t < steps; t++) {
+                        normal.fill(z, n);
+                        auto row = S + static_cast<std::size_t>(t) * paths + block_first + first;
+                        for (int k = 0; k < n; k++) {
+                            x[k] += drift + vol * z[k];
+                            row[k] = p.S * std::exp(x[k]);
+                        }
+                    }
+                }
+            }
+        };
+
+    }
+}
+
+#endif //BSM_SOLVER_LSM_INTERNALS_H
@@ -0,0 +1,129 @@
+#include "solver.h"
+#include "solver_mc_internals.h"
+
+#include <memory>
+#include <optional>
+#include <cmath>
+#include <algorithm>
+
+using namespace bsm::internals;
+
+namespace bsm {
+
+    struct mc_pricing_method: pricing<double>, mc_method {
+        const instrument_type type;
+        const mc_settings settings;
+        //Copied, the greeks revalue it after the call to the solver
+        std::optional<path_payoff> payoff;
+        mc_estimate estimate;
+
+        mc_pricing_method(instrument const& instrument, mkt_params<double> mp, mc_settings settings, path_payoff const* payoff = nullptr):
+                pricing{instrument, mp}, type{instrument.type}, settings{settings} {
+            if (payoff) {
+                this->payoff.emplace(*payoff);
+            }
+            estimate = simulate(*this);
+        }
+
+        double price() override {
+            return estimate.value[mc_price];
+        }
+
+        double standard_error() override {
+            return estimate.standard_error[mc_price];
+        }
+
+        double delta() override {
+            return estimate.value[mc_delta];
+        }
+
+        double delta_error() override {
+            return estimate.standard_error[mc_delta];
+        }
+
+        double gamma() override {
+            return estimate.value[mc_gamma];
+        }
+
+        double gamma_error() override {
+            return estimate.standard_error[mc_gamma];
+        }
+
+        double vega() override {
+            return estimate.value[mc_vega];
+        }
+
+        double vega_error() override {
+            return estimate.standard_error[mc_vega];
+        }
+
+        double theta() override {
+            //Calendar time forward, one day or what is left of the option
+            pricing<double> bumped{*this};
+            auto dt = std::min(tau, 1.0 / 365);
+            bumped.tau -= dt;
+            return (revalue(bumped) - price()) / dt;
+        }
+
+        double rho() override {
+            pricing<double> bumped_up{*this};
+            if (bumped_up.r != 0)
+                bumped_up.r *= exp(0.01);
+            else
+                bumped_up.r += 0.01;
+            return (revalue(bumped_up) - price()) / (bumped_up.r - r);
+        }
+
+        double psi() override {
+            pricing<double> bumped_up{*this};
+            if (bumped_up.q != 0)
+                bumped_up.q *= exp(0.01);
+            else
+                bumped_up.q += 0.01;
+            return (revalue(bumped_up) - price()) / (bumped_up.q - q);
+        }
+
+    private:
+        //The bumped solves draw the same normals, so the difference of two estimates is mostly the one of the prices
+        mc_estimate simulate(pricing<double> const& p) const {
+            if (p.tau <= 0) {
+                mc_estimate expired;
+                expired.value[mc_price] = vanilla_payoff(type, p.K, p.S);
+                expired.value[mc_delta] = vanilla_slope(type, p.K, p.S);
+                return expired;
+            }
+            return mc_engine{p, type, settings, payoff ? &*payoff : nullptr}();
+        }
+
+        double revalue(pricing<double> const& p) const {
+            return simulate(p).value[mc_price];
+        }
+
+    };
+
+    template<>
+    std::unique_ptr<mc_method> mc_solver<autodiff_off>::operator()(european_forward& instrument) {
+        return std::make_unique<mc_pricing_method>(instrument, mktParams, mc_settings{paths, steps, antithetic, control_variate, seed});
+    }
+
+    template<>
+    std::unique_ptr<mc_method> mc_solver<autodiff_off>::operator()(european_call& instrument) {
+        return std::make_unique<mc_pricing_method>(instrument, mktParams, mc_settings{paths, steps, antithetic, control_variate, seed});
+    }
+
+    template<>
+    std::unique_ptr<mc_method> mc_solver<autodiff_off>::operator()(european_put& instrument) {
+        return std::make_unique<mc_pricing_method>(instrument, mktParams, mc_settings{paths, steps, antithetic, control_variate, seed});
+    }
+
+    template<>
+    std::unique_ptr<mc_method> mc_solver<autodiff_off>::operator()(european_call& instrument, path_payoff const& payoff) {
+        return std::make_unique<mc_pricing_method>(instrument, mktParams, mc_settings{paths, steps, antithetic, control_variate, seed}, &payoff);
+    }
+
+    template<>
+    std::unique_ptr<mc_method> mc_solver<autodiff_off>::operator()(european_put& instrument, path_payoff const& payoff) {
+        return std::make_unique<mc_pricing_method>(instrument, mktParams, mc_settings{paths, steps, antithetic, control_variate, seed}, &payoff);
+    }
+
+}
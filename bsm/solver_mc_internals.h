@@ -0,0 +1,280 @@
+#ifndef BSM_SOLVER_MC_INTERNALS_H
+#define BSM_SOLVER_MC_INTERNALS_H
+
+#include "common.h"
+#include "instruments.h"
+#include "solver.h"
+#include "solver_analytical_internals.h"
+#include "executor.h"
+#include "../random.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include <taskflow/taskflow.hpp>
+
+namespace bsm {
+    namespace internals {
+
+        struct mc_settings {
+            int paths;
+            int steps;
+            bool antithetic;
+            bool control_variate;
+            std::uint64_t seed;
+        };
+
+        //Estimates of a sweep: the price and the greeks read off the same paths
+        enum mc_quantity {
+            mc_price, mc_delta, mc_gamma, mc_vega
+        };
+        constexpr int mc_quantities = 4;
+
+        struct mc_estimate {
+            std::array<double, mc_quantities> value{};
+            std::array<double, mc_quantities> standard_error{};
+        };
+
+        /**
+         * Sums of the samples Y (of the instrument) and X (of its vanilla payoff, the control) of each quantity in a
+         * block. With antithetic paths a sample is the mean of a pair.
+         */
+        struct mc_moments {
+            double n = 0;
+            std::array<double, mc_quantities> y{}, yy{}, x{}, xx{}, xy{};
+
+            void add(double const* Y, double const* X) {
+                n += 1;
+                for (int i = 0; i < mc_quantities; i++) {
+                    y[i] += Y[i];
+                    yy[i] += Y[i] * Y[i];
+                    x[i] += X[i];
+                    xx[i] += X[i] * X[i];
+                    xy[i] += X[i] * Y[i];
+                }
+            }
+
+            mc_moments& operator+=(mc_moments const& other) {
+                n += other.n;
+                for (int i = 0; i < mc_quantities; i++) {
+                    y[i] += other.y[i];
+                    yy[i] += other.yy[i];
+                    x[i] += other.x[i];
+                    xx[i] += other.xx[i];
+                    xy[i] += other.xy[i];
+                }
+                return *this;
+            }
+        };
+
+        inline double vanilla_payoff(instrument_type type, double K, double S) {
+            switch (type) {
+                case instrument_type::call:
+                    return std::max(S - K, 0.0);
+                case instrument_type::put:
+                    return std::max(K - S, 0.0);
+                case instrument_type::forward:
+                    return S - K;
+                default:
+                    return 0.0;
+            }
+        }
+
+        //Derivative of the vanilla payoff in S
+        inline double vanilla_slope(instrument_type type, double K, double S) {
+            switch (type) {
+                case instrument_type::call:
+                    return S > K ? 1.0 : 0.0;
+                case instrument_type::put:
+                    return S < K ? -1.0 : 0.0;
+                case instrument_type::forward:
+                    return 1.0;
+                default:
+                    return 0.0;
+            }
+        }
+
+        //Closed form price, delta, gamma and vega of the vanilla, the expectations of the controls
+        inline std::array<double, mc_quantities> vanilla_values(instrument_type type, pricing<double> const& p) {
+            switch (type) {
+                case instrument_type::call:
+                    return {calculate_european_call<double>(p), exp(-p.q * p.tau) * cdf<double>(calculate_d1<double>(p)),
+                            calculate_gamma<double>(p), calculate_vega<double>(p)};
+                case instrument_type::put:
+                    return {calculate_european_put<double>(p), -exp(-p.q * p.tau) * cdf<double>(-calculate_d1<double>(p)),
+                            calculate_gamma<double>(p), calculate_vega<double>(p)};
+                case instrument_type::forward:
+                    return {calculate_european_forward<double>(p), exp(-p.q * p.tau), 0.0, 0.0};
+                default:
+                    return {};
+            }
+        }
+
+        /**
+         * Monte Carlo engine. The paths are split in blocks of block_size, each one a task of the shared executor
+         * drawing from its own Philox stream. A block runs in chunks of chunk_size paths whose buffers (normals, log
+         * prices, paths and samples) are allocated once per block: a time step is a loop over the chunk that the
+         * compiler vectorizes, with no allocation per path.
+         *
+         * The greeks come from the same sweep as the price. Delta and vega are pathwise: with W the Brownian motion
+         * of the path, dS(t)/dS = S(t)/S and dS(t)/dsigma = S(t) (W(t) - sigma t), so a vanilla contributes its slope
+         * times these. A path payoff is differentiated along the path, by the difference of the payoff on the path
+         * moved by eps times these directions, which needs it continuous in the prices (an average or a maximum, not a
+         * barrier). Gamma, where the pathwise derivative of a kink vanishes, is the likelihood ratio of the first
+         * time step: with z its normal and dt its length, the payoff times ((z^2 - 1)/(S sigma)^2 dt - z/S^2 sigma
+         * sqrt(dt)). Each of them gets its standard error and, with the control variate, its control: the same
+         * estimator on the vanilla payoff, whose expectation is known in closed form.
+         */
+        struct mc_engine {
+            static constexpr int block_size = 4096;
+            static constexpr int chunk_size = 256;
+            static constexpr double eps = 1e-6;
+
+            pricing<double> p;
+            instrument_type type;
+            mc_settings settings;
+            path_payoff const* payoff;
+
+            mc_estimate operator()() const {
+                int blocks = (settings.paths + block_size - 1) / block_size;
+                std::vector<mc_moments> moments(blocks);
+                tf::Taskflow taskflow;
+                taskflow.for_each_index(0, blocks, 1, [this, &moments](int b) {
+                    moments[b] = block(b, std::min(block_size, settings.paths - b * block_size));
+                });
+                run_and_wait(taskflow);
+
+                mc_moments total;
+                for (auto const& m: moments) {
+                    total += m;
+                }
+                return estimate(total);
+            }
+
+            mc_estimate estimate(mc_moments const& m) const {
+                mc_estimate e;
+                auto n = m.n;
+                auto controls = settings.control_variate ? vanilla_values(type, p) : std::array<double, mc_quantities>{};
+                for (int i = 0; i < mc_quantities; i++) {
+                    auto mean_y = m.y[i] / n;
+                    auto var_y = std::max((m.yy[i] - n * mean_y * mean_y) / (n - 1), 0.0);
+                    if (not settings.control_variate) {
+                        e.value[i] = mean_y;
+                        e.standard_error[i] = std::sqrt(var_y / n);
+                        continue;
+                    }
+                    //Y - beta (X - E[X]) with the beta minimizing its variance
+                    auto mean_x = m.x[i] / n;
+                    auto var_x = (m.xx[i] - n * mean_x * mean_x) / (n - 1);
+                    auto cov_xy = (m.xy[i] - n * mean_x * mean_y) / (n - 1);
+                    auto beta = var_x > 0 ? cov_xy / var_x : 0.0;
+                    e.value[i] = mean_y - beta * (mean_x - controls[i]);
+                    e.standard_error[i] = std::sqrt(std::max(var_y - beta * cov_xy, 0.0) / n);
+                }
+                return e;
+            }
+
+            mc_moments block(int b, int count) const {
+                random_normal<double> normal{settings.seed, static_cast<std::uint64_t>(b)};
+                bool path = payoff != nullptr;
+                int steps = path ? settings.steps : 1;
+                auto dt = p.tau / steps;
+                auto drift = (p.r - p.q - 0.5 * p.sigma * p.sigma) * dt;
+                auto vol = p.sigma * std::sqrt(dt);
+                auto df = std::exp(-p.r * p.tau);
+                auto K = static_cast<double>(p.K);
+                //x(t) - (r - q + sigma^2/2) t = sigma (W(t) - sigma t)
+                auto vega_drift = (p.r - p.q + 0.5 * p.sigma * p.sigma) * dt;
+                auto gamma_scale = 1.0 / (p.S * p.S * p.sigma * p.sigma * dt);
+                auto gamma_shift = 1.0 / (p.S * p.S * vol);
+
+                std::vector<double> z(chunk_size), x(chunk_size), z1(chunk_size);
+                //Samples by quantity, Y[q * chunk_size + k] for the path k
+                std::vector<double> Y(mc_quantities * chunk_size), X(mc_quantities * chunk_size);
+                std::vector<double> S(path ? chunk_size * steps : 0), moved(path ? steps : 0);
+                mc_moments m;
+                for (int first = 0; first < count; first += chunk_size) {
+                    int n = std::min(chunk_size, count - first);
+                    //With antithetic paths the second half of the chunk mirrors the first one
+                    int drawn = settings.antithetic ? (n + 1) / 2 : n;
+                    std::fill(x.begin(), x.begin() + n, 0.0);
+                    for (int i = 0; i < steps; i++) {
+                        normal.fill(z.data(), drawn);
+                        for (int k = drawn; k < n; k++) {
+                            z[k] = -z[k - drawn];
+                        }
+                        if (i == 0) {
+                            std::copy(z.begin(), z.begin() + n, z1.begin());
+                        }
+                        for (int k = 0; k < n; k++) {
+                            x[k] += drift + vol * z[k];
+                        }
+                        if (path) {
+                            for (int k = 0; k < n; k++) {
+                                S[k * steps + i] = p.S * std::exp(x[k]);
+                            }
+                        }
+                    }
+                    for (int k = 0; k < n; k++) {
+                        auto S_T = p.S * std::exp(x[k]);
+                        auto score = (z1[k] * z1[k] - 1.0) * gamma_scale - z1[k] * gamma_shift;
+                        auto slope = df * vanilla_slope(type, K, S_T);
+                        auto vanilla = df * vanilla_payoff(type, K, S_T);
+                        X[mc_price * chunk_size + k] = vanilla;
+                        X[mc_delta * chunk_size + k] = slope * S_T / p.S;
+                        X[mc_gamma * chunk_size + k] = vanilla * score;
+                        X[mc_vega * chunk_size + k] = slope * S_T * (x[k] - vega_drift * steps) / p.sigma;
+                        if (not path) {
+                            for (int q = 0; q < mc_quantities; q++) {
+                                Y[q * chunk_size + k] = X[q * chunk_size + k];
+                            }
+                            continue;
+                        }
+                        auto prices = S.data() + k * steps;
+                        auto value = (*payoff)(prices, steps);
+                        for (int i = 0; i < steps; i++) {
+                            moved[i] = prices[i] * (1.0 + eps);
+                        }
+                        auto delta = ((*payoff)(moved.data(), steps) - value) / (eps * p.S);
+                        for (int i = 0; i < steps; i++) {
+                            moved[i] = prices[i] * (1.0 + eps * (std::log(prices[i] / p.S) - vega_drift * (i + 1)) / p.sigma);
+                        }
+                        auto vega = ((*payoff)(moved.data(), steps) - value) / eps;
+                        Y[mc_price * chunk_size + k] = df * value;
+                        Y[mc_delta * chunk_size + k] = df * delta;
+                        Y[mc_gamma * chunk_size + k] = df * value * score;
+                        Y[mc_vega * chunk_size + k] = df * vega;
+                    }
+                    if (settings.antithetic) {
+                        for (int k = 0; k < n - drawn; k++) {
+                            sample(Y.data(), X.data(), k, k + drawn, m);
+                        }
+                        if (n % 2 == 1) {
+                            sample(Y.data(), X.data(), drawn - 1, drawn - 1, m);
+                        }
+                    } else {
+                        for (int k = 0; k < n; k++) {
+                            sample(Y.data(), X.data(), k, k, m);
+                        }
+                    }
+                }
+                return m;
+            }
+
+            //Adds the mean of the paths k and l (the same path, or an antithetic pair) as a sample
+            static void sample(double const* Y, double const* X, int k, int l, mc_moments& m) {
+                double y[mc_quantities], x[mc_quantities];
+                for (int q = 0; q < mc_quantities; q++) {
+                    y[q] = 0.5 * (Y[q * chunk_size + k] + Y[q * chunk_size + l]);
+                    x[q] = 0.5 * (X[q * chunk_size + k] + X[q * chunk_size + l]);
+                }
+                m.add(y, x);
+            }
+        };
+
+    }
+}
+
+#endif //BSM_SOLVER_MC_INTERNALS_H
@@ -0,0 +1,500 @@
+#ifndef BSM_SOLVER_QDPLUS_INTERNALS_H
+#define BSM_SOLVER_QDPLUS_INTERNALS_H
+
+#include "solver.h"
+#include "solver_analytical_internals.h"
+#include "solver_american_internals.h"
+#include "executor.h"
+#include "vector_math.h"
+
+#include <autodiff/forward/dual.hpp>
+
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace bsm {
+    namespace internals {
+
+        template<typename T>
+        using exercise_boundary_function = T(T const&);
+
+        //Experimenting wiht long double duals
+        using ldual = autodiff::HigherOrderDual<3, long double>;
+
+        /**
+         * Paper: Analytical Approximations for the Critical Stock Prices of American Options: A Performance Comparison
+           by Minqiang Li, Li (2009). This QD+ model is considered to provide good approximation for the exercise boundary.
+         * @tparam T
+         */
+        template<typename T>
+        struct qdplus_method_core: pricing<T> {
+            T M, N;
+            bool call;
+            //Newton iterations of the last calculate_exercise_boundary
+            int iterations = 0;
+
+            qdplus_method_core(pricing<T> const& p, bool call = false):
+                    pricing<T>{p.S,p.K,p.sigma,p.tau,p.r,p.q},
+                    call{call},
+                    M{2.0L*this->r/(this->sigma*this->sigma)},
+                    N{2.0L*(this->r-this->q)/(this->sigma*this->sigma)}
+            {}
+
+            /**
+             * Calculates price based on exercise boundary
+             * @param Sb Exercise boundary
+             * @return
+             */
+            T calc_price(T const& Sb) {
+                auto& S = this->S;
+                auto& K = this->K;
+                auto& tau = this->tau;
+                auto& r = this->r;
+
+                if(call and S >= Sb) {
+                    return S - K;
+                } else if(not call and S <= Sb) {
+                    return K - S;
+                } else {
+                    auto european_option = call ? calculate_european_call<T>(*this) : calculate_european_put<T>(*this);
+                    if (never_optimal_exercise<T>(*this,call))
+                        return european_option;
+                    else {
+                        auto european_option_at_boundary = call ? calculate_european_call<T>(*(this->clone(autodiff::val(Sb), tau))) : calculate_european_put<T>(*(this->clone(autodiff::val(Sb), tau)));
+                        T h = 1.0L - exp(-r * tau);
+                        auto qd = calc_qqd(M, N, h); //q_QD
+                        auto qdd = calc_qqd_deriv(M, N, h); //q_QD'(h)
+                        auto b = calc_b(M, N, h, qd, qdd);
+                        auto logSSb = log(S / Sb);
+                        auto c0 = calc_c0(M, N, h, qd, qdd, Sb, tau, european_option_at_boundary);
+                        auto c = c0;
+                        return european_option +
+                               ((K - Sb - european_option_at_boundary) / (1.0 - b * (logSSb * logSSb) - c * logSSb)) * pow(S / Sb, qd);
+                    }
+                }
+            }
+
+            std::function<exercise_boundary_function<T>> get_exercise_boundary_function(T const& tau) {
+                auto& r = this->r;
+                auto h = 1.0L-exp(-r*tau);
+                auto qd = calc_qqd(M, N, h); //q_QD
+                auto qdd = calc_qqd_deriv(M, N, h); //q_QD'(h)
+                if(call)
+                    return [this,tau,h,qd,qdd](T const& Sb) {
+                        auto& q = this->q;
+                        auto& K = this->K;
+                        auto p = this->clone(Sb,tau);
+                        auto d1 = calculate_d1<T>(*p);
+                        auto ecall_b = calculate_european_call<T>(*p);
+                        auto c0 = calc_c0(M, N, h, qd, qdd, Sb, tau, ecall_b);
+                        auto c = c0;
+                        return abs((1.0-exp(-q*tau)*cdf<T>(d1))*Sb - (qd + c)*(Sb - K - ecall_b));
+                    };
+                else
+                    return [this,tau,h,qd,qdd](T const& Sb) {
+                        auto& q = this->q;
+                        auto& K = this->K;
+                        auto p = this->clone(Sb,tau);
+                        auto d1 = calculate_d1<T>(*p);
+                        auto eput_b = calculate_european_put<T>(*p);
+                        auto c0 = calc_c0(M, N, h, qd, qdd, Sb, tau, eput_b);
+                        auto c = c0;
+                        return abs((1.0-exp(-q*tau)*cdf<T>(-d1))*Sb + (qd + c)*(K - Sb - eput_b));
+                    };
+            }
+
+            T calculate_exercise_boundary(T const& tau) {
+                iterations = 0;
+                if(never_optimal_exercise<T>(*this,call)) {
+                    return call? INFINITY : 0.0;
+                }
+                if(tau==0) {
+                    return exercise_boundary_at_maturity<T>(*this,call ? instrument_type::call : instrument_type::put);
+                }
+
+                T Sb = this->K;
+                auto equation = get_exercise_boundary_function(tau);
+
+                for(int i = 0; i<100; i++) {
+                    auto [u0, ux, uxx, uxxx] = autodiff::derivatives(equation, autodiff::wrt(Sb), autodiff::at(Sb));
+                    if (u0 < 1e-9) {
+                        break;
+                    }
+                    Sb -= u0/ux;
+                    iterations++;
+                }
+                return Sb;
+            }
+
+            //qdd means q_QD'(h)
+            T calc_b(T const& M, T const& N, T const& h, T const& qd, T const& qdd) {
+                return 0.5*(1.0-h)*M*qdd/(2.0*qd+N-1.0);
+            }
+
+            T calc_qqd(T const& M, T const& N, T const& h) {
+                if(call) {
+                    return -0.5L*(N-1.0L-sqrt((N-1.0L)*(N-1.0L) + 4.0L*M/h));
+                } else {
+                    return -0.5L*(N-1.0L+sqrt((N-1.0L)*(N-1.0L) + 4.0L*M/h));
+                }
+            }
+
+            T calc_qqd_deriv(T const& M, T const& N, T const& h) {
+                return M/(h*h*sqrt((N-1.0L)*(N-1.0L)+ 4.0L*M/h));
+            }
+
+            T calc_c0(T const& M, T const& N, T const& h, T const& qd, T const& qdd, T const& Sb, T const& tau, T const& eput_b) {
+                auto& r = this->r;
+                auto& K = this->K;
+                return -((1.0-h)*M/(2.0*qd+N-1.0))*(1.0/h - put_theta(Sb,tau)*exp(r*tau)/(r*(K - Sb - eput_b)) + qdd / (2.0 * qd + N - 1.0) );
+            }
+
+            T put_theta(T const& S, T const& tau) {
+                auto p = this->clone(S,tau);
+                return calculate_theta<T>(*p,-1.0);
+            }
+
+        };
+
+        struct qdplus_boundary {
+            double Sb;
+            int iterations;
+        };
+
+        /**
+         * Coefficients of the QD+ put at one (strike, time to maturity), in double precision. The theta term of c0 is
+         * multiplied through by K - Sb - P(Sb), so the boundary equation reads
+         *
+         *   g(Sb) = (1 + Delta(Sb)) Sb + gamma0 (K - Sb - P(Sb)) + A Theta(Sb) = 0
+         *
+         * with gamma0 = q_QD - alpha (1/h + q_QD'/(2 q_QD + N - 1)) and A = 2/(sigma^2 (2 q_QD + N - 1)). g is smooth
+         * and its first two derivatives are closed form (those of theta come from the Black-Scholes PDE).
+         */
+        struct qdplus_put_coefficients {
+            double K, sigma2, r, q, tau;
+            double qd, qdd, den, alpha, gamma0, A;
+            double v, dfq, dfr, drift;
+
+            qdplus_put_coefficients() = default;
+
+            qdplus_put_coefficients(double K, double sigma, double r, double q, double tau):
+                    qdplus_put_coefficients{K, sigma, r, q, tau, exp(-r * tau), exp(-q * tau), sigma * sqrt(tau)} {}
+
+            //From the discount factors exp(-r tau), exp(-q tau) and sigma sqrt(tau) of the expiry
+            qdplus_put_coefficients(double K, double sigma, double r, double q, double tau, double dfr, double dfq, double v):
+                    K{K}, sigma2{sigma * sigma}, r{r}, q{q}, tau{tau}, v{v}, dfq{dfq}, dfr{dfr} {
+                auto M = 2.0 * r / sigma2;
+                auto N = 2.0 * (r - q) / sigma2;
+                auto h = 1.0 - dfr;
+                auto root = sqrt((N - 1.0) * (N - 1.0) + 4.0 * M / h);
+                qd = -0.5 * (N - 1.0 + root);
+                qdd = M / (h * h * root);
+                den = 2.0 * qd + N - 1.0;
+                alpha = (1.0 - h) * M / den;
+                gamma0 = qd - alpha * (1.0 / h + qdd / den);
+                A = 2.0 / (sigma2 * den);
+                drift = (r - q + 0.5 * sigma2) * tau;
+            }
+
+            struct european_terms {
+                double d1, n_d1, N_d1, N_d2;
+            };
+
+            //d1, the density n(d1) and the cdfs N(-d1), N(-d2) of the European put at spot S, with the exp, log and
+            //normal cdf and pdf of Math (library_math, or vector_math for the lanes of qdplus_batch_solver)
+            template<typename Math = library_math>
+            european_terms terms(double S) const {
+                auto d1 = (Math::log(S / K) + drift) / v;
+                //the densities at d1 and d2 are related by K dfr n(d2) = S dfq n(d1)
+                auto n_d1 = Math::pdf(d1);
+                return {d1, n_d1, Math::cdf(-d1, n_d1), Math::cdf(v - d1, S * dfq * n_d1 / (K * dfr))};
+            }
+
+            //Halley step of g at S
+            template<typename Math = library_math>
+            double halley_step(double S) const {
+                auto t = terms<Math>(S);
+                auto P = K * dfr * t.N_d2 - S * dfq * t.N_d1;
+                auto delta = -dfq * t.N_d1;
+                auto u = 1.0 / (S * v);
+                auto gamma = dfq * t.n_d1 * u;
+                //derivatives of gamma wrt S, from d log(gamma)/dS = L = -(1 + d1/v)/S
+                auto L = -(v + t.d1) * u;
+                auto dL = ((v + t.d1) * v - 1.0) * u * u;
+                auto gamma1 = gamma * L;
+                auto gamma2 = gamma * (L * L + dL);
+                //theta = r P - (r - q) S delta - sigma^2 S^2 gamma / 2 and its derivatives wrt S
+                auto theta = r * P - (r - q) * S * delta - 0.5 * sigma2 * S * S * gamma;
+                auto theta1 = q * delta - (r - q) * S * gamma - sigma2 * S * gamma - 0.5 * sigma2 * S * S * gamma1;
+                auto theta2 = q * gamma - (r - q + sigma2) * (gamma + S * gamma1) - sigma2 * S * gamma1 - 0.5 * sigma2 * S * S * gamma2;
+
+                auto g = (1.0 + delta) * S + gamma0 * (K - S - P) + A * theta;
+                auto g1 = (1.0 - gamma0) * (1.0 + delta) + S * gamma + A * theta1;
+                auto g2 = (2.0 - gamma0) * gamma + S * gamma1 + A * theta2;
+                return 2.0 * g * g1 / (2.0 * g1 * g1 - g * g2);
+            }
+
+            //QD+ price of the put at spot S given its boundary Sb (same formula as qdplus_method_core::calc_price)
+            template<typename Math = library_math>
+            double price(double S, double Sb) const {
+                auto european = [this](double spot, double& theta) {
+                    auto t = terms<Math>(spot);
+                    theta = r * K * dfr * t.N_d2 - q * spot * dfq * t.N_d1 - 0.5 * sigma2 * spot * dfq * t.n_d1 / v;
+                    return K * dfr * t.N_d2 - spot * dfq * t.N_d1;
+                };
+                double theta, theta_b;
+                auto P = european(S, theta);
+                auto P_b = european(Sb, theta_b);
+                auto premium_b = K - Sb - P_b;
+                auto b = 0.5 * alpha * qdd;
+                auto c = -alpha * (1.0 / (1.0 - dfr) - theta_b / (dfr * r * premium_b) + qdd / den);
+                auto log_ratio = Math::log(S / Sb);
+                auto value = P + premium_b / (1.0 - b * log_ratio * log_ratio - c * log_ratio) * Math::exp(qd * log_ratio);
+                //exercised below the boundary, at S = Sb both are K - Sb
+                return Math::select_negative(S - Sb, K - S, value);
+            }
+        };
+
+        /**
+         * Double precision QD+ exercise boundary, by Halley's method on the boundary equation of
+         * qdplus_put_coefficients. It converges in a handful of iterations and in one or two from a warm start. The
+         * call boundary follows from the put-call symmetry B_call(K, r, q) = K^2 / B_put(K, q, r).
+         */
+        struct qdplus_boundary_solver {
+            static constexpr int max_iterations = 32;
+
+            const double K, sigma, r, q;
+            const bool call;
+
+            qdplus_boundary_solver(double K, double sigma, double r, double q, bool call = false):
+                    K{K}, sigma{sigma}, r{r}, q{q}, call{call} {}
+
+            //Cold start from the boundary at the maturity
+            qdplus_boundary operator()(double tau) const {
+                return (*this)(tau, NAN);
+            }
+
+            //Warm start from the boundary of a close time to maturity (or of a neighbouring strike, see rescale)
+            qdplus_boundary operator()(double tau, double guess) const {
+                if (never_optimal_exercise<double>(pricing<double>{K, K, sigma, tau, r, q}, call)) {
+                    return {call ? INFINITY : 0.0, 0};
+                }
+                if (tau == 0) {
+                    auto type = call ? instrument_type::call : instrument_type::put;
+                    return {exercise_boundary_at_maturity<double>(pricing<double>{K, K, sigma, tau, r, q}, type), 0};
+                }
+                if (call) {
+                    auto put = put_boundary(tau, q, r, guess > 0 and std::isfinite(guess) ? K * K / guess : NAN);
+                    return {K * K / put.Sb, put.iterations};
+                }
+                return put_boundary(tau, r, q, guess);
+            }
+
+            //The boundary is homogeneous of degree one in the strike
+            static double rescale(double Sb, double from_K, double to_K) {
+                return Sb * to_K / from_K;
+            }
+
+            //Boundary of the put right before the maturity, K min(1, r/q). Starting from K instead takes tens of
+            //iterations when q > r, where the boundary is far below the strike
+            static double cold_start(double K, double r, double q) {
+                return q > r ? K * r / q : K;
+            }
+
+            //Halley iterations on the boundary equation of a put, from guess
+            static qdplus_boundary solve_put(qdplus_put_coefficients const& put, double guess) {
+                double S = guess;
+                int i = 0;
+                while (i < max_iterations) {
+                    i++;
+                    auto step = put.halley_step(S);
+                    auto next = S - step;
+                    //keep the iterate positive, the equation isn't defined at or below zero
+                    S = next > 0 ? next : 0.5 * S;
+                    if (std::abs(step) <= 1e-12 * S) {
+                        break;
+                    }
+                }
+                return {S, i};
+            }
+
+        private:
+            qdplus_boundary put_boundary(double tau, double r, double q, double guess) const {
+                qdplus_put_coefficients put{K, sigma, r, q, tau};
+                return solve_put(put, guess > 0 and std::isfinite(guess) ? guess : cold_start(K, r, q));
+            }
+        };
+
+        /**
+         * qdplus_put_coefficients of a block of puts, field by field (structure of arrays), so that a loop over the
+         * lanes of the block loads each field of consecutive lanes with one vector load.
+         */
+        template<int lanes>
+        struct qdplus_put_lanes {
+            double K[lanes], sigma2[lanes], r[lanes], q[lanes], tau[lanes];
+            double qd[lanes], qdd[lanes], den[lanes], alpha[lanes], gamma0[lanes], A[lanes];
+            double v[lanes], dfq[lanes], dfr[lanes], drift[lanes];
+
+            void set(int j, qdplus_put_coefficients const& put) {
+                K[j] = put.K; sigma2[j] = put.sigma2; r[j] = put.r; q[j] = put.q; tau[j] = put.tau;
+                qd[j] = put.qd; qdd[j] = put.qdd; den[j] = put.den; alpha[j] = put.alpha; gamma0[j] = put.gamma0; A[j] = put.A;
+                v[j] = put.v; dfq[j] = put.dfq; dfr[j] = put.dfr; drift[j] = put.drift;
+            }
+
+            qdplus_put_coefficients operator[](int j) const {
+                qdplus_put_coefficients put;
+                put.K = K[j]; put.sigma2 = sigma2[j]; put.r = r[j]; put.q = q[j]; put.tau = tau[j];
+                put.qd = qd[j]; put.qdd = qdd[j]; put.den = den[j]; put.alpha = alpha[j]; put.gamma0 = gamma0[j]; put.A = A[j];
+                put.v = v[j]; put.dfq = dfq[j]; put.dfr = dfr[j]; put.drift = drift[j];
+                return put;
+            }
+        };
+
+        /**
+         * QD+ boundaries and prices of a whole chain. Options are processed in blocks of `lanes`: the Halley iterations
+         * of a block run in lock-step, a lane that has converged is masked (its iterate is frozen) and the block stops
+         * when every lane has. Calls are solved as the symmetric put C(S, K, r, q) = P(K, S, q, r), so every lane runs
+         * the same code, and the exp, log and normal cdf of the steps and of the prices are those of vector_math, so
+         * the loops over the lanes vectorize. Blocks are spread over the shared executor and nothing is allocated per
+         * option.
+         */
+        struct qdplus_batch_solver {
+            static constexpr int lanes = 8;
+            static constexpr int max_iterations = qdplus_boundary_solver::max_iterations;
+
+            struct option {
+                double S, K, sigma, tau, r, q;
+                bool call;
+            };
+
+            struct result {
+                double boundary;
+                double price;
+                int iterations;
+            };
+
+            std::vector<result> operator()(std::vector<option> const& options) const {
+                std::vector<result> results(options.size());
+                (*this)(options.data(), results.data(), options.size());
+                return results;
+            }
+
+            void operator()(option const* options, result* results, std::size_t count) const {
+                int blocks = (count + lanes - 1) / lanes;
+                parallel_for(0, blocks, [options, results, count](int block) {
+                    auto first = static_cast<std::size_t>(block) * lanes;
+                    solve_block(options + first, nullptr, results + first, std::min<std::size_t>(lanes, count - first));
+                }, 16);
+            }
+
+            //Contracts of a chain on one market, each block of options gathered on the stack from the columns, with
+            //the discount factors of their expiry. Rows other than american calls and puts are left out of the blocks
+            //and their results are NaN
+            void operator()(instrument_columns const& chain, market_context const& context, result* results) const {
+                auto count = chain.size();
+                int blocks = (count + lanes - 1) / lanes;
+                parallel_for(0, blocks, [&chain, &context, results, count](int block) {
+                    auto first = static_cast<std::size_t>(block) * lanes;
+                    auto last = std::min<std::size_t>(first + lanes, count);
+                    option options[lanes];
+                    expiry_market markets[lanes];
+                    result solved[lanes];
+                    std::size_t rows[lanes];
+                    int width = 0;
+                    for (auto row = first; row < last; row++) {
+                        auto type = chain.type(row);
+                        if (chain.style(row) != american_exercise or (type != instrument_type::call and type != instrument_type::put)) {
+                            results[row] = {NAN, NAN, 0};
+                            continue;
+                        }
+                        markets[width] = context[chain.expiries[row]];
+                        options[width] = {context.S(), chain.strike(row), context.sigma(), markets[width].tau, context.r(), context.q(),
+                                          type == instrument_type::call};
+                        rows[width++] = row;
+                    }
+                    if (width == 0) {
+                        return;
+                    }
+                    solve_block(options, markets, solved, width);
+                    for (int j = 0; j < width; j++) {
+                        results[rows[j]] = solved[j];
+                    }
+                }, 16);
+            }
+
+        private:
+            //markets, if not null, holds the market of the expiry of each option. Flattened: halley_step and price are
+            //too large to be inlined otherwise, and a loop over the lanes with a call in it doesn't vectorize
+            [[gnu::flatten]] static void solve_block(option const* options, expiry_market const* markets, result* results, int width) {
+                qdplus_put_lanes<lanes> put;
+                //spot of the (symmetric) put, iterate and price of each lane
+                double spot[lanes], S[lanes], price[lanes];
+                //all ones while the lane iterates, zero once it is done (a mask of vector_math::select)
+                std::uint64_t active[lanes];
+                std::int64_t iterations[lanes];
+                for (int j = 0; j < lanes; j++) {
+                    //the unused lanes of the last block repeat its first option
+                    auto const& o = options[j < width ? j : 0];
+                    spot[j] = o.call ? o.K : o.S;
+                    auto strike = o.call ? o.S : o.K;
+                    auto r = o.call ? o.q : o.r;
+                    auto q = o.call ? o.r : o.q;
+                    if (markets) {
+                        //the symmetric put of a call swaps the discount factors too
+                        auto const& m = markets[j < width ? j : 0];
+                        put.set(j, qdplus_put_coefficients{strike, o.sigma, r, q, o.tau, o.call ? m.df_q : m.df_r, o.call ? m.df_r : m.df_q, m.v});
+                    } else {
+                        put.set(j, qdplus_put_coefficients{strike, o.sigma, r, q, o.tau});
+                    }
+                    auto exercise = o.tau > 0 and not never_optimal_exercise<double>(pricing<double>{strike, strike, o.sigma, o.tau, r, q}, false);
+                    active[j] = exercise ? ~0ull : 0;
+                    S[j] = qdplus_boundary_solver::cold_start(strike, r, q);
+                    iterations[j] = 0;
+                }
+
+                //the steps of the lanes that are done (or never exercised, whose steps may not be finite) are dropped
+                for (int i = 0; i < max_iterations; i++) {
+                    for (int j = 0; j < lanes; j++) {
+                        auto step = put[j].halley_step<vector_math>(S[j]);
+                        auto next = S[j] - step;
+                        //keep the iterate positive, the equation isn't defined at or below zero
+                        next = vector_math::select_negative(next, 0.5 * S[j], next);
+                        S[j] = vector_math::select(active[j], next, S[j]);
+                        iterations[j] += active[j] & 1;
+                        //done once |step| <= 1e-12 S
+                        active[j] &= vector_math::negative(1e-12 * next - std::abs(step));
+                    }
+                    if (std::none_of(active, active + lanes, [](std::uint64_t a) { return a != 0; })) {
+                        break;
+                    }
+                }
+
+                for (int j = 0; j < lanes; j++) {
+                    price[j] = put[j].price<vector_math>(spot[j], S[j]);
+                }
+
+                for (int j = 0; j < width; j++) {
+                    auto const& o = options[j];
+                    auto strike = put.K[j];
+                    pricing<double> p{spot[j], strike, o.sigma, o.tau, put.r[j], put.q[j]};
+                    auto Sb = S[j];
+                    if (o.tau <= 0) {
+                        Sb = exercise_boundary_at_maturity<double>(p, instrument_type::put);
+                        price[j] = std::max(strike - spot[j], 0.0);
+                    } else if (never_optimal_exercise<double>(p, false)) {
+                        Sb = 0.0;
+                        price[j] = calculate_european_put<double>(p);
+                    }
+                    //boundary of the put of strike `strike` back to the option: a call boundary is K S/B
+                    results[j] = {o.call ? (Sb > 0 ? o.K * o.S / Sb : INFINITY) : Sb, price[j], static_cast<int>(iterations[j])};
+                }
+            }
+        };
+
+    }
+}
+
+#endif //BSM_SOLVER_QDPLUS_INTERNALS_H
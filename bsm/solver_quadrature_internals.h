@@ -0,0 +1,341 @@
+#ifndef BSM_SOLVER_QUADRATURE_INTERNALS_H
+#define BSM_SOLVER_QUADRATURE_INTERNALS_H
+
+#include <array>
+#include <vector>
+#include <utility>
+#include <numbers>
+#include <cmath>
+
+namespace bsm {
+    namespace internals {
+
+        /**
+         * The few elementary functions the tables below need, usable in constant expressions (the <cmath> ones are
+         * not constexpr in C++20). Arguments are reduced to the range where the Taylor series is accurate to an ulp.
+         */
+        namespace constexpr_math {
+
+            constexpr double abs(double x) {
+                return x < 0 ? -x : x;
+            }
+
+            constexpr double sqrt(double x) {
+                if (x <= 0) {
+                    return 0.0;
+                }
+                double y = x > 1 ? x : 1.0;
+                for (int i = 0; i < 100; i++) {
+                    double next = 0.5 * (y + x / y);
+                    if (next >= y) {
+                        break;
+                    }
+                    y = next;
+                }
+                return y;
+            }
+
+            //Taylor series, |x| <= pi/4
+            constexpr double cos_series(double x) {
+                double term = 1.0, sum = 1.0;
+                for (int k = 1; k < 12; k++) {
+                    term *= -x * x / ((2 * k - 1) * (2 * k));
+                    sum += term;
+                }
+                return sum;
+            }
+
+            constexpr double sin_series(double x) {
+                double term = x, sum = x;
+                for (int k = 1; k < 12; k++) {
+                    term *= -x * x / ((2 * k) * (2 * k + 1));
+                    sum += term;
+                }
+                return sum;
+            }
+
+            //cos(m pi/n), the argument is reduced exactly in integers
+            constexpr double cos_pi_fraction(long m, long n) {
+                m %= 2 * n;
+                if (m < 0) {
+                    m += 2 * n;
+                }
+                if (m > n) {
+                    m = 2 * n - m;
+                }
+                if (2 * m > n) {
+                    return -cos_pi_fraction(n - m, n);
+                }
+                if (4 * m > n) {
+                    return sin_series(std::numbers::pi * (n - 2 * m) / (2.0 * n));
+                }
+                return cos_series(std::numbers::pi * m / n);
+            }
+
+            constexpr double cos(double x) {
+                constexpr double two_pi = 2.0 * std::numbers::pi;
+                x -= two_pi * static_cast<long>(x / two_pi);
+                if (x < 0) {
+                    x = -x;
+                }
+                if (x > std::numbers::pi) {
+                    x = two_pi - x;
+                }
+                if (x > std::numbers::pi / 2) {
+                    return -cos(std::numbers::pi - x);
+                }
+                if (x > std::numbers::pi / 4) {
+                    return sin_series(std::numbers::pi / 2 - x);
+                }
+                return cos_series(x);
+            }
+
+            constexpr double exp(double x) {
+                //x = k ln2 + y with |y| <= ln2/2
+                long k = static_cast<long>(x / std::numbers::ln2 + (x < 0 ? -0.5 : 0.5));
+                double y = x - k * std::numbers::ln2;
+                double term = 1.0, sum = 1.0;
+                for (int i = 1; i < 20; i++) {
+                    term *= y / i;
+                    sum += term;
+                }
+                for (; k > 0; k--) {
+                    sum *= 2.0;
+                }
+                for (; k < 0; k++) {
+                    sum *= 0.5;
+                }
+                return sum;
+            }
+
+        }
+
+        /**
+         * Nodes and weights of the l points Gauss-Legendre quadrature on [-1,1], ascending. The roots of the Legendre
+         * polynomial are found by Newton's method from the usual Chebyshev-like initial guesses.
+         */
+        constexpr void gauss_legendre(int l, double* nodes, double* weights) {
+            for (int i = 0; i < (l + 1) / 2; i++) {
+                double x = constexpr_math::cos(std::numbers::pi * (i + 0.75) / (l + 0.5));
+                double dp = 0;
+                for (int k = 0; k < 100; k++) {
+                    //Legendre polynomial P_l(x) and its derivative by recurrence
+                    double p0 = 1.0, p1 = x;
+                    for (int j = 2; j <= l; j++) {
+                        double p2 = ((2.0 * j - 1.0) * x * p1 - (j - 1.0) * p0) / j;
+                        p0 = p1;
+                        p1 = p2;
+                    }
+                    auto p = l == 1 ? x : p1;
+                    auto pm1 = l == 1 ? 1.0 : p0;
+                    dp = l * (x * p - pm1) / (x * x - 1.0);
+                    auto dx = p / dp;
+                    x -= dx;
+                    if (constexpr_math::abs(dx) < 1e-15) {
+                        break;
+                    }
+                }
+                nodes[i] = -x;
+                nodes[l - 1 - i] = x;
+                weights[i] = weights[l - 1 - i] = 2.0 / ((1.0 - x * x) * dp * dp);
+            }
+        }
+
+        template<int L>
+        struct gauss_legendre_rule {
+            std::array<double, L> nodes{}, weights{};
+
+            constexpr gauss_legendre_rule() {
+                gauss_legendre(L, nodes.data(), weights.data());
+            }
+        };
+
+        template<int L>
+        inline constexpr gauss_legendre_rule<L> gauss_legendre_table{};
+
+        /**
+         * Tanh-sinh (double exponential) quadrature on [-1,1] with L points, x_k = tanh(pi/2 sinh(k h)) for
+         * |k| <= (L-1)/2 and the step h picked so that the outermost nodes are at t = +-3. It handles end point
+         * singularities of the integrand, which Gauss-Legendre does not.
+         */
+        template<int L>
+        struct tanh_sinh_rule {
+            std::array<double, L> nodes{}, weights{};
+
+            constexpr tanh_sinh_rule() {
+                static_assert(L % 2 == 1 and L >= 3, "Tanh-sinh rules have an odd number of points");
+                constexpr int half = (L - 1) / 2;
+                constexpr double h = 3.0 / half;
+                for (int k = -half; k <= half; k++) {
+                    auto e = constexpr_math::exp(k * h);
+                    auto sinh = 0.5 * (e - 1.0 / e);
+                    auto cosh = 0.5 * (e + 1.0 / e);
+                    auto u = constexpr_math::exp(std::numbers::pi * sinh);
+                    //tanh(pi/2 sinh) and 1/cosh^2(pi/2 sinh) from u = e^{pi sinh}
+                    nodes[k + half] = (u - 1.0) / (u + 1.0);
+                    weights[k + half] = h * std::numbers::pi / 2.0 * cosh * 4.0 * u / ((u + 1.0) * (u + 1.0));
+                }
+            }
+        };
+
+        template<int L>
+        inline constexpr tanh_sinh_rule<L> tanh_sinh_table{};
+
+        /**
+         * Chebyshev extrema z_i = -cos(i pi/n), i = 0..n (ascending) and the matrices that act on values at those
+         * nodes:
+         *   interpolation: a = interpolation . values are the coefficients of the interpolating Chebyshev series,
+         *   differentiation: differentiation . values are the derivatives of the interpolant at the nodes,
+         * both row major, and the barycentric weights (-1)^i, halved at both ends.
+         */
+        template<int N>
+        struct chebyshev_rule {
+            std::array<double, N + 1> nodes{}, barycentric{};
+            std::array<double, (N + 1) * (N + 1)> interpolation{}, differentiation{};
+
+            constexpr chebyshev_rule() {
+                for (int i = 0; i <= N; i++) {
+                    nodes[i] = -constexpr_math::cos_pi_fraction(i, N);
+                    barycentric[i] = (i % 2 == 0 ? 1.0 : -1.0) * ((i == 0 or i == N) ? 0.5 : 1.0);
+                }
+                for (int k = 0; k <= N; k++) {
+                    double scale = ((k == 0 or k == N) ? 0.5 : 1.0) * 2.0 / N;
+                    for (int i = 0; i <= N; i++) {
+                        //node i is cos((N-i) pi/N), the end points count half
+                        double end = (i == 0 or i == N) ? 0.5 : 1.0;
+                        interpolation[k * (N + 1) + i] = scale * end * constexpr_math::cos_pi_fraction(static_cast<long>(k) * (N - i), N);
+                    }
+                }
+                for (int i = 0; i <= N; i++) {
+                    double diagonal = 0;
+                    for (int j = 0; j <= N; j++) {
+                        if (i != j) {
+                            auto d = barycentric[j] / barycentric[i] / (nodes[i] - nodes[j]);
+                            differentiation[i * (N + 1) + j] = d;
+                            diagonal -= d;
+                        }
+                    }
+                    differentiation[i * (N + 1) + i] = diagonal;
+                }
+            }
+        };
+
+        template<int N>
+        inline constexpr chebyshev_rule<N> chebyshev_table{};
+
+        //Orders with a compile time table, larger ones are computed at runtime
+        constexpr int max_gauss_legendre_table = 64;
+        constexpr int max_chebyshev_table = 32;
+
+        struct quadrature_view {
+            const double* nodes;
+            const double* weights;
+        };
+
+        struct chebyshev_view {
+            const double* nodes;
+            const double* barycentric;
+            const double* interpolation;
+            const double* differentiation;
+        };
+
+        template<int... L>
+        constexpr std::array<quadrature_view, sizeof...(L)> make_gauss_legendre_index(std::integer_sequence<int, L...>) {
+            return {{{gauss_legendre_table<L + 1>.nodes.data(), gauss_legendre_table<L + 1>.weights.data()}...}};
+        }
+
+        template<int... N>
+        constexpr std::array<chebyshev_view, sizeof...(N)> make_chebyshev_index(std::integer_sequence<int, N...>) {
+            return {{{chebyshev_table<N + 1>.nodes.data(), chebyshev_table<N + 1>.barycentric.data(),
+                      chebyshev_table<N + 1>.interpolation.data(), chebyshev_table<N + 1>.differentiation.data()}...}};
+        }
+
+        inline constexpr auto gauss_legendre_index = make_gauss_legendre_index(std::make_integer_sequence<int, max_gauss_legendre_table>{});
+        inline constexpr auto chebyshev_index = make_chebyshev_index(std::make_integer_sequence<int, max_chebyshev_table>{});
+
+        //Gauss-Legendre rule of order l, from the tables when available
+        inline void gauss_legendre(int l, std::vector<double>& nodes, std::vector<double>& weights) {
+            if (l >= 1 and l <= max_gauss_legendre_table) {
+                auto const& rule = gauss_legendre_index[l - 1];
+                nodes.assign(rule.nodes, rule.nodes + l);
+                weights.assign(rule.weights, rule.weights + l);
+                return;
+            }
+            nodes.resize(l);
+            weights.resize(l);
+            gauss_legendre(l, nodes.data(), weights.data());
+        }
+
+        //Table of the n+1 Chebyshev extrema, nullptr when n has none
+        inline chebyshev_view const* chebyshev_tables(int n) {
+            return n >= 1 and n <= max_chebyshev_table ? &chebyshev_index[n - 1] : nullptr;
+        }
+
+        /**
+         * Chebyshev nodes of the second kind (extrema), ascending: z_i = -cos(i pi/n), i = 0..n
+         */
+        inline std::vector<double> chebyshev_nodes(int n) {
+            if (auto table = chebyshev_tables(n)) {
+                return {table->nodes, table->nodes + n + 1};
+            }
+            std::vector<double> z(n + 1);
+            for (int i = 0; i <= n; i++) {
+                z[i] = -cos(i * std::numbers::pi / n);
+            }
+            return z;
+        }
+
+        /**
+         * Polynomial interpolation through the values at the n+1 Chebyshev nodes, evaluated by Clenshaw's recurrence.
+         */
+        struct chebyshev_interpolation {
+            std::vector<double> a;
+
+            chebyshev_interpolation() = default;
+
+            explicit chebyshev_interpolation(std::vector<double> const& values) {
+                fit(values);
+            }
+
+            void fit(std::vector<double> const& values) {
+                int n = values.size() - 1;
+                a.assign(n + 1, 0.0);
+                if (auto table = chebyshev_tables(n)) {
+                    for (int k = 0; k <= n; k++) {
+                        auto const* row = table->interpolation + k * (n + 1);
+                        double sum = 0;
+                        for (int i = 0; i <= n; i++) {
+                            sum += row[i] * values[i];
+                        }
+                        a[k] = sum;
+                    }
+                    return;
+                }
+                for (int k = 0; k <= n; k++) {
+                    double sum = 0;
+                    for (int i = 0; i <= n; i++) {
+                        //node i is cos((n-i) pi/n), the end points count half
+                        double term = values[i] * cos(k * (n - i) * std::numbers::pi / n);
+                        sum += (i == 0 or i == n) ? 0.5 * term : term;
+                    }
+                    a[k] = 2.0 * sum / n;
+                }
+                a[0] *= 0.5;
+                a[n] *= 0.5;
+            }
+
+            double operator()(double z) const {
+                double b1 = 0, b2 = 0;
+                for (int k = a.size() - 1; k >= 1; k--) {
+                    double b0 = 2.0 * z * b1 - b2 + a[k];
+                    b2 = b1;
+                    b1 = b0;
+                }
+                return z * b1 - b2 + a[0];
+            }
+        };
+
+    }
+}
+
+#endif //BSM_SOLVER_QUADRATURE_INTERNALS_H
@@ -0,0 +1,129 @@
+#include "solver.h"
+
+#include "solver_trinomial_internals.h"
+#include "solver_american_internals.h"
+
+#include <optional>
+
+using namespace bsm::internals;
+
+namespace bsm {
+
+    struct trinomial_pricing_method: pricing<double>, american_method {
+        std::function<trinomial_payoff_type<double>> calc_payoff;
+        generic_trinomial_pricing_method<double> trinomial;
+        const instrument instrument_;
+        const int steps;
+        const bool early_exercise;
+        std::optional<lattice_boundary_curve<double>> boundary;
+        lazy_boundary_curve curve_;
+
+        trinomial_pricing_method(european const& instrument, mkt_params<double> mp, int steps):
+                pricing{instrument,mp}, trinomial{instrument, mp, steps}, calc_payoff{[&instrument](double price) { return instrument.payoff(price); }}, steps{steps}, instrument_{instrument}, early_exercise{false}
+        {
+            trinomial.solve(calc_payoff, early_exercise);
+        }
+
+        trinomial_pricing_method(american const& instrument, mkt_params<double> mp, int steps):
+                pricing{instrument,mp}, trinomial{instrument, mp, steps}, calc_payoff{[K = static_cast<double>(instrument.K), type = instrument.type](double price) { return std::max(type == instrument_type::call ? price - K : K - price, 0.0); }}, steps{steps}, instrument_{instrument}, early_exercise{true}
+        {
+            boundary.emplace(tau, trinomial.solve(calc_payoff, early_exercise));
+        }
+
+        double price() override {
+            return trinomial.price();
+        }
+
+        double delta() override {
+            return trinomial.delta();
+        }
+
+        double gamma() override {
+            return trinomial.gamma();
+        }
+
+        double vega() override {
+            pricing<double> bumped_up{trinomial.pp};
+            bumped_up.sigma *= exp(0.01);
+            return (reprice(bumped_up) - trinomial.price()) / (bumped_up.sigma - trinomial.pp.sigma);
+        }
+
+        double theta() override {
+            return trinomial.theta();
+        }
+
+        double rho() override {
+            pricing<double> bumped_up{trinomial.pp};
+            if(bumped_up.r!=0)
+                bumped_up.r *= exp(0.01);
+            else
+                bumped_up.r += 0.01;
+            return (reprice(bumped_up) - trinomial.price()) / (bumped_up.r - trinomial.pp.r);
+        }
+
+        double psi() override {
+            pricing<double> bumped_up{trinomial.pp};
+            if(bumped_up.q!=0)
+                bumped_up.q *= exp(0.01);
+            else
+                bumped_up.q += 0.01;
+            return (reprice(bumped_up) - trinomial.price()) / (bumped_up.q - trinomial.pp.q);
+        }
+
+        std::shared_ptr<const boundary_curve> exercise_boundary_curve() override {
+            return curve_.get([this] {
+                return std::make_shared<const boundary_curve>([this](double _tau) { return static_cast<double>(exercise_boundary(_tau)); }, tau, instrument_.type);
+            });
+        }
+
+        long double exercise_boundary(long double _tau) override {
+            bool call = instrument_.type==instrument_type::call;
+            if(never_optimal_exercise<double>(*this,instrument_.type)) {
+                return call? INFINITY : 0.0;
+            }
+            if(tau==0) {
+                return exercise_boundary_at_maturity<double>(*this,instrument_.type);
+            }
+
+            if(boundary) {
+                return boundary.value()(_tau);
+            }
+
+            return NAN;
+        }
+
+    private:
+        double reprice(pricing<double> const& bumped) {
+            generic_trinomial_pricing_method<double> bumped_trinomial{instrument_, bumped, steps};
+            bumped_trinomial.solve(calc_payoff, early_exercise);
+            return bumped_trinomial.price();
+        }
+    };
+
+    template<>
+    std::unique_ptr<method> trinomial_solver<autodiff_off>::operator()(european_call& instrument) {
+        trinomial_pricing_method gp{instrument, mktParams, steps};
+        return std::make_unique<trinomial_pricing_method>(gp);
+    }
+
+    template<>
+    std::unique_ptr<method> trinomial_solver<autodiff_off>::operator()(european_put& instrument) {
+        trinomial_pricing_method gp{instrument, mktParams, steps};
+        return std::make_unique<trinomial_pricing_method>(gp);
+    }
+
+    template<>
+    std::unique_ptr<american_method> trinomial_solver<autodiff_off>::operator()(american_put& instrument) {
+        trinomial_pricing_method gp{instrument, mktParams, steps};
+        return std::make_unique<trinomial_pricing_method>(gp);
+    }
+
+    template<>
+    std::unique_ptr<american_method> trinomial_solver<autodiff_off>::operator()(american_call& instrument) {
+        return solve_by_symmetry(instrument, mktParams, [this](american_put& put, mkt_params<double> const& mp) {
+            trinomial_solver<autodiff_off> solve{mp, steps};
+            return solve(put);
+        });
+    }
+
+}
@@ -0,0 +1,219 @@
+#ifndef BSM_SOLVER_TRINOMIAL_INTERNALS_H
+#define BSM_SOLVER_TRINOMIAL_INTERNALS_H
+
+#include "common.h"
+#include "instruments.h"
+#include "solver.h"
+#include "solver_american_internals.h"
+
+#include "executor.h"
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <tuple>
+#include <cassert>
+#include <cmath>
+
+namespace bsm {
+    namespace internals {
+
+        template<typename T>
+        using trinomial_payoff_type = T(T const&);
+
+        /**
+         * Kamrad-Ritchken trinomial lattice. The strike falls exactly on a level of the lattice, which removes most of
+         * the odd-even oscillation binomial trees show near the money: the stretch parameter lambda is picked so that
+         * the strike is a whole number of levels from the spot or, for a strike within dx = sigma sqrt(dt) of the spot
+         * (where lambda would drop below 1 and pm below 0), the levels are laid on the strike and the spot falls
+         * between two of them.
+         * The lattice starts lead steps before the valuation, so that the valuation step has 2*lead+1 nodes around the
+         * spot: the price, delta and gamma are those of the cubic through the four levels closest to the spot, and
+         * theta compares it with the same cubic one step later.
+         * The underlying is packed in a single vector of 2*(steps+lead)+1 levels (node j of lattice step t is the
+         * level t-j) and the premiums are kept in two rolling layers, so memory is O(steps) instead of O(steps^2).
+         * @tparam T
+         */
+        template<typename T>
+        struct generic_trinomial_pricing_method {
+        protected:
+            static constexpr int lead = 2;
+            const int steps;
+            const instrument_type type;
+            std::vector<T> levels;
+            //Premium layers of the valuation step and the next one are kept around for the greeks
+            std::vector<std::pair<T,bool>> layer0, layer1;
+            T u_, dt_, pu_, pm_, pd_, discount_factor_, lambda_;
+        public:
+            pricing<T> pp;
+
+            generic_trinomial_pricing_method(instrument const& instrument, pricing<T> const& pp, int steps):
+                    steps{steps}, type{instrument.type}, pp{pp} {
+                generate_levels();
+            }
+
+            generic_trinomial_pricing_method(instrument const& instrument, mkt_params<double> mp, int steps):
+                    generic_trinomial_pricing_method{instrument, pricing<T>{instrument, mp}, steps} {}
+
+            //Price of the underlying at node i of lattice step t, the valuation being the step lead
+            T ut(int t, int i) const {
+                return levels[steps + lead + t - i];
+            }
+
+            T lambda() const {
+                return lambda_;
+            }
+
+            void generate_levels() {
+                auto dt = dt_ = pp.tau / steps;
+                auto dx = pp.sigma * sqrt(dt);
+                //lambda = sqrt(3/2) gives pm = 1/3, which is the usual choice when nothing else constrains the grid
+                T lambda = sqrt(1.5);
+                auto x = log(pp.K / pp.S);
+                //log of the centre level over the spot
+                T offset = 0;
+                if (std::abs(x) >= dx) {
+                    //Choose the number of levels between spot and strike and stretch the grid so that the strike is a
+                    //level: the stretch closest to sqrt(3/2), or the one just above 1 when that one is below
+                    auto n = std::max(1.0, std::round(std::abs(x) / (lambda * dx)));
+                    if (std::abs(x) / (n * dx) < 1.0) {
+                        n -= 1;
+                    }
+                    lambda = std::abs(x) / (n * dx);
+                } else if (x != 0) {
+                    //Levels on the strike, centred on the one closest to the spot
+                    offset = x - std::round(x / (lambda * dx)) * lambda * dx;
+                }
+                lambda_ = lambda;
+                auto drift = (pp.r - pp.q - pp.sigma * pp.sigma / 2.0) * sqrt(dt) / (2.0 * lambda * pp.sigma);
+                pu_ = 1.0 / (2.0 * lambda * lambda) + drift;
+                pd_ = 1.0 / (2.0 * lambda * lambda) - drift;
+                pm_ = 1.0 - 1.0 / (lambda * lambda);
+                assert(("The trinomial probabilities must be positive, use more steps", pu_ >= 0 and pd_ >= 0 and pm_ >= 0));
+                u_ = exp(lambda * dx);
+                discount_factor_ = exp(-pp.r * dt);
+
+                auto last = steps + lead;
+                levels.resize(2 * last + 1);
+                auto S = pp.S * exp(offset);
+                auto u = u_;
+                parallel_for(0, 2 * last + 1, [this, S, u, last](int k) {
+                    levels[k] = S * pow(u, k - last);
+                });
+            }
+
+            T price() const {
+                return std::get<0>(at_spot(layer0, lead));
+            }
+
+            T delta() const {
+                return std::get<1>(at_spot(layer0, lead));
+            }
+
+            T gamma() const {
+                return std::get<2>(at_spot(layer0, lead));
+            }
+
+            T theta() const {
+                return (std::get<0>(at_spot(layer1, lead + 1)) - std::get<0>(at_spot(layer0, lead))) / dt_;
+            }
+
+            std::vector<T> solve(std::function<trinomial_payoff_type<T>> calc_payoff, bool early_exercise_possible) {
+                auto pu = pu_;
+                auto pm = pm_;
+                auto pd = pd_;
+                auto discount_factor = discount_factor_;
+
+                auto last = steps + lead;
+                std::vector<std::pair<T,bool>> in(2 * last + 1);
+                std::vector<std::pair<T,bool>> out(2 * last + 1);
+                std::vector<T> boundary(steps + 1);
+                exercise_frontier_tracker tracker{type};
+                if (early_exercise_possible) {
+                    boundary[steps] = exercise_boundary_at_maturity<T>(pp, type);
+                }
+
+                parallel_for(0, 2 * last + 1, [this, &in, &calc_payoff, last](int i) {
+                    in[i] = std::make_pair(calc_payoff(this->ut(last, i)), false);
+                });
+
+                for (int t = last - 1; t >= lead; t--) {
+                    parallel_for(0, 2 * t + 1,
+                        [&in, &out, pu, pm, pd, discount_factor, early_exercise_possible, &calc_payoff, t, this](int i) {
+                            auto continuation = (pu * in[i].first + pm * in[i + 1].first + pd * in[i + 2].first) * discount_factor;
+                            auto node = std::make_pair(continuation, false);
+                            if (early_exercise_possible) {
+                                T payoff = calc_payoff(this->ut(t, i));
+                                if (payoff > continuation) {
+                                    node = std::make_pair(payoff, true);
+                                }
+                            }
+                            out[i] = node;
+                        });
+
+                    if (early_exercise_possible) {
+                        boundary[t - lead] = frontier(out, t, calc_payoff, tracker, boundary[t - lead + 1]);
+                    }
+
+                    if (t == lead + 1) {
+                        layer1.assign(out.begin(), out.begin() + 2 * t + 1);
+                    } else if (t == lead) {
+                        layer0.assign(out.begin(), out.begin() + 2 * t + 1);
+                    }
+                    std::swap(in, out);
+                }
+
+                return boundary;
+            }
+
+        private:
+            /**
+             * Value at the spot of the cubic through the four levels of lattice step t closest to it, with its first
+             * and second derivatives (Newton's divided differences).
+             */
+            std::tuple<T, T, T> at_spot(std::vector<std::pair<T,bool>> const& layer, int t) const {
+                //the centre node (node t) is the level closest to the spot
+                int first = pp.S >= ut(t, t) ? t - 2 : t - 1;
+                T s[4], v[4];
+                for (int j = 0; j < 4; j++) {
+                    s[j] = ut(t, first + j);
+                    v[j] = layer[first + j].first;
+                }
+                auto f01 = (v[1] - v[0]) / (s[1] - s[0]);
+                auto f12 = (v[2] - v[1]) / (s[2] - s[1]);
+                auto f23 = (v[3] - v[2]) / (s[3] - s[2]);
+                auto f012 = (f12 - f01) / (s[2] - s[0]);
+                auto f123 = (f23 - f12) / (s[3] - s[1]);
+                auto f0123 = (f123 - f012) / (s[3] - s[0]);
+                auto a = pp.S - s[0], b = pp.S - s[1], c = pp.S - s[2];
+                return {v[0] + a * (f01 + b * (f012 + c * f0123)),
+                        f01 + f012 * (a + b) + f0123 * (a * b + a * c + b * c),
+                        2.0 * f012 + 2.0 * f0123 * (a + b + c)};
+            }
+
+            /**
+             * Exercise boundary at step t, interpolated between the frontier node and its neighbour in the continuation
+             * region. The node i+1 of step t+1 has the same spot as the node i of step t, hence the shift of -1.
+             */
+            T frontier(std::vector<std::pair<T,bool>> const& layer, int t, std::function<trinomial_payoff_type<T>> const& calc_payoff,
+                       exercise_frontier_tracker& tracker, T fallback) const {
+                int last = 2 * t;
+                int b = tracker.track(0, last, -1, [&layer](int i) { return layer[i].second; });
+                int c = type == instrument_type::put ? b - 1 : b + 1;
+                if (b >= 0 and c >= 0 and c <= last) {
+                    return interpolate_frontier<T>(ut(t, b), layer[b].first, calc_payoff(ut(t, b)),
+                                                   ut(t, c), layer[c].first, calc_payoff(ut(t, c)));
+                }
+                if (b >= 0) {
+                    return ut(t, b);
+                }
+                //no exercise at this step, carry the boundary from the next step
+                return fallback;
+            }
+        };
+
+    }
+}
+
+#endif //BSM_SOLVER_TRINOMIAL_INTERNALS_H
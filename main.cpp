@@ -1,43 +1,376 @@
 #include "bsm.h"
+#include "executor.h"
 
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include <taskflow/taskflow.hpp>
+#if __has_include(<taskflow/algorithm/pipeline.hpp>)
+#include <taskflow/algorithm/pipeline.hpp>
+#elif __has_include(<taskflow/pipeline.hpp>)
+#include <taskflow/pipeline.hpp>
+#endif
 
-int main() {
-    //See tests for examples
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
 
-    tf::Executor executor;
-    tf::Taskflow taskflow;
+using namespace bsm;
+using namespace bsm::chrono;
+
+/**
+ * Batch pricer: reads one option and its market per CSV row, from a file or stdin, and writes its price and greeks
+ * as CSV, in the order of the input.
+ *
+ *   input:  id,type,style,strike,expiry,spot,volatility,rate,dividend
+ *   output: id,price,delta,gamma,vega,theta,error
+ *
+ * type is call or put, style european or american, expiry a date (YYYY-MM-DD) or a year fraction from the valuation
+ * instant. A first row whose first two fields are "id" and "type" is a header. Rows that cannot be priced, blank ones
+ * included, keep their place in the output with the reason in the error column.
+ *
+ * The input goes through a pipeline of reader -> pricer -> writer stages, one chunk of rows at a time: the reader and
+ * the writer are serial (so the output keeps the input order), the pricer is parallel. Memory is bounded by the
+ * chunks in flight, one per pipeline line.
+ */
+
+namespace {
+
+    enum class solver_choice {
+        //analytical for european options, QD+ for american ones
+        automatic, analytical, crr, qdplus
+    };
+
+    struct options {
+        std::string input = "-";
+        std::string output = "-";
+        solver_choice solver = solver_choice::automatic;
+        int crr_steps = 500;
+        std::size_t chunk_rows = 4096;
+        std::size_t threads = executor_configuration().threads;
+        std::optional<datetime> valuation;
+    };
+
+    struct chunk {
+        std::vector<std::string> rows;
+        std::string priced;
+    };
+
+    void usage() {
+        std::cerr << "Usage: main [options] [input.csv | -]\n"
+                     "  --solver auto|analytical|crr|qdplus  solver of every row (auto: analytical for european, QD+ for american)\n"
+                     "  --steps N        CRR time steps (500)\n"
+                     "  --chunk N        rows per chunk (4096)\n"
+                     "  --threads N      worker threads\n"
+                     "  --valuation D    valuation date YYYY-MM-DD (now)\n"
+                     "  --output FILE    output file (stdout)\n"
+                     "Input rows: id,type,style,strike,expiry,spot,volatility,rate,dividend\n"
+                     "Rows that cannot be priced, blank ones included, get an error in the last output column\n";
+    }
+
+    template<typename T>
+    bool parse_number(std::string_view text, T& value) {
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return error == std::errc{} and end == text.data() + text.size();
+    }
 
-    auto [A, B, C, D] = taskflow.emplace(  // create four tasks
-            [] () { std::cout << "TaskA\n"; },
-            [] () { std::cout << "TaskB\n"; },
-            [] () { std::cout << "TaskC\n"; },
-            [] () { std::cout << "TaskD\n"; }
-    );
+    std::optional<datetime> parse_date(std::string_view text) {
+        int y;
+        unsigned m, d;
+        if (text.size() != 10 or text[4] != '-' or text[7] != '-' or not parse_number(text.substr(0, 4), y)
+            or not parse_number(text.substr(5, 2), m) or not parse_number(text.substr(8, 2), d)) {
+            return std::nullopt;
+        }
+        year_month_day date{year{y}, month{m}, day{d}};
+        if (not date.ok()) {
+            return std::nullopt;
+        }
+        return datetime{date};
+    }
 
-    A.precede(B, C);  // A runs before B and C
-    D.succeed(B, C);  // D runs after  B and C
+    template<typename Solver, typename Instrument>
+    void price_with(Solver& solver, Instrument& instrument, std::string& out) {
+        auto pricing = solver(instrument);
+        for (auto value: {pricing->price(), pricing->delta(), pricing->gamma(), pricing->vega(), pricing->theta()}) {
+            char buffer[32];
+            auto end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+            out += ',';
+            out.append(buffer, end);
+        }
+        out += ',';
+    }
 
-    int* vec;
-    int first, last;
+    template<typename Instrument>
+    std::string_view price_instrument(options const& opts, mkt_params<double> const& mkt, Instrument& instrument, bool early_exercise, std::string& out) {
+        auto solver = opts.solver;
+        if (solver == solver_choice::automatic) {
+            solver = early_exercise ? solver_choice::qdplus : solver_choice::analytical;
+        }
+        if (solver == solver_choice::crr) {
+            crr_solver crr{mkt, opts.crr_steps};
+            price_with(crr, instrument, out);
+        } else if (solver == solver_choice::analytical) {
+            if constexpr (std::is_base_of_v<european, Instrument>) {
+                analytical_solver<autodiff_off> analytical{mkt};
+                price_with(analytical, instrument, out);
+            } else {
+                return "analytical prices european options only";
+            }
+        } else {
+            if constexpr (std::is_base_of_v<american, Instrument>) {
+                qdplus_solver qdplus{mkt_params<long double>{mkt.S, mkt.sigma, mkt.t, mkt.r, mkt.q}};
+                price_with(qdplus, instrument, out);
+            } else {
+                return "QD+ prices american options only";
+            }
+        }
+        return {};
+    }
 
-    auto init = taskflow.emplace([&](){
-        first = 0;
-        last  = 1000;
-        vec = new int[1000];
-    });
+    //A header names the columns: its first two fields are id and type, so that an id starting with "id" is a row
+    bool is_header(std::string_view row) {
+        return row.starts_with("id,type,");
+    }
 
-    auto pf = taskflow.for_each_index(std::ref(first), std::ref(last), 1,
-                                      [&] (int i) {
-                                          std::cout << "parallel iteration on index " << vec[i] << '\n';
-                                      }
-    );
+    //Prices a row, appending its output line to out
+    void price_row(options const& opts, datetime valuation, std::string_view row, std::string& out) {
+        std::string_view fields[9];
+        //count goes on past the ninth field, so that longer rows are rejected
+        std::size_t count = 0;
+        for (std::size_t start = 0;;) {
+            auto comma = row.find(',', start);
+            if (count < 9) {
+                fields[count] = row.substr(start, comma - start);
+            }
+            count++;
+            if (comma == std::string_view::npos) {
+                break;
+            }
+            start = comma + 1;
+        }
+        out.append(fields[0]);
+        auto mark = out.size();
+        auto fail = [&out, mark](std::string_view error) {
+            out.resize(mark);
+            out += ",,,,,,";
+            out.append(error);
+            out += '\n';
+        };
 
-    init.precede(pf);
+        if (row.empty()) {
+            return fail("blank row");
+        }
+        if (count != 9) {
+            return fail("expected 9 fields");
+        }
+        bool call = fields[1] == "call", put = fields[1] == "put";
+        bool american_style = fields[2] == "american", european_style = fields[2] == "european";
+        double K, tau, S, sigma, r, q;
+        if (not call and not put) {
+            return fail("type is call or put");
+        }
+        if (not american_style and not european_style) {
+            return fail("style is european or american");
+        }
+        if (not parse_number(fields[3], K) or not parse_number(fields[5], S) or not parse_number(fields[6], sigma)
+            or not parse_number(fields[7], r) or not parse_number(fields[8], q)) {
+            return fail("invalid number");
+        }
+        if (not (K > 0 and S > 0 and sigma > 0)) {
+            return fail("strike, spot and volatility must be positive");
+        }
+        auto expiry = [&valuation, &tau](std::string_view text) -> std::optional<datetime> {
+            if (auto date = parse_date(text)) {
+                return date;
+            }
+            if (parse_number(text, tau) and tau >= 0) {
+                return valuation + frac_years{tau};
+            }
+            return std::nullopt;
+        }(fields[4]);
+        if (not expiry) {
+            return fail("expiry is a date or a year fraction");
+        }
+        auto const& maturity = *expiry;
 
-    executor.run(taskflow).wait();
+        mkt_params<double> mkt{S, sigma, valuation, r, q};
+        std::string_view error;
+        if (american_style) {
+            if (call) {
+                american_call instrument{K, maturity};
+                error = price_instrument(opts, mkt, instrument, true, out);
+            } else {
+                american_put instrument{K, maturity};
+                error = price_instrument(opts, mkt, instrument, true, out);
+            }
+        } else {
+            if (call) {
+                european_call instrument{K, maturity};
+                error = price_instrument(opts, mkt, instrument, false, out);
+            } else {
+                european_put instrument{K, maturity};
+                error = price_instrument(opts, mkt, instrument, false, out);
+            }
+        }
+        if (not error.empty()) {
+            return fail(error);
+        }
+        out += '\n';
+    }
+
+    //Peak resident set size of the process in bytes, 0 where unknown
+    std::size_t peak_rss() {
+#if defined(__APPLE__)
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+#elif defined(__unix__)
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#else
+        return 0;
+#endif
+    }
+
+    std::optional<options> parse_options(int argc, char* argv[]) {
+        options opts;
+        for (int i = 1; i < argc; i++) {
+            std::string_view arg = argv[i];
+            auto value = [&i, argc, argv]() -> std::string_view {
+                return i + 1 < argc ? argv[++i] : "";
+            };
+            if (arg == "--solver") {
+                auto name = value();
+                if (name == "auto") {
+                    opts.solver = solver_choice::automatic;
+                } else if (name == "analytical") {
+                    opts.solver = solver_choice::analytical;
+                } else if (name == "crr") {
+                    opts.solver = solver_choice::crr;
+                } else if (name == "qdplus") {
+                    opts.solver = solver_choice::qdplus;
+                } else {
+                    return std::nullopt;
+                }
+            } else if (arg == "--steps") {
+                if (not parse_number(value(), opts.crr_steps) or opts.crr_steps < 1) {
+                    return std::nullopt;
+                }
+            } else if (arg == "--chunk") {
+                if (not parse_number(value(), opts.chunk_rows) or opts.chunk_rows < 1) {
+                    return std::nullopt;
+                }
+            } else if (arg == "--threads") {
+                if (not parse_number(value(), opts.threads) or opts.threads < 1) {
+                    return std::nullopt;
+                }
+            } else if (arg == "--valuation") {
+                auto date = parse_date(value());
+                if (not date) {
+                    return std::nullopt;
+                }
+                opts.valuation.emplace(*date);
+            } else if (arg == "--output") {
+                opts.output = value();
+            } else if (arg.starts_with("--") or arg.empty()) {
+                return std::nullopt;
+            } else {
+                opts.input = arg;
+            }
+        }
+        return opts;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    auto parsed = parse_options(argc, argv);
+    if (not parsed) {
+        usage();
+        return 2;
+    }
+    auto const& opts = *parsed;
+    auto config = executor_configuration();
+    config.threads = opts.threads;
+    configure_executor(config);
+
+    std::ifstream input_file;
+    std::ofstream output_file;
+    if (opts.input != "-") {
+        input_file.open(opts.input);
+        if (not input_file) {
+            std::cerr << "Cannot open " << opts.input << '\n';
+            return 1;
+        }
+    }
+    if (opts.output != "-") {
+        output_file.open(opts.output);
+        if (not output_file) {
+            std::cerr << "Cannot open " << opts.output << '\n';
+            return 1;
+        }
+    }
+    std::istream& in = opts.input != "-" ? input_file : std::cin;
+    std::ostream& out = opts.output != "-" ? output_file : std::cout;
+    std::ios::sync_with_stdio(false);
+    auto valuation = opts.valuation.value_or(datetime::now());
+
+    auto start = std::chrono::steady_clock::now();
+    std::size_t rows = 0;
+    bool first_row = true;
+    out << "id,price,delta,gamma,vega,theta,error\n";
+
+    //A chunk per line of the pipeline, reused from one token to the next
+    std::vector<chunk> chunks(opts.threads + 1);
+    tf::Pipeline pipeline{chunks.size(),
+        tf::Pipe{tf::PipeType::SERIAL, [&](tf::Pipeflow& flow) {
+            auto& rows_of = chunks[flow.line()].rows;
+            rows_of.resize(opts.chunk_rows);
+            std::size_t n = 0;
+            while (n < opts.chunk_rows and std::getline(in, rows_of[n])) {
+                auto& row = rows_of[n];
+                if (not row.empty() and row.back() == '\r') {
+                    row.pop_back();
+                }
+                if (first_row and is_header(row)) {
+                    first_row = false;
+                    continue;
+                }
+                first_row = false;
+                n++;
+            }
+            rows_of.resize(n);
+            rows += n;
+            if (n == 0) {
+                flow.stop();
+            }
+        }},
+        tf::Pipe{tf::PipeType::PARALLEL, [&](tf::Pipeflow& flow) {
+            auto& c = chunks[flow.line()];
+            c.priced.clear();
+            for (auto const& row: c.rows) {
+                price_row(opts, valuation, row, c.priced);
+            }
+        }},
+        tf::Pipe{tf::PipeType::SERIAL, [&](tf::Pipeflow& flow) {
+            out << chunks[flow.line()].priced;
+        }}
+    };
+    tf::Taskflow taskflow;
+    taskflow.composed_of(pipeline);
+    run_and_wait(taskflow);
+    out.flush();
 
-    return 0;
-}
\ No newline at end of file
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::fprintf(stderr, "%zu rows in %.3f s, %.0f rows/s, peak RSS %.1f MB\n", rows, elapsed.count(),
+                 rows / elapsed.count(), peak_rss() / (1024.0 * 1024.0));
+    return out ? 0 : 1;
+}
@@ -1 +1,199 @@
 #include "random.h"
+
+#include <cassert>
+
+std::uint64_t random_seed() {
+    std::random_device device{};
+    return (static_cast<std::uint64_t>(device()) << 32) ^ device();
+}
+
+double inverse_normal_cdf(double u) {
+    static constexpr double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                                   1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+    static constexpr double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                                   6.680131188771972e+01, -1.328068155288572e+01};
+    static constexpr double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                                   -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+    static constexpr double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                                   3.754408661907416e+00};
+    static constexpr double low = 0.02425;
+    double x;
+    if (u < low or u > 1.0 - low) {
+        //Tails
+        auto q = std::sqrt(-2.0 * std::log(u < low ? u : 1.0 - u));
+        x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+            ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+        if (u > 1.0 - low) {
+            x = -x;
+        }
+    } else {
+        auto q = u - 0.5;
+        auto r = q * q;
+        x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+            (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+    }
+    //Halley step on cdf(x) - u, with the cdf of the side of the smaller tail to keep its relative accuracy
+    auto e = x < 0 ? 0.5 * std::erfc(-x / std::numbers::sqrt2) - u : (1.0 - u) - 0.5 * std::erfc(x / std::numbers::sqrt2);
+    auto w = e * std::sqrt(2.0 * std::numbers::pi) * std::exp(0.5 * x * x);
+    return x - w / (1.0 + 0.5 * x * w);
+}
+
+namespace {
+    inline std::uint32_t reverse_bits(std::uint32_t x) {
+        x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+        x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+        x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+        x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    /**
+     * Nested uniform scrambling: on the reversed bits, the Laine-Karras style hash of Burley only lets each bit
+     * depend on the bits below it, so on the point each bit is flipped by a random function of the bits above it.
+     */
+    inline std::uint32_t owen_scramble(std::uint32_t x, std::uint32_t seed) {
+        x = reverse_bits(x);
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return reverse_bits(x);
+    }
+}
+
+sobol::sobol(int dimensions, std::uint64_t seed):
+        dimensions_{dimensions}, scrambled{seed != 0}, directions(32 * dimensions), seeds(dimensions), state(dimensions) {
+    assert(("Sobol sequences have 1 to 1024 dimensions", dimensions >= 1 and dimensions <= max_dimensions));
+    //The first dimension is the van der Corput sequence
+    for (int j = 0; j < 32; j++) {
+        directions[j * dimensions] = 1u << (31 - j);
+    }
+    for (int d = 1; d < dimensions; d++) {
+        auto const& numbers = joe_kuo[d - 1];
+        std::uint32_t v[32];
+        int s = numbers.s;
+        for (int j = 0; j < std::min(s, 32); j++) {
+            v[j] = static_cast<std::uint32_t>(numbers.m[j]) << (31 - j);
+        }
+        //v_j = a_1 v_{j-1} ^ ... ^ a_{s-1} v_{j-s+1} ^ v_{j-s} ^ (v_{j-s} >> s)
+        for (int j = s; j < 32; j++) {
+            v[j] = v[j - s] ^ (v[j - s] >> s);
+            for (int k = 1; k < s; k++) {
+                if ((numbers.a >> (s - 1 - k)) & 1) {
+                    v[j] ^= v[j - k];
+                }
+            }
+        }
+        for (int j = 0; j < 32; j++) {
+            directions[j * dimensions + d] = v[j];
+        }
+    }
+    if (scrambled) {
+        philox hash{seed};
+        for (int d = 0; d < dimensions; d++) {
+            seeds[d] = hash(d)[0];
+        }
+    }
+}
+
+void sobol::point(std::uint64_t n, std::uint32_t* x) const {
+    assert(("Sobol sequences have 2^32 points", n < (1ull << 32)));
+    std::fill(x, x + dimensions_, 0u);
+    auto gray = n ^ (n >> 1);
+    for (int j = 0; gray != 0; j++, gray >>= 1) {
+        if (gray & 1) {
+            auto v = directions.data() + j * dimensions_;
+            for (int d = 0; d < dimensions_; d++) {
+                x[d] ^= v[d];
+            }
+        }
+    }
+}
+
+void sobol::uniforms(std::uint32_t const* x, double* u) const {
+    for (int d = 0; d < dimensions_; d++) {
+        auto bits = scrambled ? owen_scramble(x[d], seeds[d]) : x[d];
+        u[d] = (static_cast<double>(bits) + 0.5) * 0x1.0p-32;
+    }
+}
+
+void sobol::seek(std::uint64_t n) {
+    point(n, state.data());
+    index_ = n;
+}
+
+void sobol::next(double* u) {
+    uniforms(state.data(), u);
+    advance(index_++, state.data());
+}
+
+void sobol::next_normal(double* z) {
+    next(z);
+    std::transform(z, z + dimensions_, z, inverse_normal_cdf);
+}
+
+void sobol::points(std::uint64_t first, std::size_t count, double* u) const {
+    std::vector<std::uint32_t> x(dimensions_);
+    point(first, x.data());
+    for (std::size_t i = 0; i < count; i++) {
+        uniforms(x.data(), u + i * dimensions_);
+        advance(first + i, x.data());
+    }
+}
+
+void sobol::normals(std::uint64_t first, std::size_t count, double* z) const {
+    points(first, count, z);
+    std::transform(z, z + count * dimensions_, z, inverse_normal_cdf);
+}
+
+brownian_bridge::brownian_bridge(int steps, double tau): brownian_bridge([steps, tau]() {
+    std::vector<double> times(steps);
+    for (int i = 0; i < steps; i++) {
+        times[i] = tau * (i + 1) / steps;
+    }
+    return times;
+}()) {}
+
+brownian_bridge::brownian_bridge(std::vector<double> times_):
+        times{std::move(times_)}, bridge(times.size()), left(times.size()), right(times.size()),
+        left_weight(times.size()), right_weight(times.size()), deviation(times.size()) {
+    int n = steps();
+    assert(("A Brownian bridge needs increasing times", n >= 1 and times[0] > 0 and std::is_sorted(times.begin(), times.end())));
+    std::vector<bool> set(n, false);
+    bridge[0] = n - 1;
+    left[0] = right[0] = -1;
+    deviation[0] = std::sqrt(times[n - 1]);
+    set[n - 1] = true;
+    int j = 0;
+    for (int i = 1; i < n; i++) {
+        //Next interval (j - 1, k) whose inner points are not set, its midpoint is set next
+        while (set[j]) {
+            j++;
+        }
+        int k = j;
+        while (not set[k]) {
+            k++;
+        }
+        int l = j + (k - 1 - j) / 2;
+        set[l] = true;
+        bridge[i] = l;
+        left[i] = j - 1;
+        right[i] = k;
+        auto t_left = j > 0 ? times[j - 1] : 0.0;
+        auto length = times[k] - t_left;
+        left_weight[i] = (times[k] - times[l]) / length;
+        right_weight[i] = (times[l] - t_left) / length;
+        deviation[i] = std::sqrt((times[l] - t_left) * (times[k] - times[l]) / length);
+        j = k + 1 < n ? k + 1 : 0;
+    }
+}
+
+void brownian_bridge::operator()(double const* z, double* W) const {
+    int n = steps();
+    W[n - 1] = deviation[0] * z[0];
+    for (int i = 1; i < n; i++) {
+        auto W_left = left[i] >= 0 ? W[left[i]] : 0.0;
+        W[bridge[i]] = left_weight[i] * W_left + right_weight[i] * W[right[i]] + deviation[i] * z[i];
+    }
+}
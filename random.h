@@ -3,28 +3,318 @@
 #include <random>
 #include <ranges>
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
 #include <vector>
 
 /**
- * Random Normal Generator
+ * Philox4x32-10 counter based generator (Salmon, Moraes, Dror and Shaw, "Parallel random numbers: as easy as 1, 2,
+ * 3"). The output is a pure function of (key, counter): block i of a stream is the encryption of the counter
+ * (i, stream) under the seed, so any block of any stream is computed directly, with no state to share between threads.
+ */
+class philox {
+public:
+    using block = std::array<std::uint32_t, 4>;
+
+    inline explicit philox(std::uint64_t seed): key{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)} {}
+
+    inline block operator()(std::uint64_t index, std::uint64_t stream = 0) const {
+        return encrypt({static_cast<std::uint32_t>(index), static_cast<std::uint32_t>(index >> 32),
+                        static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32)});
+    }
+
+    inline block encrypt(block c) const {
+        std::uint32_t c0 = c[0], c1 = c[1], c2 = c[2], c3 = c[3];
+        std::uint32_t k0 = key[0], k1 = key[1];
+        for (int round = 0; round < 10; round++) {
+            std::uint64_t p0 = static_cast<std::uint64_t>(0xD2511F53u) * c0;
+            std::uint64_t p1 = static_cast<std::uint64_t>(0xCD9E8D57u) * c2;
+            c0 = static_cast<std::uint32_t>(p1 >> 32) ^ c1 ^ k0;
+            c1 = static_cast<std::uint32_t>(p1);
+            c2 = static_cast<std::uint32_t>(p0 >> 32) ^ c3 ^ k1;
+            c3 = static_cast<std::uint32_t>(p0);
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        return {c0, c1, c2, c3};
+    }
+
+private:
+    std::array<std::uint32_t, 2> key;
+};
+
+//Seed drawn from std::random_device, for the generators that don't need to be reproducible
+std::uint64_t random_seed();
+
+/**
+ * Random Normal Generator on a Philox stream. Normal n of the stream is the cosine (n even) or sine (n odd) half of
+ * the Box-Muller transform of the Philox block n/2, whose two 64 bit words are the uniforms. So the stream is
+ * reproducible from (seed, stream), independent of the other streams (eg one per thread or per path), and it can
+ * skip ahead for free; scalar draws, vectors and bulk fills give the same numbers.
+ * Bulk fills run in chunks: the Philox rounds of a chunk, then the Box-Muller transform of the chunk, two plain loops
+ * over arrays that the compiler can vectorize (the transform uses its own log and sincos, std::log and std::sin are
+ * calls).
  * @tparam T
  */
 template<typename T>
 class random_normal {
 private:
-    std::random_device device{};
-    std::mt19937 generator{device()};
-    std::normal_distribution<T> normal;
+    philox generator;
+    std::uint64_t seed_;
+    std::uint64_t stream_;
+    std::uint64_t position = 0;
+    //Box-Muller pair of the last block drawn one normal at a time
+    std::uint64_t cached_block = UINT64_MAX;
+    T cached[2];
+
+    static constexpr std::size_t chunk = 256;
+
+    /**
+     * Uniform in (0, 1) from 52 bits of two words, never 0 so its log is finite. The conversions go through the bits
+     * of doubles in [1, 2) or [2^52, 2^53): unlike integer to double casts they vectorize without AVX-512.
+     */
+    static inline double uniform(std::uint32_t hi, std::uint32_t lo) {
+        auto bits = (static_cast<std::uint64_t>(hi) << 20) ^ (lo >> 12);
+        return std::bit_cast<double>(0x3FF0000000000000ull | bits) - (1.0 - 0x1.0p-53);
+    }
+
+    /**
+     * log(u) for u in (0, 1), without branches nor calls so that loops over it vectorize. With u = m 2^e and m in
+     * [sqrt(1/2), sqrt(2)), log(m) = 2 atanh(s) with s = (m - 1)/(m + 1), |s| < 0.172, summed to s^19.
+     */
+    static inline double log_unit(double u) {
+        auto bits = std::bit_cast<std::uint64_t>(u);
+        auto mantissa = bits & 0x000FFFFFFFFFFFFFull;
+        //1 when the mantissa is above the one of sqrt(2), then m is taken in [sqrt(1/2), 1)
+        auto high = (0x6A09E667F3BCCull - mantissa) >> 63;
+        auto e = std::bit_cast<double>(0x4330000000000000ull | ((bits >> 52) + high)) - (0x1.0p52 + 1023);
+        auto m = std::bit_cast<double>(mantissa | ((0x3FFull - high) << 52));
+        auto s = (m - 1.0) / (m + 1.0);
+        auto s2 = s * s;
+        auto series = 1.0 + s2 * (1.0/3 + s2 * (1.0/5 + s2 * (1.0/7 + s2 * (1.0/9 + s2 * (1.0/11 + s2 * (1.0/13
+                + s2 * (1.0/15 + s2 * (1.0/17 + s2 * (1.0/19)))))))));
+        return e * std::numbers::ln2 + 2.0 * s * series;
+    }
+
+    /**
+     * cos(2 pi u) and sin(2 pi u) for u in [0, 1), branch free as log_unit. The angle is reduced to r in
+     * [-pi/4, pi/4] around the nearest quarter turn, where the Taylor series to r^16 are exact to double precision.
+     */
+    static inline void sincos_turn(double u, double& c, double& s) {
+        auto x = 4.0 * u;
+        //Rounds x to the nearest integer, which lands in the low bits of the mantissa
+        auto shifted = x + 0x1.8p52;
+        auto quarter = std::bit_cast<std::uint64_t>(shifted);
+        auto r = (x - (shifted - 0x1.8p52)) * (std::numbers::pi / 2);
+        auto r2 = r * r;
+        //Taylor coefficients (-1)^n/(2n+1)! and (-1)^n/(2n)!
+        auto sin_r = r * (1.0 + r2 * (-1.0/6 + r2 * (1.0/120 + r2 * (-1.0/5040 + r2 * (1.0/362880 + r2 * (-1.0/39916800
+                + r2 * (1.0/6227020800 + r2 * (-1.0/1307674368000 + r2 * (1.0/355687428096000)))))))));
+        auto cos_r = 1.0 + r2 * (-1.0/2 + r2 * (1.0/24 + r2 * (-1.0/720 + r2 * (1.0/40320 + r2 * (-1.0/3628800
+                + r2 * (1.0/479001600 + r2 * (-1.0/87178291200 + r2 * (1.0/20922789888000))))))));
+        //Odd quarters swap sin and cos, quarters 1 and 2 flip the sign of cos, 2 and 3 the one of sin
+        auto swap = 0 - (quarter & 1);
+        auto sin_bits = std::bit_cast<std::uint64_t>(sin_r);
+        auto cos_bits = std::bit_cast<std::uint64_t>(cos_r);
+        c = std::bit_cast<double>(((sin_bits & swap) | (cos_bits & ~swap)) ^ (((quarter + 1) & 2) << 62));
+        s = std::bit_cast<double>(((cos_bits & swap) | (sin_bits & ~swap)) ^ ((quarter & 2) << 62));
+    }
+
+    /**
+     * sqrt(x) for x > 0 as x/sqrt(x), the inverse square root refined by Newton's method from the bit level guess.
+     * std::sqrt would do but for the errno branch (without -fno-math-errno) that stops the loop from vectorizing.
+     */
+    static inline double sqrt_positive(double x) {
+        auto y = std::bit_cast<double>(0x5FE6EB50C7B537A9ull - (std::bit_cast<std::uint64_t>(x) >> 1));
+        for (int i = 0; i < 4; i++) {
+            y *= 1.5 - 0.5 * x * y * y;
+        }
+        return x * y;
+    }
+
+    static inline void box_muller(double u1, double u2, T* z) {
+        double c, s;
+        sincos_turn(u2, c, s);
+        auto radius = sqrt_positive(-2.0 * log_unit(u1));
+        z[0] = static_cast<T>(radius * c);
+        z[1] = static_cast<T>(radius * s);
+    }
+
+    inline void pair(std::uint64_t index, T* z) const {
+        auto b = generator(index, stream_);
+        box_muller(uniform(b[0], b[1]), uniform(b[2], b[3]), z);
+    }
+
+    //Fills z with the pairs of the blocks [first, first + count), count <= chunk
+    inline void pairs(std::uint64_t first, std::size_t count, T* z) const {
+        double u1[chunk];
+        double u2[chunk];
+        for (std::size_t i = 0; i < count; i++) {
+            auto b = generator(first + i, stream_);
+            u1[i] = uniform(b[0], b[1]);
+            u2[i] = uniform(b[2], b[3]);
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            box_muller(u1[i], u2[i], z + 2 * i);
+        }
+    }
+
 public:
-    inline random_normal() = default;
+    inline random_normal(): random_normal(random_seed()) {}
+    inline explicit random_normal(std::uint64_t seed, std::uint64_t stream = 0): generator{seed}, seed_{seed}, stream_{stream} {}
+
     inline T operator()() {
-        return normal(generator);
+        auto index = position / 2;
+        if (index != cached_block) {
+            pair(index, cached);
+            cached_block = index;
+        }
+        return cached[position++ % 2];
     }
+
     std::vector<T> operator()(int n) {
         std::vector<T> z(n);
-        std::ranges::generate(z, [this] () { return this->operator()(); } );
+        fill(z.data(), z.size());
         return z;
     }
+
+    //Writes the next n normals of the stream to z
+    void fill(T* z, std::size_t n) {
+        if (n > 0 and position % 2 == 1) {
+            *z++ = (*this)();
+            n--;
+        }
+        while (n >= 2) {
+            auto count = std::min(n / 2, chunk);
+            pairs(position / 2, count, z);
+            position += 2 * count;
+            z += 2 * count;
+            n -= 2 * count;
+        }
+        if (n == 1) {
+            *z = (*this)();
+        }
+    }
+
+    //Another stream of the same seed, eg one per thread or per path
+    inline random_normal stream(std::uint64_t stream) const {
+        return random_normal{seed_, stream};
+    }
+
+    //Skips the next n normals
+    inline void discard(std::uint64_t n) {
+        position += n;
+    }
+
+    inline std::uint64_t seed() const {
+        return seed_;
+    }
+};
+
+//Inverse of the standard normal cumulative distribution, for u in (0, 1): Acklam's rational approximation refined
+//by one Halley step, accurate to about 1e-15
+double inverse_normal_cdf(double u);
+
+/**
+ * Sobol low discrepancy sequence in up to 1024 dimensions, with the direction numbers of Joe and Kuo.
+ * The points come in Gray code order (Antonov and Saleev): point n is the xor of the direction numbers of the bits of
+ * n ^ (n >> 1). Any point, so any block of points, is computed directly: the sequence skips ahead for free and
+ * threads fill disjoint blocks of the same sequence with points(), which leaves the generator untouched.
+ * With a non zero seed the points are Owen scrambled (nested uniform scrambling, with the hash of Burley, "Practical
+ * hash-based Owen scrambling", 2020): they keep the stratification of the sequence and the estimates become unbiased,
+ * their error being measured across seeds.
+ * Uniforms are the centers of the 2^-32 cells of the points, so they are never 0 or 1 and their normals are finite.
+ */
+class sobol {
+public:
+    static constexpr int max_dimensions = 1024;
+
+    //Degree s, coefficients a of the primitive polynomial and initial direction numbers m_1..m_s of a dimension
+    struct direction_numbers {
+        std::uint16_t s;
+        std::uint16_t a;
+        std::uint16_t m[13];
+    };
+    static const direction_numbers joe_kuo[max_dimensions - 1];
+
+    explicit sobol(int dimensions, std::uint64_t seed = 0);
+
+    inline int dimensions() const {
+        return dimensions_;
+    }
+
+    //Index of the next point
+    inline std::uint64_t index() const {
+        return index_;
+    }
+
+    //Moves to point n
+    void seek(std::uint64_t n);
+
+    //Next point, as uniforms in (0, 1)
+    void next(double* u);
+
+    //Next point, as standard normals
+    void next_normal(double* z);
+
+    //Points [first, first + count), one after the other, as uniforms in (0, 1)
+    void points(std::uint64_t first, std::size_t count, double* u) const;
+
+    //Points [first, first + count), one after the other, as standard normals
+    void normals(std::uint64_t first, std::size_t count, double* z) const;
+
+private:
+    int dimensions_;
+    bool scrambled;
+    //Direction numbers, bit by bit: direction number j of dimension d at j * dimensions + d
+    std::vector<std::uint32_t> directions;
+    //Scrambling seed of each dimension
+    std::vector<std::uint32_t> seeds;
+    //Unscrambled point at index_
+    std::vector<std::uint32_t> state;
+    std::uint64_t index_ = 0;
+
+    //Unscrambled point n
+    void point(std::uint64_t n, std::uint32_t* x) const;
+    //Moves the unscrambled point x from n to n + 1
+    inline void advance(std::uint64_t n, std::uint32_t* x) const {
+        //The Gray code of n + 1 flips the lowest zero bit of n
+        auto v = directions.data() + dimensions_ * std::countr_one(n);
+        for (int d = 0; d < dimensions_; d++) {
+            x[d] ^= v[d];
+        }
+    }
+    void uniforms(std::uint32_t const* x, double* u) const;
+};
+
+/**
+ * Brownian bridge construction of a Brownian motion at the times t_1 < ... < t_n. The first normal sets W(t_n),
+ * the next ones the midpoints of the intervals, halving them. Most of the variance of the path is set by the first
+ * normals, the dimensions where Sobol points are the most uniform, which cuts the effective dimension of path
+ * dependent payoffs.
+ */
+class brownian_bridge {
+public:
+    explicit brownian_bridge(std::vector<double> times);
+    //Equally spaced times tau/steps, ..., tau
+    brownian_bridge(int steps, double tau);
+
+    inline int steps() const {
+        return static_cast<int>(times.size());
+    }
+
+    //W(t_1), ..., W(t_n) from n standard normals
+    void operator()(double const* z, double* W) const;
+
+private:
+    std::vector<double> times;
+    //Point set by each normal, the points of its interval (left is -1 for the origin) and its weights
+    std::vector<int> bridge, left, right;
+    std::vector<double> left_weight, right_weight, deviation;
 };
 
 #endif //BLACKSCHOLES_RANDOM_H
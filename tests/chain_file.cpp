@@ -0,0 +1,100 @@
+#include <catch2/catch.hpp>
+
+#include "../bsm/bsm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+using namespace bsm;
+using namespace std::chrono;
+using namespace bsm::chrono;
+
+TEST_CASE("Chain files map the universe written to them") {
+    auto t = datetime::now();
+    std::vector<market_snapshot> markets{{100.0, 0.25, 0.05, 0.02}, {50.0, 0.4, 0.05, 0.0}};
+    std::vector<instrument_table> chains{instrument_table{t}, instrument_table{t}};
+    for (auto tau: {0.25, 0.5, 1.0}) {
+        for (auto K = 80.0; K <= 120.0; K += 10.0) {
+            chains[0].add(K, t + frac_years{tau}, instrument_type::call, american_exercise);
+            chains[0].add(K, t + frac_years{tau}, instrument_type::put, american_exercise);
+        }
+    }
+    //Expiries of the second underlying partly shared with the first one
+    for (auto tau: {2.0, 0.5}) {
+        for (auto K = 40.0; K <= 60.0; K += 5.0) {
+            chains[1].add(K, t + frac_years{tau}, instrument_type::put, european_exercise);
+        }
+    }
+    chain_file::write("option_chains.bin", markets, chains);
+
+    auto file = chain_file::open("option_chains.bin");
+    CHECK(file.validate().empty());
+    CHECK(file.valuation().instant == t.instant);
+    REQUIRE(file.underlyings() == 2);
+    CHECK(file.size() == chains[0].size() + chains[1].size());
+    CHECK(file.expiry_instants().size() == 4);
+    CHECK(file.market(1).S == 50.0);
+    CHECK(file.market_params(0).sigma == 0.25);
+    for (std::size_t u = 0; u < 2; u++) {
+        auto columns = file.columns(u);
+        REQUIRE(columns.size() == chains[u].size());
+        for (std::size_t i = 0; i < columns.size(); i++) {
+            CHECK(columns.strike(i) == chains[u].strike(i));
+            CHECK(columns.tau(i) == chains[u].tau(i));
+            CHECK(columns.type(i) == chains[u].type(i));
+            CHECK(columns.style(i) == chains[u].style(i));
+        }
+    }
+
+    //The batch solvers price the mapped columns in place
+    auto const& m = file.market(0);
+    qdplus_solver qdplus{mkt_params<long double>{m.S, m.sigma, t, m.r, m.q}};
+    CHECK(qdplus(file.columns(0)) == qdplus(chains[0]));
+    analytical_solver analytical{file.market_params(1)};
+    CHECK(analytical(file.columns(1)) == analytical(chains[1]));
+}
+
+TEST_CASE("Chain files reject or report invalid contents") {
+    auto t = datetime::now();
+    instrument_table chain{t};
+    chain.add(100.0, t + 0.5_years, instrument_type::call, european_exercise);
+    chain.add(110.0, t + 1.0_years, instrument_type::put, european_exercise);
+    chain_file::write("invalid_chain.bin", {{100.0, 0.2, 0.05, 0.0}}, {chain});
+
+    std::vector<char> bytes;
+    {
+        std::ifstream in{"invalid_chain.bin", std::ios::binary};
+        bytes.assign(std::istreambuf_iterator<char>{in}, {});
+    }
+    auto rewrite = [](std::vector<char> const& contents) {
+        std::ofstream out{"invalid_chain.bin", std::ios::binary | std::ios::trunc};
+        out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    };
+
+    //Not a chain file, or truncated
+    auto corrupted = bytes;
+    corrupted[0] = 'X';
+    rewrite(corrupted);
+    CHECK_THROWS_AS(chain_file::open("invalid_chain.bin"), std::runtime_error);
+    rewrite({bytes.begin(), bytes.begin() + bytes.size() / 2});
+    CHECK_THROWS_AS(chain_file::open("invalid_chain.bin"), std::runtime_error);
+    CHECK_THROWS_AS(chain_file::open("missing_chain.bin"), std::runtime_error);
+
+    //Values are only checked by validate: a negative strike and an expiry index out of range
+    double strikes[] = {100.0, 110.0};
+    auto at = std::search(bytes.begin(), bytes.end(), reinterpret_cast<char const*>(strikes), reinterpret_cast<char const*>(strikes + 2)) - bytes.begin();
+    corrupted = bytes;
+    double negative = -110.0;
+    std::int32_t index = 7;
+    std::memcpy(corrupted.data() + at + sizeof(double), &negative, sizeof(double));
+    //The expiry column starts on the next 64 byte boundary
+    std::memcpy(corrupted.data() + at + 64, &index, sizeof(index));
+    rewrite(corrupted);
+    auto problems = chain_file::open("invalid_chain.bin").validate();
+    REQUIRE(problems.size() == 2);
+    CHECK(problems[0] == "Expiry index out of range at contract 0");
+    CHECK(problems[1] == "Invalid strike at contract 1");
+}
@@ -30,3 +30,45 @@ TEST_CASE("Chrono Double literals") {
     CHECK(time.count()==Approx(0.5));
 }
 
+
+TEST_CASE("Business day calendar") {
+    //2023 with the NYSE holidays
+    std::vector<year_month_day> holidays{2d / January / 2023, 16d / January / 2023, 20d / February / 2023, 7d / April / 2023,
+                                         29d / May / 2023, 19d / June / 2023, 4d / July / 2023, 4d / September / 2023,
+                                         23d / November / 2023, 25d / December / 2023};
+    calendar nyse{1d / January / 2023, 31d / December / 2024, holidays};
+
+    CHECK(nyse.is_business_day(3d / January / 2023));
+    CHECK(not nyse.is_business_day(2d / January / 2023));
+    CHECK(not nyse.is_business_day(7d / January / 2023));
+    CHECK(nyse.business_days_between(1d / January / 2023, 1d / January / 2024) == 250);
+    CHECK(nyse.business_days_between(3d / January / 2023, 10d / January / 2023) == 5);
+    CHECK(nyse.business_days_between(3d / January / 2023, 3d / January / 2023) == 0);
+
+    //Business/252, the elapsed part of a day counts as the day
+    datetime friday{6d / January / 2023, 12h + 0min};
+    datetime monday{9d / January / 2023, 12h + 0min};
+    CHECK(nyse.year_fraction(friday, monday) == Approx(1.0 / 252));
+    CHECK(nyse.year_fraction(datetime{1d / January / 2023}, datetime{1d / January / 2024}) == Approx(250.0 / 252));
+
+    //Vol clock where weekends and holidays carry a tenth of a business day
+    calendar clock{1d / January / 2023, 31d / December / 2024, holidays, 0.1, 250.0 + 0.1 * 115};
+    CHECK(clock.year_fraction(friday, monday) == Approx(1.2 / (250.0 + 11.5)));
+    CHECK(clock.year_fraction(datetime{1d / January / 2023}, datetime{1d / January / 2024}) == Approx(1.0));
+
+    auto taus = nyse.year_fractions(friday, {monday, datetime{13d / January / 2023, 12h + 0min}});
+    CHECK(taus[0] == Approx(1.0 / 252));
+    CHECK(taus[1] == Approx(5.0 / 252));
+}
+
+TEST_CASE("Expiry table shares the year fractions of an expiry") {
+    datetime t{3d / January / 2023};
+    expiry_table expiries{t};
+    std::vector<datetime> maturities{datetime{17d / February / 2023}, datetime{17d / March / 2023}, datetime{17d / February / 2023}};
+    auto indices = expiries.indices(maturities);
+    CHECK(indices == std::vector<int>{0, 1, 0});
+    CHECK(expiries.size() == 2);
+    CHECK(expiries.tau(1) == Approx(time_between(t, maturities[1]).count()));
+    CHECK(expiries.tau(maturities[0]) == year_fractions(t, maturities)[2]);
+    CHECK(expiries.size() == 2);
+}
@@ -0,0 +1,55 @@
+#include <catch2/catch.hpp>
+
+#include "../bsm/bsm.h"
+#include "../bsm/executor.h"
+
+#include <atomic>
+#include <vector>
+
+using namespace bsm;
+
+TEST_CASE("Shared executor is created once") {
+    auto& executor = shared_executor();
+    CHECK(&executor == &shared_executor());
+    CHECK(executor.num_workers() == executor_configuration().threads);
+
+    //Once started the configuration can't change anymore
+    executor_config config;
+    config.threads = executor.num_workers() + 1;
+    CHECK_FALSE(configure_executor(config));
+    CHECK(shared_executor().num_workers() == executor.num_workers());
+}
+
+TEST_CASE("Parallel for visits every index once") {
+    std::vector<int> visits(10000, 0);
+    parallel_for(0, 10000, [&visits](int i) {
+        visits[i]++;
+    });
+    CHECK(std::all_of(visits.begin(), visits.end(), [](int v) { return v == 1; }));
+}
+
+TEST_CASE("Nested parallel loops run on the shared executor") {
+    std::atomic<int> count{0};
+    tf::Taskflow taskflow;
+    taskflow.for_each_index(0, 8, 1, [&count](int) {
+        parallel_for(0, 1000, [&count](int) {
+            count++;
+        });
+    });
+    run_and_wait(taskflow);
+    CHECK(count == 8000);
+}
+
+TEST_CASE("Taskflows run from a worker are corun on the shared executor") {
+    std::atomic<int> count{0};
+    tf::Taskflow outer;
+    outer.for_each_index(0, 4, 1, [&count](int) {
+        tf::Taskflow inner;
+        inner.for_each_index(0, 100, 1, [&count](int) {
+            count++;
+        });
+        run_and_wait(inner);
+    });
+    run_and_wait(outer);
+    CHECK(count == 400);
+}
@@ -0,0 +1,205 @@
+#include <catch2/catch.hpp>
+
+#include "../bsm/bsm.h"
+#include "../bsm/solver_qdplus_internals.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <tuple>
+#include <vector>
+
+using namespace bsm;
+using namespace std::chrono;
+using namespace bsm::chrono;
+
+TEST_CASE("Instrument table stores a chain by columns") {
+    auto t = datetime::now();
+    instrument_table table{t};
+    european_call call{100.0, t + 0.5_years};
+    american_put put{90.0, t + 1.0_years};
+    CHECK(table.add(call) == 0);
+    CHECK(table.add(put) == 1);
+    CHECK(table.add(110.0, t + 0.5_years, instrument_type::put, american_exercise) == 2);
+
+    CHECK(table.size() == 3);
+    CHECK(table.strike(1) == 90.0);
+    CHECK(table.type(0) == instrument_type::call);
+    CHECK(table.style(0) == european_exercise);
+    CHECK(table.style(1) == american_exercise);
+    //Expiries are shared
+    CHECK(table.expiry(0) == table.expiry(2));
+    CHECK(table.expiry_index().size() == 2);
+    CHECK(table.tau(0) == Approx(0.5));
+    CHECK(table.tau(1) == Approx(1.0));
+    CHECK(instrument_table::bytes_per_contract == 14);
+}
+
+TEST_CASE("Batch solvers price an instrument table") {
+    auto S = 100.0;
+    auto sigma = 0.25;
+    auto r = 0.05;
+    auto q = 0.02;
+    auto t = datetime::now();
+    mkt_params mktParams{S, sigma, t, r, q};
+
+    instrument_table europeans{t}, americans{t};
+    for (auto tau: {0.25, 0.5, 1.0}) {
+        for (auto K = 80.0; K <= 120.0; K += 5.0) {
+            europeans.add(K, t + frac_years{tau}, instrument_type::call, european_exercise);
+            europeans.add(K, t + frac_years{tau}, instrument_type::put, european_exercise);
+            americans.add(K, t + frac_years{tau}, instrument_type::call, american_exercise);
+            americans.add(K, t + frac_years{tau}, instrument_type::put, american_exercise);
+        }
+    }
+    europeans.add(100.0, t + 0.5_years, instrument_type::forward, european_exercise);
+
+    analytical_solver analytical{mktParams};
+    auto prices = analytical(europeans);
+    REQUIRE(prices.size() == europeans.size());
+    for (std::size_t i = 0; i < europeans.size(); i++) {
+        auto K = europeans.strike(i);
+        datetime maturity = t + frac_years{europeans.tau(i)};
+        if (europeans.type(i) == instrument_type::call) {
+            european_call call{K, maturity};
+            CHECK(prices[i] == Approx(analytical(call)->price()).epsilon(1e-9));
+        } else if (europeans.type(i) == instrument_type::put) {
+            european_put put{K, maturity};
+            CHECK(prices[i] == Approx(analytical(put)->price()).epsilon(1e-9));
+        } else {
+            european_forward forward{K, maturity};
+            CHECK(prices[i] == Approx(analytical(forward)->price()).epsilon(1e-9));
+        }
+    }
+
+    qdplus_solver qdplus{mkt_params<long double>{S, sigma, t, r, q}};
+    auto american_prices = qdplus(americans);
+    REQUIRE(american_prices.size() == americans.size());
+    for (std::size_t i = 0; i < americans.size(); i++) {
+        auto K = americans.strike(i);
+        datetime maturity = t + frac_years{americans.tau(i)};
+        if (americans.type(i) == instrument_type::call) {
+            american_call call{K, maturity};
+            CHECK(american_prices[i] == Approx(qdplus(call)->price()).epsilon(1e-6));
+        } else {
+            american_put put{K, maturity};
+            CHECK(american_prices[i] == Approx(qdplus(put)->price()).epsilon(1e-6));
+        }
+    }
+}
+
+TEST_CASE("Batch solvers price the rows of their style and return NaN for the others") {
+    auto S = 100.0;
+    auto sigma = 0.25;
+    auto r = 0.05;
+    auto q = 0.02;
+    auto t = datetime::now();
+    mkt_params mktParams{S, sigma, t, r, q};
+
+    instrument_table chain{t};
+    for (auto K: {90.0, 100.0, 110.0}) {
+        chain.add(K, t + 0.5_years, instrument_type::call, european_exercise);
+        chain.add(K, t + 0.5_years, instrument_type::put, american_exercise);
+        chain.add(K, t + 0.5_years, instrument_type::forward, european_exercise);
+        chain.add(K, t + 0.5_years, instrument_type::call, american_exercise);
+        chain.add(K, t + 0.5_years, instrument_type::put, european_exercise);
+    }
+
+    analytical_solver analytical{mktParams};
+    qdplus_solver qdplus{mkt_params<long double>{S, sigma, t, r, q}};
+    auto european_prices = analytical(chain);
+    auto american_prices = qdplus(chain);
+    REQUIRE(european_prices.size() == chain.size());
+    REQUIRE(american_prices.size() == chain.size());
+    for (std::size_t i = 0; i < chain.size(); i++) {
+        auto K = chain.strike(i);
+        datetime maturity = t + 0.5_years;
+        if (chain.style(i) == american_exercise) {
+            CHECK(std::isnan(european_prices[i]));
+            if (chain.type(i) == instrument_type::call) {
+                american_call call{K, maturity};
+                CHECK(american_prices[i] == Approx(qdplus(call)->price()).epsilon(1e-6));
+            } else {
+                american_put put{K, maturity};
+                CHECK(american_prices[i] == Approx(qdplus(put)->price()).epsilon(1e-6));
+            }
+        } else {
+            CHECK(std::isnan(american_prices[i]));
+            CHECK(not std::isnan(european_prices[i]));
+        }
+    }
+}
+
+TEST_CASE("Market contexts share the market of an expiry across the batch solvers") {
+    auto S = 100.0;
+    auto sigma = 0.3;
+    auto r = 0.04;
+    auto q = 0.06;
+    auto t = datetime::now();
+    mkt_params mktParams{S, sigma, t, r, q};
+
+    instrument_table chain{t}, europeans{t}, americans{t};
+    for (auto tau: {0.1, 0.5, 1.5}) {
+        for (auto K = 80.0; K <= 120.0; K += 10.0) {
+            chain.add(K, t + frac_years{tau}, instrument_type::call, european_exercise);
+            chain.add(K, t + frac_years{tau}, instrument_type::put, american_exercise);
+            chain.add(K, t + frac_years{tau}, instrument_type::call, american_exercise);
+            europeans.add(K, t + frac_years{tau}, instrument_type::call, european_exercise);
+            americans.add(K, t + frac_years{tau}, instrument_type::put, american_exercise);
+            americans.add(K, t + frac_years{tau}, instrument_type::call, american_exercise);
+        }
+    }
+    market_context context{mktParams, chain.columns().taus};
+    REQUIRE(context.size() == 3);
+    auto const& year = context[2];
+    CHECK(year.tau == Approx(1.5));
+    CHECK(year.df_r == Approx(std::exp(-r * 1.5)));
+    CHECK(year.forward == Approx(S * std::exp((r - q) * 1.5)));
+    CHECK(year.v == Approx(sigma * std::sqrt(1.5)));
+
+    //CRR on the shared lattices matches the tree of each contract, with and without the control variate or extra
+    //steps, and the truncated tree prices each contract on its own
+    for (auto [extra_steps, std_devs, control_variate]: {std::tuple{0, 0.0, false}, std::tuple{0, 0.0, true},
+                                                         std::tuple{4, 0.0, false}, std::tuple{4, 0.0, true},
+                                                         std::tuple{0, 4.0, false}}) {
+        crr_solver crr{mktParams, 200, extra_steps, std_devs, control_variate};
+        auto prices = crr(chain, context);
+        REQUIRE(prices.size() == chain.size());
+        for (std::size_t i = 0; i < chain.size(); i++) {
+            datetime maturity = t + frac_years{chain.tau(i)};
+            auto K = chain.strike(i);
+            double expected;
+            if (chain.style(i) == european_exercise) {
+                european_call call{K, maturity};
+                expected = crr(call)->price();
+            } else if (chain.type(i) == instrument_type::call) {
+                american_call call{K, maturity};
+                expected = crr(call)->price();
+            } else {
+                american_put put{K, maturity};
+                expected = crr(put)->price();
+            }
+            CHECK(prices[i] == Approx(expected).epsilon(1e-10));
+        }
+    }
+
+    //The context of a chain serves every chain with the same expiries
+    REQUIRE(std::ranges::equal(europeans.columns().taus, chain.columns().taus));
+    REQUIRE(std::ranges::equal(americans.columns().taus, chain.columns().taus));
+    analytical_solver analytical{mktParams};
+    auto european_prices = analytical(europeans, context);
+    for (std::size_t i = 0; i < europeans.size(); i++) {
+        european_call call{europeans.strike(i), t + frac_years{europeans.tau(i)}};
+        CHECK(european_prices[i] == Approx(analytical(call)->price()).epsilon(1e-12));
+    }
+    qdplus_solver qdplus{mkt_params<long double>{S, sigma, t, r, q}};
+    auto american_prices = qdplus(americans, context);
+    std::vector<internals::qdplus_batch_solver::option> options;
+    for (std::size_t i = 0; i < americans.size(); i++) {
+        options.push_back({S, americans.strike(i), sigma, americans.tau(i), r, q, americans.type(i) == instrument_type::call});
+    }
+    auto results = internals::qdplus_batch_solver{}(options);
+    for (std::size_t i = 0; i < americans.size(); i++) {
+        CHECK(american_prices[i] == Approx(results[i].price).epsilon(1e-12));
+    }
+}
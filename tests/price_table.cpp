@@ -0,0 +1,113 @@
+#include <catch2/catch.hpp>
+
+#include "../bsm/bsm.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace bsm;
+using namespace std::chrono;
+using namespace bsm::chrono;
+
+TEST_CASE("American price table interpolates the Spectral Collocation (ALO) solver") {
+    //ln(S/K)/(sigma sqrt(tau)), sqrt(tau), sigma, r, q
+    price_table_domain domain{{-4.0, 0.1, 0.1, 0.03, 0.0}, {4.0, 1.0, 0.5, 0.07, 0.025}, {16, 12, 8, 8, 8}};
+    auto table = american_price_table::build(instrument_type::put, domain);
+    CHECK(table.size() == 16 * 12 * 8 * 8 * 8);
+    CHECK(table.error().samples == 256);
+    CHECK(table.error().price < 5e-5);
+    CHECK(table.error().delta < 3e-3);
+
+    auto K = 100.0;
+    auto S = 95.0;
+    auto sigma = 0.25;
+    auto t = system_clock::now();
+    auto r = 0.05;
+    auto q = 0.02;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 0.5_years};
+    fastamerican_solver solve{mktParams, 16, 3, 8};
+    auto pricing = solve(americanPut);
+    double tau = time_between(t, americanPut.maturity).count();
+
+    REQUIRE(table.contains(S, K, tau, sigma, r, q));
+    auto greeks = table.greeks(S, K, tau, sigma, r, q);
+    CHECK(table.price(S, K, tau, sigma, r, q) == greeks.price);
+    CHECK(greeks.price == Approx(pricing->price()).margin(0.01));
+    CHECK(greeks.delta == Approx(pricing->delta()).margin(0.001));
+    CHECK(greeks.gamma == Approx(pricing->gamma()).margin(0.0005));
+    CHECK(greeks.theta == Approx(pricing->theta()).margin(0.02));
+    CHECK(greeks.vega == Approx(pricing->vega()).margin(0.05));
+    CHECK(greeks.rho == Approx(pricing->rho()).margin(0.05));
+    CHECK(greeks.psi == Approx(pricing->psi()).margin(0.05));
+
+    //Outside the domain the table falls back to the solver
+    mkt_params farParams{S, 0.8, t, r, q};
+    fastamerican_solver solve_far{farParams, 16, 3, 8};
+    CHECK_FALSE(table.contains(S, K, tau, 0.8, r, q));
+    CHECK(table.price(S, K, tau, 0.8, r, q) == Approx(solve_far(americanPut)->price()).epsilon(1e-12));
+    CHECK(table.greeks(S, K, tau, 0.8, r, q).vega == Approx(solve_far(americanPut)->vega()).epsilon(1e-4));
+}
+
+TEST_CASE("American price tables are saved and memory mapped") {
+    //A table for a single trading day: the rates are fixed
+    price_table_domain domain{{-4.0, 0.1, 0.15, 0.03, 0.05}, {4.0, 1.0, 0.45, 0.03, 0.05}, {20, 10, 6, 1, 1}};
+    auto table = american_price_table::build(instrument_type::call, domain);
+    CHECK(table.error().price < 1e-4);
+
+    auto path = (std::filesystem::temp_directory_path() / "american_call_table.bin").string();
+    table.save(path);
+    auto mapped = american_price_table::open(path);
+    CHECK(mapped.type() == instrument_type::call);
+    CHECK(mapped.size() == table.size());
+    CHECK(mapped.domain().nodes == domain.nodes);
+    CHECK(mapped.error().price == table.error().price);
+    for (auto S: {80.0, 100.0, 125.0}) {
+        CHECK(mapped.price(S, 100.0, 0.5, 0.3, 0.03, 0.05) == table.price(S, 100.0, 0.5, 0.3, 0.03, 0.05));
+    }
+
+    //The call matches the solver, and a point with other rates is out of the domain
+    auto t = system_clock::now();
+    mkt_params mktParams{110.0, 0.3, t, 0.03, 0.05};
+    american_call americanCall{100.0, t + 0.75_years};
+    fastamerican_solver solve{mktParams, 16, 3, 8};
+    auto pricing = solve(americanCall);
+    double tau = time_between(t, americanCall.maturity).count();
+    CHECK(mapped.price(110.0, 100.0, tau, 0.3, 0.03, 0.05) == Approx(pricing->price()).margin(0.05));
+    CHECK(mapped.greeks(110.0, 100.0, tau, 0.3, 0.03, 0.05).delta == Approx(pricing->delta()).margin(0.002));
+    CHECK_FALSE(mapped.contains(110.0, 100.0, tau, 0.3, 0.04, 0.05));
+
+    //Headers that disagree with the file are rejected: another type, nodes that don't make the count, a short file
+    std::vector<char> bytes;
+    {
+        std::ifstream in{path, std::ios::binary};
+        bytes.assign(std::istreambuf_iterator<char>{in}, {});
+    }
+    auto corrupted = (std::filesystem::temp_directory_path() / "american_call_table_corrupted.bin").string();
+    auto check_rejected = [&corrupted](std::vector<char> const& content) {
+        {
+            std::ofstream out{corrupted, std::ios::binary | std::ios::trunc};
+            out.write(content.data(), static_cast<std::streamsize>(content.size()));
+        }
+        CHECK_THROWS_AS(american_price_table::open(corrupted), std::runtime_error);
+    };
+    //the type follows the magic and the version, the nodes the lower and upper corners of the domain
+    auto with = [&bytes](std::size_t offset, std::int32_t value) {
+        auto content = bytes;
+        std::memcpy(content.data() + offset, &value, sizeof(value));
+        return content;
+    };
+    check_rejected(with(12, instrument_type::forward));
+    check_rejected(with(96, 21));
+    check_rejected(std::vector<char>(bytes.begin(), bytes.end() - sizeof(double)));
+    std::remove(corrupted.c_str());
+    std::remove(path.c_str());
+}
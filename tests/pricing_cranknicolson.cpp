@@ -0,0 +1,150 @@
+#include <catch2/catch.hpp>
+
+#include "../bsm/bsm.h"
+
+#include <chrono>
+
+using namespace bsm;
+using namespace std::chrono;
+using namespace bsm::chrono;
+
+TEST_CASE("European Pricing using Crank-Nicolson Finite Differences") {
+    auto K = 105.0;
+    auto S = 100.0;
+    auto sigma = 0.25;
+    auto t = system_clock::now();
+    auto r = 0.03;
+    auto q = 0.01;
+    mkt_params mktParams{S, sigma, t, r, q};
+    european_call europeanCall{K, t + 1.0_years};
+    european_put europeanPut{K, t + 1.0_years};
+    cranknicolson_solver solve{mktParams, 400, 200};
+    analytical_solver<autodiff_var> solve_analytically{mktParams};
+
+    auto cnCall = solve(europeanCall);
+    auto varCall = solve_analytically(europeanCall);
+    CHECK(cnCall->price() == Approx(varCall->price()).margin(0.002));
+    CHECK(cnCall->delta() == Approx(varCall->delta()).margin(0.0002));
+    CHECK(cnCall->gamma() == Approx(varCall->gamma()).margin(0.00002));
+    CHECK(cnCall->theta() == Approx(varCall->theta()).margin(0.005));
+    CHECK(cnCall->vega() == Approx(varCall->vega()).epsilon(0.002));
+    CHECK(cnCall->rho() == Approx(varCall->rho()).epsilon(0.002));
+    CHECK(cnCall->psi() == Approx(varCall->psi()).epsilon(0.002));
+
+    auto cnPut = solve(europeanPut);
+    auto varPut = solve_analytically(europeanPut);
+    CHECK(cnPut->price() == Approx(varPut->price()).margin(0.002));
+    CHECK(cnPut->delta() == Approx(varPut->delta()).margin(0.0002));
+    CHECK(cnPut->gamma() == Approx(varPut->gamma()).margin(0.00002));
+    CHECK(cnPut->theta() == Approx(varPut->theta()).margin(0.005));
+}
+
+TEST_CASE("American Put Pricing using Crank-Nicolson Finite Differences matches the Spectral Collocation (ALO) solver") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = system_clock::now();
+    auto r = 0.05;
+    auto q = 0.01;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 1.0_years};
+    cranknicolson_solver solve{mktParams, 400, 200};
+    fastamerican_solver solve_alo{mktParams, 25, 5, 12};
+
+    auto cnPricing = solve(americanPut);
+    auto aloPricing = solve_alo(americanPut);
+
+    CHECK(cnPricing->price() == Approx(aloPricing->price()).margin(0.005));
+    CHECK(cnPricing->delta() == Approx(aloPricing->delta()).margin(0.0005));
+    CHECK(cnPricing->gamma() == Approx(aloPricing->gamma()).margin(0.00005));
+    CHECK(cnPricing->theta() == Approx(aloPricing->theta()).margin(0.01));
+    CHECK(cnPricing->vega() == Approx(aloPricing->vega()).epsilon(0.005));
+    CHECK(cnPricing->rho() == Approx(aloPricing->rho()).epsilon(0.005));
+    CHECK(cnPricing->psi() == Approx(aloPricing->psi()).epsilon(0.005));
+
+    for (auto tau: {0.1, 0.25, 0.5, 1.0}) {
+        CHECK(cnPricing->exercise_boundary(tau) == Approx(aloPricing->exercise_boundary(tau)).epsilon(0.005));
+    }
+    CHECK((*cnPricing->exercise_boundary_curve())(0.5) == Approx(cnPricing->exercise_boundary(0.5)).epsilon(0.002));
+}
+
+TEST_CASE("American Call Pricing using Crank-Nicolson Finite Differences") {
+    auto K = 100.0;
+    auto S = 110.0;
+    auto sigma = 0.30;
+    auto t = system_clock::now();
+    auto r = 0.03;
+    auto q = 0.05;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_call americanCall{K, t + 0.75_years};
+    cranknicolson_solver solve{mktParams, 400, 200};
+    fastamerican_solver solve_alo{mktParams, 25, 5, 12};
+
+    auto cnPricing = solve(americanCall);
+    auto aloPricing = solve_alo(americanCall);
+
+    CHECK(cnPricing->price() == Approx(aloPricing->price()).margin(0.005));
+    CHECK(cnPricing->delta() == Approx(aloPricing->delta()).margin(0.0005));
+    CHECK(cnPricing->gamma() == Approx(aloPricing->gamma()).margin(0.00005));
+    CHECK(cnPricing->exercise_boundary(0.5) == Approx(aloPricing->exercise_boundary(0.5)).epsilon(0.005));
+
+    //Without dividends the call is never exercised early
+    mkt_params noDividends{S, sigma, t, r, 0.0};
+    cranknicolson_solver solve_european{noDividends, 400, 200};
+    analytical_solver<autodiff_off> solve_analytically{noDividends};
+    european_call europeanCall{K, t + 0.75_years};
+    auto cnNoDividends = solve_european(americanCall);
+    CHECK(cnNoDividends->price() == Approx(solve_analytically(europeanCall)->price()).margin(0.002));
+    CHECK(cnNoDividends->exercise_boundary(0.5) == INFINITY);
+}
+
+TEST_CASE("Chains priced with Crank-Nicolson Finite Differences share one solve across strikes") {
+    auto S = 100.0;
+    auto sigma = 0.25;
+    auto t = system_clock::now();
+    auto r = 0.05;
+    auto q = 0.01;
+    mkt_params mktParams{S, sigma, t, r, q};
+    cranknicolson_solver solve{mktParams, 400, 200};
+    fastamerican_solver solve_alo{mktParams, 25, 5, 12};
+
+    std::vector<american_put> puts;
+    for (auto K = 60.0; K <= 150.0; K += 5.0) {
+        puts.emplace_back(K, t + 1.0_years);
+    }
+    auto chain = solve(puts);
+    REQUIRE(chain.size() == puts.size());
+    for (std::size_t i = 0; i < puts.size(); i++) {
+        auto single = solve(puts[i]);
+        auto alo = solve_alo(puts[i]);
+        CHECK(chain[i]->price() == Approx(single->price()).margin(0.003));
+        CHECK(chain[i]->delta() == Approx(single->delta()).margin(0.0005));
+        CHECK(chain[i]->gamma() == Approx(single->gamma()).margin(0.00005));
+        CHECK(chain[i]->theta() == Approx(single->theta()).margin(0.02));
+        CHECK(chain[i]->price() == Approx(alo->price()).margin(0.005));
+        //the bumps move the exercise boundary across nodes, which makes the deep in the money vega and rho noisy
+        CHECK(chain[i]->vega() == Approx(alo->vega()).margin(0.25));
+        CHECK(chain[i]->rho() == Approx(alo->rho()).margin(0.25));
+        //The boundary of a strike is the one of the spot scaled by K/S
+        CHECK(chain[i]->exercise_boundary(0.5) == Approx(alo->exercise_boundary(0.5)).epsilon(0.005));
+    }
+
+    //Without tolerance for interpolation errors every strike is solved on its own, but the exercised ones
+    auto singles = solve(puts, -1.0);
+    for (std::size_t i = 0; i < puts.size(); i++) {
+        CHECK(singles[i]->price() == Approx(solve(puts[i])->price()).epsilon(1e-12));
+    }
+
+    std::vector<european_call> calls;
+    for (auto K = 70.0; K <= 130.0; K += 10.0) {
+        calls.emplace_back(K, t + 0.5_years);
+    }
+    analytical_solver<autodiff_off> solve_analytically{mktParams};
+    auto callChain = solve(calls);
+    for (std::size_t i = 0; i < calls.size(); i++) {
+        auto analytical = solve_analytically(calls[i]);
+        CHECK(callChain[i]->price() == Approx(analytical->price()).margin(0.003));
+        CHECK(callChain[i]->delta() == Approx(analytical->delta()).margin(0.0003));
+        CHECK(callChain[i]->gamma() == Approx(analytical->gamma()).margin(0.00003));
+    }
+}
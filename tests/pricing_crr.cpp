@@ -6,6 +6,8 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 using namespace bsm;
 using namespace std::chrono;
@@ -158,17 +160,243 @@ TEST_CASE("Test New Superpositioned Binomial Lattice method") {
 
     sbl_solver solve{mktParams,200};
     auto sbl_method = solve(americanPut);
-    auto sbl_price = sbl_method->price();
-    auto sbl_exercise_boundary = sbl_method->exercise_boundary(0.5);
 
     crr_solver solve_crr{mktParams,2000,200};
     auto crr_method = solve_crr(americanPut);
 
-    auto crr_price = crr_method->price();
-    auto exercise_boundary = crr_method->exercise_boundary(0.5);
-    std::cout << "Price using SBL = " << sbl_price << ", CRR = " << crr_price << std::endl;
-    std::cout << "Exercise boundary using SBL = " << sbl_exercise_boundary << ", CRR = " << exercise_boundary << std::endl;
+    CHECK(sbl_method->price() == Approx(crr_method->price()).margin(0.005));
+    CHECK(sbl_method->delta() == Approx(crr_method->delta()).margin(0.001));
+    CHECK(sbl_method->gamma() == Approx(crr_method->gamma()).margin(0.0005));
+    CHECK(sbl_method->theta() == Approx(crr_method->theta()).margin(0.05));
+    CHECK(sbl_method->vega() == Approx(crr_method->vega()).epsilon(0.005));
+    CHECK(sbl_method->rho() == Approx(crr_method->rho()).epsilon(0.005));
+    CHECK(sbl_method->psi() == Approx(crr_method->psi()).epsilon(0.005));
+    CHECK(sbl_method->exercise_boundary(0.25) == Approx(crr_method->exercise_boundary(0.25)).margin(0.1));
 
-    //TODO: Complete the SBL
+    //Each solve builds its own graph (re-run only for the bumps of vega, rho and psi), with the same prices
+    auto again = solve(americanPut);
+    CHECK(again->price() == Approx(sbl_method->price()).margin(1e-12));
+}
+TEST_CASE("American Call Pricing using Superpositioned Binomial Lattice matches CRR") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = system_clock::now();
+    auto r = 0.01;
+    auto q = 0.05;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_call americanCall{K, t + 0.5_years};
+
+    sbl_solver solve{mktParams,200};
+    crr_solver solve_crr{mktParams,2000,200};
+    trinomial_solver solve_trinomial{mktParams,2000};
+    auto sbl_method = solve(americanCall);
+    auto crr_method = solve_crr(americanCall);
+    auto trinomial_method = solve_trinomial(americanCall);
+
+    CHECK(sbl_method->price() == Approx(crr_method->price()).margin(0.005));
+    CHECK(sbl_method->delta() == Approx(crr_method->delta()).margin(0.001));
+    CHECK(sbl_method->exercise_boundary(0.25) == Approx(trinomial_method->exercise_boundary(0.25)).epsilon(0.01));
+}
+TEST_CASE("American Put Pricing using truncated Binomial Tree (CRR) matches the full tree") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = system_clock::now();
+    auto r = 0.05;
+    auto q = 0.0;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 0.5_years};
 
-}
\ No newline at end of file
+    crr_solver solve{mktParams,2000};
+    crr_solver solve_truncated{mktParams,2000,0,6.0};
+    auto crrPricing = solve(americanPut);
+    auto truncatedPricing = solve_truncated(americanPut);
+
+    CHECK(solve.truncation_error(americanPut) == 0.0);
+    CHECK(solve_truncated.truncation_error(americanPut) < 1e-6);
+    CHECK(truncatedPricing->price() == Approx(crrPricing->price()).margin(1e-6));
+    CHECK(truncatedPricing->delta() == Approx(crrPricing->delta()).margin(1e-6));
+    CHECK(truncatedPricing->gamma() == Approx(crrPricing->gamma()).margin(1e-6));
+    CHECK(truncatedPricing->theta() == Approx(crrPricing->theta()).margin(1e-6));
+    CHECK(truncatedPricing->exercise_boundary(0.25) == Approx(crrPricing->exercise_boundary(0.25)).margin(1e-6));
+}
+
+TEST_CASE("European Call Pricing using truncated Binomial Tree (CRR) with a narrow band") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = system_clock::now();
+    auto r = 0.01;
+    auto q = 0.05;
+    mkt_params mktParams{S, sigma, t, r, q};
+    european_call europeanCall{K, t + 0.5_years};
+
+    crr_solver solve_truncated{mktParams,20000,0,3.0};
+    analytical_solver solve_analytically{mktParams};
+    auto truncatedPricing = solve_truncated(europeanCall);
+    auto analyticalPricing = solve_analytically(europeanCall);
+
+    //The error bound covers the cut, the lattice itself adds its own (much smaller at this step count) error
+    CHECK(truncatedPricing->price() == Approx(analyticalPricing->price()).margin(solve_truncated.truncation_error(europeanCall) + 0.0005));
+    CHECK(truncatedPricing->delta() == Approx(analyticalPricing->delta()).margin(0.00005));
+}
+TEST_CASE("American Put exercise boundary of the Binomial Tree (CRR) is a continuous curve") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = system_clock::now();
+    auto r = 0.05;
+    auto q = 0.0;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 0.5_years};
+
+    crr_solver solve{mktParams,500};
+    auto crrPricing = solve(americanPut);
+
+    //Between two time steps the curve is the linear interpolation of the boundary at both steps
+    auto dt = 0.5/500;
+    auto B_1 = crrPricing->exercise_boundary(0.25);
+    auto B_2 = crrPricing->exercise_boundary(0.25 - dt);
+    auto B_mid = crrPricing->exercise_boundary(0.25 - dt/2);
+    CHECK(B_mid == Approx((B_1 + B_2)/2).margin(0.05));
+
+    //The put boundary rises towards the strike as the maturity approaches (up to the size of a node, about 0.6%)
+    auto previous = crrPricing->exercise_boundary(0.5);
+    for (int i = 1; i <= 50; i++) {
+        auto B = crrPricing->exercise_boundary(0.5 - i*0.01);
+        CHECK(B >= previous * 0.99);
+        CHECK(B <= K);
+        previous = B;
+    }
+}
+
+TEST_CASE("American Put exercise boundary curve of the Binomial Tree (CRR) is smooth and monotone") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = system_clock::now();
+    auto r = 0.05;
+    auto q = 0.0;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 0.5_years};
+
+    crr_solver solve{mktParams,500};
+    fastamerican_solver solve_reference{mktParams, 25, 5, 12};
+    auto crrPricing = solve(americanPut);
+    auto referencePricing = solve_reference(americanPut);
+    auto curve = crrPricing->exercise_boundary_curve();
+    CHECK(crrPricing->exercise_boundary_curve() == curve);
+
+    //Unlike the lattice boundary the curve never jitters by a node
+    auto previous = (*curve)(0.5);
+    for (int i = 1; i <= 500; i++) {
+        auto tau = 0.5 - i * 0.001;
+        auto B = (*curve)(tau);
+        CHECK(B >= previous);
+        if (tau >= 0.005) {
+            CHECK(B == Approx(referencePricing->exercise_boundary(tau)).epsilon(0.01));
+        }
+        previous = B;
+    }
+    CHECK((*curve)(0.0) == Approx(K));
+}
+
+TEST_CASE("The exercise boundary curve is built once when several threads ask for it") {
+    auto t = system_clock::now();
+    mkt_params mktParams{100.0, 0.20, t, 0.05, 0.0};
+    american_put americanPut{100.0, t + 0.5_years};
+
+    crr_solver solve{mktParams,200};
+    auto crrPricing = solve(americanPut);
+    std::vector<std::shared_ptr<const boundary_curve>> curves(4);
+    std::vector<std::thread> threads;
+    for (auto& curve: curves) {
+        threads.emplace_back([&crrPricing, &curve] { curve = crrPricing->exercise_boundary_curve(); });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    for (auto const& curve: curves) {
+        CHECK(curve == curves[0]);
+    }
+}
+
+TEST_CASE("American Call Pricing using the lattices goes through the symmetric put") {
+    auto K = 100.0;
+    auto S = 110.0;
+    auto sigma = 0.30;
+    auto t = system_clock::now();
+    auto r = 0.08;
+    auto q = 0.04;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_call americanCall{K, t + 1.0_years};
+
+    //C(S, K, r, q) = P(K, S, q, r)
+    mkt_params symmetricParams{K, sigma, t, q, r};
+    american_put symmetricPut{S, t + 1.0_years};
+    crr_solver solve{mktParams,2000};
+    crr_solver solve_symmetric{symmetricParams,2000};
+    auto crr_method = solve(americanCall);
+    auto put_method = solve_symmetric(symmetricPut);
+    CHECK(crr_method->price() == put_method->price());
+    CHECK(crr_method->psi() == put_method->rho());
+    CHECK(crr_method->exercise_boundary(0.5) == Approx(S * K / put_method->exercise_boundary(0.5)).epsilon(1e-12));
+
+    fastamerican_solver solve_alo{mktParams, 25, 5, 12};
+    trinomial_solver solve_trinomial{mktParams,2000};
+    sbl_solver solve_sbl{mktParams,200};
+    auto alo_method = solve_alo(americanCall);
+    std::vector<std::unique_ptr<american_method>> methods;
+    methods.push_back(std::move(crr_method));
+    methods.push_back(solve_trinomial(americanCall));
+    methods.push_back(solve_sbl(americanCall));
+    for (auto const& method: methods) {
+        CHECK(method->price() == Approx(alo_method->price()).margin(0.01));
+        CHECK(method->delta() == Approx(alo_method->delta()).margin(0.001));
+        CHECK(method->gamma() == Approx(alo_method->gamma()).margin(0.0001));
+        CHECK(method->theta() == Approx(alo_method->theta()).margin(0.02));
+        CHECK(method->exercise_boundary(0.5) == Approx(alo_method->exercise_boundary(0.5)).epsilon(0.01));
+    }
+}
+
+TEST_CASE("American Put control variate lattices are closer to the Spectral Collocation (ALO) solver") {
+    auto K = 100.0;
+    auto sigma = 0.25;
+    auto t = system_clock::now();
+    auto r = 0.05;
+    auto q = 0.01;
+    american_put americanPut{K, t + 1.0_years};
+
+    //RMS price errors over a strip of spots: the lattice oscillations depend on where the strike falls between nodes
+    double crr_error = 0, crr_cv_error = 0, sbl_error = 0, sbl_cv_error = 0;
+    for (auto S = 80.0; S <= 120.0; S += 4.0) {
+        mkt_params mktParams{S, sigma, t, r, q};
+        fastamerican_solver solve_alo{mktParams, 25, 5, 12};
+        auto alo_method = solve_alo(americanPut);
+        auto crr_method = crr_solver{mktParams, 200}(americanPut);
+        auto crr_cv_method = crr_solver{mktParams, 200, 0, 0, true}(americanPut);
+        auto sbl_method = sbl_solver{mktParams, 200}(americanPut);
+        auto sbl_cv_method = sbl_solver{mktParams, 200, true}(americanPut);
+        crr_error += pow(crr_method->price() - alo_method->price(), 2);
+        crr_cv_error += pow(crr_cv_method->price() - alo_method->price(), 2);
+        sbl_error += pow(sbl_method->price() - alo_method->price(), 2);
+        sbl_cv_error += pow(sbl_cv_method->price() - alo_method->price(), 2);
+
+        CHECK(crr_cv_method->price() == Approx(alo_method->price()).margin(0.001));
+        CHECK(sbl_cv_method->price() == Approx(alo_method->price()).margin(0.001));
+        for (auto const& method: {crr_cv_method.get(), sbl_cv_method.get()}) {
+            CHECK(method->delta() == Approx(alo_method->delta()).margin(0.002));
+            CHECK(method->gamma() == Approx(alo_method->gamma()).margin(0.0003));
+            CHECK(method->theta() == Approx(alo_method->theta()).margin(0.06));
+            CHECK(method->vega() == Approx(alo_method->vega()).epsilon(0.025));
+        }
+    }
+    CHECK(crr_cv_error < crr_error / 16);
+    CHECK(sbl_cv_error < sbl_error / 16);
+
+    //European options have no early exercise to correct
+    mkt_params mktParams{100.0, sigma, t, r, q};
+    european_put europeanPut{K, t + 1.0_years};
+    CHECK(crr_solver{mktParams, 200, 0, 0, true}(europeanPut)->price() == crr_solver{mktParams, 200}(europeanPut)->price());
+}
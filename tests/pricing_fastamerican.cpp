@@ -0,0 +1,216 @@
+#include <catch2/catch.hpp>
+
+#include "../bsm/bsm.h"
+#include "../bsm/solver_fastamerican_internals.h"
+
+#include <chrono>
+#include <numbers>
+#include <vector>
+#include <cmath>
+#include <thread>
+#include <memory>
+
+using namespace bsm;
+using namespace std::chrono;
+using namespace std::chrono_literals;
+using namespace bsm::chrono;
+
+TEST_CASE("American Put Pricing using Spectral Collocation (ALO) matches the Trinomial Lattice") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.25;
+    auto t = system_clock::now();
+    auto r = 0.05;
+    auto q = 0.02;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 1.0_years};
+    fastamerican_solver solve{mktParams, 25, 5, 12};
+    trinomial_solver solve_trinomial{mktParams, 3000};
+
+    auto fastPricing = solve(americanPut);
+    auto trinomialPricing = solve_trinomial(americanPut);
+
+    CHECK(fastPricing->price() == Approx(trinomialPricing->price()).margin(0.0005));
+    CHECK(fastPricing->delta() == Approx(trinomialPricing->delta()).margin(0.0001));
+    CHECK(fastPricing->gamma() == Approx(trinomialPricing->gamma()).margin(0.00001));
+    CHECK(fastPricing->theta() == Approx(trinomialPricing->theta()).margin(0.002));
+    CHECK(fastPricing->vega() == Approx(trinomialPricing->vega()).epsilon(0.005));
+    CHECK(fastPricing->rho() == Approx(trinomialPricing->rho()).epsilon(0.005));
+    CHECK(fastPricing->psi() == Approx(trinomialPricing->psi()).epsilon(0.005));
+    for (auto tau: {0.1, 0.5, 1.0}) {
+        CHECK(fastPricing->exercise_boundary(tau) == Approx(trinomialPricing->exercise_boundary(tau)).epsilon(0.005));
+    }
+}
+
+TEST_CASE("American Call Pricing using Spectral Collocation (ALO) matches the Trinomial Lattice") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.25;
+    auto t = system_clock::now();
+    auto r = 0.02;
+    auto q = 0.05;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_call americanCall{K, t + 1.0_years};
+    american_put americanPut{K, t + 1.0_years};
+    fastamerican_solver solve{mktParams, 25, 5, 12};
+    trinomial_solver solve_trinomial{mktParams, 3000};
+
+    auto fastPricing = solve(americanCall);
+    auto trinomialPricing = solve_trinomial(americanCall);
+
+    CHECK(fastPricing->price() == Approx(trinomialPricing->price()).margin(0.0005));
+    CHECK(fastPricing->delta() == Approx(trinomialPricing->delta()).margin(0.0001));
+    CHECK(fastPricing->gamma() == Approx(trinomialPricing->gamma()).margin(0.00001));
+    CHECK(fastPricing->theta() == Approx(trinomialPricing->theta()).margin(0.002));
+    CHECK(fastPricing->vega() == Approx(trinomialPricing->vega()).epsilon(0.005));
+    CHECK(fastPricing->rho() == Approx(trinomialPricing->rho()).epsilon(0.005));
+    CHECK(fastPricing->psi() == Approx(trinomialPricing->psi()).epsilon(0.005));
+    for (auto tau: {0.1, 0.5, 1.0}) {
+        CHECK(fastPricing->exercise_boundary(tau) == Approx(trinomialPricing->exercise_boundary(tau)).epsilon(0.005));
+    }
+
+    //Put-call symmetry: the call with rates (r,q) is the put with rates (q,r)
+    mkt_params symmetricParams{S, sigma, t, q, r};
+    fastamerican_solver solve_symmetric{symmetricParams, 25, 5, 12};
+    auto symmetricPricing = solve_symmetric(americanPut);
+    CHECK(fastPricing->price() == Approx(symmetricPricing->price()).margin(1e-10));
+    CHECK(fastPricing->exercise_boundary(0.5) == Approx(K * K / symmetricPricing->exercise_boundary(0.5)).epsilon(1e-10));
+}
+
+TEST_CASE("Spectral Collocation (ALO) converges to 1e-8") {
+    auto K = 100.0;
+    auto S = 90.0;
+    auto sigma = 0.30;
+    auto t = system_clock::now();
+    auto r = 0.06;
+    auto q = 0.0;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 2.0_years};
+    fastamerican_solver solve{mktParams, 25, 5, 12};
+    fastamerican_solver solve_reference{mktParams, 64, 12, 32};
+
+    auto fastPricing = solve(americanPut);
+    auto referencePricing = solve_reference(americanPut);
+
+    CHECK(fastPricing->price() == Approx(referencePricing->price()).margin(1e-7));
+    CHECK(fastPricing->delta() == Approx(referencePricing->delta()).margin(1e-7));
+
+    //Deep in the exercise region the put is worth its payoff
+    mkt_params deepParams{40.0, sigma, t, r, q};
+    fastamerican_solver solve_deep{deepParams, 25, 5, 12};
+    auto deepPricing = solve_deep(americanPut);
+    CHECK(deepPricing->price() == Approx(K - 40.0));
+    CHECK(deepPricing->delta() == Approx(-1.0));
+    CHECK(deepPricing->theta() == 0.0);
+}
+
+TEST_CASE("Spectral Collocation (ALO) prices an American Call without dividends as an European Call") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = system_clock::now();
+    auto r = 0.03;
+    auto q = 0.0;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_call americanCall{K, t + 1.0_years};
+    european_call europeanCall{K, t + 1.0_years};
+    fastamerican_solver solve{mktParams, 16, 3, 8};
+    analytical_solver solve_analytically{mktParams};
+
+    auto fastPricing = solve(americanCall);
+    auto analyticalPricing = solve_analytically(europeanCall);
+
+    CHECK(fastPricing->price() == Approx(analyticalPricing->price()).margin(1e-10));
+    CHECK(fastPricing->delta() == Approx(analyticalPricing->delta()).margin(1e-10));
+    CHECK(fastPricing->gamma() == Approx(analyticalPricing->gamma()).margin(1e-10));
+    CHECK(fastPricing->exercise_boundary(0.5) == INFINITY);
+}
+
+TEST_CASE("Compile time quadrature and Chebyshev tables") {
+    using namespace bsm::internals;
+
+    //Gauss-Legendre with l points is exact for polynomials of degree 2l-1
+    constexpr auto const& rule = gauss_legendre_table<8>;
+    double integral = 0;
+    for (int k = 0; k < 8; k++) {
+        integral += rule.weights[k] * pow(rule.nodes[k], 14);
+    }
+    CHECK(integral == Approx(2.0 / 15.0).epsilon(1e-14));
+
+    //The tables match the rule computed at runtime
+    std::vector<double> nodes(25), weights(25);
+    gauss_legendre(25, nodes.data(), weights.data());
+    for (int k = 0; k < 25; k++) {
+        CHECK(gauss_legendre_table<25>.nodes[k] == Approx(nodes[k]).margin(1e-15));
+        CHECK(gauss_legendre_table<25>.weights[k] == Approx(weights[k]).margin(1e-15));
+    }
+
+    //Tanh-sinh copes with the end point singularity of the derivative of sqrt(1-x^2)
+    constexpr auto const& tanh_sinh = tanh_sinh_table<41>;
+    double singular = 0;
+    for (int k = 0; k < 41; k++) {
+        singular += tanh_sinh.weights[k] * sqrt(1.0 - tanh_sinh.nodes[k] * tanh_sinh.nodes[k]);
+    }
+    CHECK(singular == Approx(std::numbers::pi / 2.0).epsilon(1e-10));
+
+    //Chebyshev nodes, interpolation and differentiation of x^3
+    constexpr auto const& chebyshev = chebyshev_table<12>;
+    static_assert(chebyshev.nodes[0] == -1.0 and chebyshev.nodes[12] == 1.0);
+    std::vector<double> values(13);
+    for (int i = 0; i <= 12; i++) {
+        CHECK(chebyshev.nodes[i] == Approx(-cos(i * std::numbers::pi / 12)).margin(1e-15));
+        values[i] = pow(chebyshev.nodes[i], 3);
+    }
+    chebyshev_interpolation interpolation{values};
+    CHECK(interpolation(0.3) == Approx(0.027).margin(1e-14));
+    for (int i = 0; i <= 12; i++) {
+        double derivative = 0;
+        for (int j = 0; j <= 12; j++) {
+            derivative += chebyshev.differentiation[i * 13 + j] * values[j];
+        }
+        CHECK(derivative == Approx(3.0 * pow(chebyshev.nodes[i], 2)).margin(1e-12));
+    }
+}
+
+TEST_CASE("Exercise boundary curve of the Spectral Collocation (ALO) method is shared across threads") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.25;
+    auto t = system_clock::now();
+    auto r = 0.02;
+    auto q = 0.05;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_call americanCall{K, t + 1.0_years};
+    fastamerican_solver solve{mktParams, 25, 5, 12};
+    auto fastPricing = solve(americanCall);
+    std::shared_ptr<const boundary_curve> curve = fastPricing->exercise_boundary_curve();
+
+    //The curve interpolates in the same variable as the collocation, so it reproduces the boundary
+    std::vector<double> expected(1001);
+    for (int i = 0; i <= 1000; i++) {
+        expected[i] = fastPricing->exercise_boundary(i / 1000.0);
+        CHECK((*curve)(i / 1000.0) == Approx(expected[i]).epsilon(1e-9));
+    }
+
+    //Queries from several threads see the same immutable curve
+    std::vector<std::thread> threads;
+    std::vector<int> mismatches(4, 0);
+    for (int k = 0; k < 4; k++) {
+        threads.emplace_back([curve, &expected, &mismatches, k] () {
+            for (int i = 0; i <= 1000; i++) {
+                if ((*curve)(i / 1000.0) != Approx(expected[i]).epsilon(1e-9)) {
+                    mismatches[k]++;
+                }
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    CHECK(mismatches == std::vector<int>(4, 0));
+
+    //Without dividends the call is never exercised early
+    mkt_params noDividends{S, sigma, t, r, 0.0};
+    fastamerican_solver solve_european{noDividends, 16, 3, 8};
+    CHECK((*solve_european(americanCall)->exercise_boundary_curve())(0.5) == INFINITY);
+}
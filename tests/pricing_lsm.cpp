@@ -0,0 +1,68 @@
+#include <catch2/catch.hpp>
+
+#include "../bsm/bsm.h"
+
+#include <chrono>
+#include <cmath>
+
+using namespace bsm;
+using namespace std::chrono;
+using namespace std::chrono_literals;
+using namespace bsm::chrono;
+
+TEST_CASE("American Put Pricing using Least-Squares Monte Carlo matches the Spectral Collocation (ALO) solver") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = system_clock::now();
+    auto r = 0.05;
+    auto q = 0.01;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 1.0_years};
+    lsm_solver solve{mktParams, 100000, 50};
+    fastamerican_solver solve_reference{mktParams, 25, 5, 12};
+
+    auto lsmPricing = solve(americanPut);
+    auto reference = solve_reference(americanPut);
+
+    //50 exercise dates and a sub-optimal policy price a little below the continuously exercised put
+    CHECK(lsmPricing->price() == Approx(reference->price()).margin(0.03 + 3 * lsmPricing->standard_error()));
+    CHECK(lsmPricing->price() < reference->price() + 3 * lsmPricing->standard_error());
+    CHECK(lsmPricing->standard_error() < 0.03);
+    CHECK(lsmPricing->delta() == Approx(reference->delta()).margin(0.01));
+    CHECK(lsmPricing->gamma() == Approx(reference->gamma()).margin(0.003));
+    CHECK(lsmPricing->vega() == Approx(reference->vega()).epsilon(0.05));
+    CHECK(lsmPricing->rho() == Approx(reference->rho()).epsilon(0.1));
+    //The boundary is the root of payoff = continuation, where both are tangent, so much noisier than the price
+    for (auto _tau: {0.1, 0.5, 0.9}) {
+        CHECK(lsmPricing->exercise_boundary(_tau) == Approx(reference->exercise_boundary(_tau)).epsilon(0.035));
+    }
+    CHECK(lsmPricing->exercise_boundary(0.0) == Approx(K));
+
+    //Same seed, same paths
+    CHECK(solve(americanPut)->price() == lsmPricing->price());
+
+    //Deep in the money it is exercised at once
+    american_put deepPut{200.0, t + 1.0_years};
+    CHECK(solve(deepPut)->price() == Approx(100.0));
+}
+
+TEST_CASE("American Call Pricing using Least-Squares Monte Carlo matches the Spectral Collocation (ALO) solver") {
+    auto K = 100.0;
+    auto S = 110.0;
+    auto sigma = 0.30;
+    auto t = system_clock::now();
+    auto r = 0.02;
+    auto q = 0.06;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_call americanCall{K, t + 0.5_years};
+    lsm_solver solve{mktParams, 100000, 50};
+    fastamerican_solver solve_reference{mktParams, 25, 5, 12};
+
+    auto lsmPricing = solve(americanCall);
+    auto reference = solve_reference(americanCall);
+
+    CHECK(lsmPricing->price() == Approx(reference->price()).margin(0.03 + 3 * lsmPricing->standard_error()));
+    CHECK(lsmPricing->delta() == Approx(reference->delta()).margin(0.01));
+    CHECK(lsmPricing->exercise_boundary(0.1) == Approx(reference->exercise_boundary(0.1)).epsilon(0.035));
+}
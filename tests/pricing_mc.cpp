@@ -0,0 +1,108 @@
+#include <catch2/catch.hpp>
+
+#include "../bsm/bsm.h"
+
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+using namespace bsm;
+using namespace std::chrono;
+using namespace std::chrono_literals;
+using namespace bsm::chrono;
+
+TEST_CASE("European Pricing using Monte Carlo") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = system_clock::now();
+    auto r = 0.01;
+    auto q = 0.05;
+    mkt_params mktParams{S, sigma, t, r, q};
+    european_call europeanCall{K, t + 0.5_years};
+    european_put europeanPut{K, t + 0.5_years};
+    european_forward europeanForward{K, t + 0.5_years};
+    analytical_solver<autodiff_var> solve_analytically{mktParams};
+    auto call = solve_analytically(europeanCall);
+    auto put = solve_analytically(europeanPut);
+
+    mc_solver plain{mktParams, 200000};
+    mc_solver antithetic{mktParams, 200000, 1, true};
+    auto plainCall = plain(europeanCall);
+    auto antitheticCall = antithetic(europeanCall);
+    auto plainPut = plain(europeanPut);
+    CHECK(std::abs(plainCall->price() - call->price()) < 3 * plainCall->standard_error());
+    CHECK(std::abs(antitheticCall->price() - call->price()) < 3 * antitheticCall->standard_error());
+    CHECK(std::abs(plainPut->price() - put->price()) < 3 * plainPut->standard_error());
+    CHECK(plainCall->standard_error() == Approx(0.018).epsilon(0.05));
+    CHECK(antitheticCall->standard_error() < 0.85 * plainCall->standard_error());
+
+    //The estimates only depend on the seed
+    CHECK(plain(europeanCall)->price() == plainCall->price());
+    CHECK(mc_solver{mktParams, 200000, 1, false, false, 2}(europeanCall)->price() != plainCall->price());
+
+    //A vanilla is its own control variate
+    mc_solver controlled{mktParams, 10000, 1, false, true};
+    auto controlledCall = controlled(europeanCall);
+    CHECK(controlledCall->price() == Approx(call->price()).epsilon(1e-12));
+    CHECK(controlledCall->standard_error() < 1e-6);
+    CHECK(controlled(europeanForward)->price() == Approx(solve_analytically(europeanForward)->price()).epsilon(1e-12));
+
+    //Pathwise delta and vega, likelihood ratio gamma, from the paths of the price
+    CHECK(std::abs(plainCall->delta() - call->delta()) < 3 * plainCall->delta_error());
+    CHECK(std::abs(plainCall->gamma() - call->gamma()) < 3 * plainCall->gamma_error());
+    CHECK(std::abs(plainCall->vega() - call->vega()) < 3 * plainCall->vega_error());
+    CHECK(std::abs(plainPut->delta() - put->delta()) < 3 * plainPut->delta_error());
+    CHECK(plainCall->delta_error() < 0.002);
+    CHECK(plainCall->gamma_error() < 0.1 * call->gamma());
+    CHECK(plainCall->vega_error() < 0.01 * call->vega());
+    CHECK(controlledCall->delta() == Approx(call->delta()).epsilon(1e-6));
+    CHECK(controlledCall->gamma() == Approx(call->gamma()).epsilon(1e-6));
+    CHECK(controlledCall->vega() == Approx(call->vega()).epsilon(1e-6));
+
+    //Bumps on common random numbers
+    CHECK(plainCall->theta() == Approx(call->theta()).epsilon(0.05));
+    CHECK(plainCall->rho() == Approx(call->rho()).epsilon(0.02));
+    CHECK(plainCall->psi() == Approx(call->psi()).epsilon(0.02));
+}
+
+TEST_CASE("Asian Call Pricing using Monte Carlo with the European Call as control variate") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.30;
+    auto t = system_clock::now();
+    auto r = 0.03;
+    auto q = 0.0;
+    mkt_params mktParams{S, sigma, t, r, q};
+    european_call europeanCall{K, t + 1.0_years};
+    path_payoff asian = [K](double const* S, int steps) {
+        double average = 0;
+        for (int i = 0; i < steps; i++) {
+            average += S[i] / steps;
+        }
+        return std::max(average - K, 0.0);
+    };
+
+    auto plain = mc_solver{mktParams, 100000, 12}(europeanCall, asian);
+    auto controlled = mc_solver{mktParams, 100000, 12, false, true}(europeanCall, asian);
+    auto both = mc_solver{mktParams, 100000, 12, true, true}(europeanCall, asian);
+
+    //Arithmetic average of 12 monthly fixings
+    auto reference = 8.010;
+    CHECK(std::abs(plain->price() - controlled->price()) < 3 * plain->standard_error());
+    CHECK(std::abs(controlled->price() - both->price()) < 3 * controlled->standard_error());
+    CHECK(controlled->standard_error() < 0.6 * plain->standard_error());
+    CHECK(both->standard_error() < controlled->standard_error());
+    CHECK(controlled->price() == Approx(reference).margin(0.07));
+
+    //Greeks of the average, against bumps of the price on the same paths
+    auto up = mc_solver{mkt_params{S * 1.01, sigma, t, r, q}, 100000, 12, true, true}(europeanCall, asian)->price();
+    auto down = mc_solver{mkt_params{S * 0.99, sigma, t, r, q}, 100000, 12, true, true}(europeanCall, asian)->price();
+    CHECK(both->delta() == Approx((up - down) / (0.02 * S)).margin(0.005));
+    CHECK(both->gamma() == Approx((up - 2 * both->price() + down) / (0.0001 * S * S)).margin(0.003));
+    auto vol_up = mc_solver{mkt_params{S, sigma + 0.01, t, r, q}, 100000, 12, true, true}(europeanCall, asian)->price();
+    auto vol_down = mc_solver{mkt_params{S, sigma - 0.01, t, r, q}, 100000, 12, true, true}(europeanCall, asian)->price();
+    CHECK(both->vega() == Approx((vol_up - vol_down) / 0.02).epsilon(0.02));
+    CHECK(both->delta_error() < plain->delta_error());
+    CHECK(both->vega_error() < plain->vega_error());
+}
@@ -1,8 +1,10 @@
 #include <catch2/catch.hpp>
 
 #include "../bsm/bsm.h"
+#include "../bsm/solver_qdplus_internals.h"
 
 #include <chrono>
+#include <cmath>
 #include <string>
 #include <iostream>
 #include <sstream>
@@ -134,4 +136,138 @@ TEST_CASE("American Put Pricing using QD+ approximation method matches results f
     crr_solver solve_crr{mktParams,2000,200};
     auto crr_method = solve_crr(americanPut);
     CHECK(qdplus_method->exercise_boundary(0.3333333) == Approx(crr_method->exercise_boundary(0.3333333)).epsilon(0.005));
-}
\ No newline at end of file
+}
+TEST_CASE("QD+ exercise boundary using Halley iteration in double precision matches the dual number path") {
+    using namespace bsm::internals;
+    auto K = 100.0;
+    auto sigma = 0.20;
+    auto tau = 0.5;
+    for (auto [r, q] : {std::make_pair(0.05, 0.0), std::make_pair(0.01, 0.05), std::make_pair(0.08, 0.04)}) {
+        pricing<ldual> p{K, K, sigma, tau, r, q};
+        qdplus_method_core<ldual> core{p, false};
+        auto reference = static_cast<double>(autodiff::val(core.calculate_exercise_boundary(tau)));
+
+        qdplus_boundary_solver solver{K, sigma, r, q};
+        auto cold = solver(tau);
+        CHECK(cold.Sb == Approx(reference).epsilon(1e-8));
+        CHECK(cold.iterations <= 8);
+
+        //Warm start from the boundary of a close time to maturity and of a neighbouring strike
+        auto warm = solver(tau * 1.01, cold.Sb);
+        CHECK(warm.Sb == Approx(solver(tau * 1.01).Sb).epsilon(1e-10));
+        CHECK(warm.iterations <= cold.iterations);
+        qdplus_boundary_solver neighbour{K * 1.01, sigma, r, q};
+        auto rescaled = neighbour(tau, qdplus_boundary_solver::rescale(cold.Sb, K, K * 1.01));
+        CHECK(rescaled.Sb == Approx(cold.Sb * 1.01).epsilon(1e-10));
+        CHECK(rescaled.iterations <= 2);
+    }
+}
+
+TEST_CASE("QD+ call exercise boundary using Halley iteration matches the Trinomial Lattice") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.30;
+    auto t = system_clock::now();
+    auto r = 0.08;
+    auto q = 0.04;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_call americanCall{K, t + 1.0_years};
+
+    trinomial_solver solve_trinomial{mktParams,2000};
+    auto trinomial_method = solve_trinomial(americanCall);
+
+    bsm::internals::qdplus_boundary_solver solver{K, sigma, r, q, true};
+    CHECK(solver(0.5).Sb == Approx(trinomial_method->exercise_boundary(0.5)).epsilon(0.01));
+}
+
+TEST_CASE("Branch free exp, log and normal cdf of the QD+ lanes match the C library") {
+    using namespace bsm::internals;
+    for (auto x = -700.0; x <= 700.0; x += 0.37) {
+        CHECK(vector_math::exp(x) == Approx(std::exp(x)).epsilon(1e-15));
+    }
+    for (auto x = 1e-300; x < 1e300; x *= 3.7) {
+        CHECK(vector_math::log(x) == Approx(std::log(x)).epsilon(1e-15));
+    }
+    for (auto x = -10.0; x <= 10.0; x += 0.0123) {
+        //erfc rather than cdf<double>, whose 1 + erf cancels in the left tail
+        CHECK(vector_math::cdf(x) == Approx(0.5 * std::erfc(-x * one_div_root_two)).epsilon(1e-13).margin(0));
+        CHECK(vector_math::pdf(x) == Approx(pdf<double>(x)).epsilon(1e-14).margin(0));
+    }
+    CHECK(vector_math::select_negative(-0.0, 1.0, 2.0) == 1.0);
+    CHECK(vector_math::select_negative(0.0, 1.0, 2.0) == 2.0);
+}
+
+TEST_CASE("Batched QD+ over a chain matches the scalar solvers") {
+    using namespace bsm::internals;
+    auto S = 100.0;
+    auto sigma = 0.25;
+    auto r = 0.05;
+    auto q = 0.02;
+    auto t = system_clock::now();
+    mkt_params mktParams{S, sigma, t, r, q};
+
+    //Puts and calls over strikes and expiries, and a put that is never exercised early
+    std::vector<qdplus_batch_solver::option> chain;
+    for (auto tau: {0.1, 0.5, 1.0}) {
+        for (auto K = 80.0; K <= 120.0; K += 5.0) {
+            chain.push_back({S, K, sigma, tau, r, q, false});
+            chain.push_back({S, K, sigma, tau, r, q, true});
+        }
+    }
+    chain.push_back({S, 100.0, sigma, 0.5, -0.01, 0.0, false});
+    auto results = qdplus_batch_solver{}(chain);
+    REQUIRE(results.size() == chain.size());
+
+    for (std::size_t i = 0; i + 1 < chain.size(); i++) {
+        auto const& o = chain[i];
+        qdplus_boundary_solver solver{o.K, sigma, r, q, o.call};
+        CHECK(results[i].boundary == Approx(solver(o.tau).Sb).epsilon(1e-10));
+        CHECK(results[i].iterations <= 8);
+        if (not o.call) {
+            pricing<ldual> p{S, o.K, sigma, o.tau, r, q};
+            qdplus_method_core<ldual> core{p, false};
+            auto reference = static_cast<double>(autodiff::val(core.calc_price(results[i].boundary)));
+            CHECK(results[i].price == Approx(reference).margin(1e-9));
+        }
+    }
+
+    //The call prices are those of the symmetric puts
+    american_call americanCall{100.0, t + 1.0_years};
+    trinomial_solver solve_trinomial{mktParams, 2000};
+    auto call = std::find_if(chain.begin(), chain.end(), [](auto const& o) { return o.call and o.K == 100.0 and o.tau == 1.0; });
+    CHECK(results[call - chain.begin()].price == Approx(solve_trinomial(americanCall)->price()).epsilon(0.005));
+
+    //Negative rates: the put is never exercised early
+    CHECK(results.back().boundary == 0.0);
+    CHECK(results.back().iterations == 0);
+}
+
+TEST_CASE("American Call Pricing using QD+ goes through the symmetric put when dividends are higher than rates") {
+    auto K = 100.0L;
+    auto S = 110.0L;
+    auto sigma = 0.30L;
+    auto t = system_clock::now();
+    auto r = 0.02L;
+    auto q = 0.08L;
+    mkt_params<long double> mktParams{S, sigma, t, r, q};
+    american_call americanCall{K, t + 1.0_years};
+    qdplus_solver solve{mktParams};
+    auto qdplus_method = solve(americanCall);
+
+    //C(S, K, r, q) = P(K, S, q, r)
+    mkt_params<long double> symmetricParams{K, sigma, t, q, r};
+    american_put symmetricPut{S, t + 1.0_years};
+    qdplus_solver solve_symmetric{symmetricParams};
+    auto put_method = solve_symmetric(symmetricPut);
+    CHECK(qdplus_method->price() == put_method->price());
+    CHECK(qdplus_method->rho() == put_method->psi());
+    CHECK(qdplus_method->exercise_boundary(0.5) == Approx(S * K / put_method->exercise_boundary(0.5)).epsilon(1e-12));
+
+    //QD+ is an approximation, but its greeks and boundary stay close to the spectral collocation ones
+    fastamerican_solver solve_alo{mktParams, 25, 5, 12};
+    auto alo_method = solve_alo(americanCall);
+    CHECK(qdplus_method->price() == Approx(alo_method->price()).margin(0.1));
+    CHECK(qdplus_method->delta() == Approx(alo_method->delta()).margin(0.005));
+    CHECK(qdplus_method->gamma() == Approx(alo_method->gamma()).margin(0.0005));
+    CHECK(qdplus_method->exercise_boundary(0.5) == Approx(alo_method->exercise_boundary(0.5)).epsilon(0.005));
+}
@@ -0,0 +1,156 @@
+#include <catch2/catch.hpp>
+
+#include "../bsm/bsm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <iostream>
+#include <sstream>
+
+using namespace bsm;
+using namespace std::chrono;
+using namespace std::chrono_literals;
+using namespace bsm::chrono;
+
+TEST_CASE("European Call Pricing using Trinomial Lattice (Kamrad-Ritchken)") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = system_clock::now();
+    auto r = 0.01;
+    auto q = 0.05;
+    mkt_params mktParams{S, sigma, t, r, q};
+    european_call europeanCall{K, t + 0.5_years};
+    trinomial_solver solve{mktParams,1000};
+    analytical_solver<autodiff_var> solve_analytically{mktParams};
+
+    auto trinomialPricing = solve(europeanCall);
+    auto varPricing = solve_analytically(europeanCall);
+
+    CHECK(trinomialPricing->price() == Approx(varPricing->price()).margin(0.005));
+    CHECK(trinomialPricing->delta() == Approx(varPricing->delta()).margin(0.0005));
+    CHECK(trinomialPricing->gamma() == Approx(varPricing->gamma()).margin(0.00003));
+    CHECK(trinomialPricing->theta() == Approx(varPricing->theta()).margin(0.005));
+    CHECK(trinomialPricing->vega() == Approx(varPricing->vega()).epsilon(0.005));
+    CHECK(trinomialPricing->rho() == Approx(varPricing->rho()).epsilon(0.005));
+    CHECK(trinomialPricing->psi() == Approx(varPricing->psi()).epsilon(0.005));
+}
+
+TEST_CASE("European Put Pricing using Trinomial Lattice with the strike off the spot") {
+    auto K = 105.0;
+    auto S = 100.0;
+    auto sigma = 0.25;
+    auto t = system_clock::now();
+    auto r = 0.03;
+    auto q = 0.01;
+    mkt_params mktParams{S, sigma, t, r, q};
+    european_put europeanPut{K, t + 1.0_years};
+    trinomial_solver solve{mktParams,1000};
+    analytical_solver<autodiff_var> solve_analytically{mktParams};
+
+    auto trinomialPricing = solve(europeanPut);
+    auto varPricing = solve_analytically(europeanPut);
+
+    CHECK(trinomialPricing->price() == Approx(varPricing->price()).margin(0.002));
+    CHECK(trinomialPricing->delta() == Approx(varPricing->delta()).margin(0.0005));
+    CHECK(trinomialPricing->gamma() == Approx(varPricing->gamma()).margin(0.00005));
+}
+
+TEST_CASE("American Put Pricing using Trinomial Lattice matches the Binomial Tree (CRR)") {
+    auto K = 100.0;
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = system_clock::now();
+    auto r = 0.01;
+    auto q = 0.05;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 0.5_years};
+    trinomial_solver solve{mktParams,1000};
+
+    auto trinomialPricing = solve(americanPut);
+
+    //Reference numbers are the ones used for the CRR tree with 2000 steps
+    CHECK(trinomialPricing->price() == Approx(6.5933242703).margin(0.005));
+    CHECK(trinomialPricing->delta() == Approx(-0.5151482623).margin(0.0005));
+    CHECK(trinomialPricing->gamma() == Approx(0.0274551564).margin(0.00005));
+    CHECK(trinomialPricing->theta() == Approx(-7.4856732784).margin(0.01));
+    CHECK(trinomialPricing->vega() == Approx(27.4428949973).epsilon(0.005));
+    CHECK(trinomialPricing->rho() == Approx(-29.049575029).epsilon(0.005));
+    CHECK(trinomialPricing->psi() == Approx(25.7710879181).epsilon(0.005));
+}
+
+TEST_CASE("American Put exercise boundary using Trinomial Lattice matches the QD+ paper, table 7, page 25") {
+    auto K = 45.0;
+    auto S = 40.0;
+    auto sigma = 0.20;
+    auto t = system_clock::now();
+    auto r = 0.0488;
+    auto q = 0.0;
+    mkt_params mktParams{S, sigma, t, r, q};
+    american_put americanPut{K, t + 0.583_years};
+    trinomial_solver solve{mktParams,2000};
+
+    auto trinomialPricing = solve(americanPut);
+
+    crr_solver solve_crr{mktParams,2000,200};
+    auto crrPricing = solve_crr(americanPut);
+
+    //The paper's 5.253 is the QD+ approximation itself, the lattices agree on a slightly higher price
+    CHECK(trinomialPricing->price() == Approx(crrPricing->price()).margin(0.001));
+    CHECK(trinomialPricing->exercise_boundary(0.583) == Approx(37.49).epsilon(0.005));
+}
+
+TEST_CASE("Trinomial Lattice converges faster than CRR for American Puts around the money") {
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = system_clock::now();
+    auto r = 0.05;
+    auto q = 0.0;
+    mkt_params mktParams{S, sigma, t, r, q};
+    fastamerican_solver solve_reference{mktParams, 25, 5, 12};
+
+    //RMS price errors over strikes and numbers of steps: the error of either lattice oscillates with where the strike
+    //falls between nodes, so at a single point CRR can be the closer one
+    double trinomial_error = 0, crr_error = 0;
+    for (auto steps: {100, 150, 200, 250, 300, 400}) {
+        trinomial_solver solve_trinomial{mktParams, steps};
+        crr_solver solve_crr{mktParams, steps};
+        for (auto K = 90.0; K <= 110.0; K += 2.5) {
+            american_put americanPut{K, t + 1.0_years};
+            auto reference = solve_reference(americanPut)->price();
+            trinomial_error += pow(solve_trinomial(americanPut)->price() - reference, 2);
+            crr_error += pow(solve_crr(americanPut)->price() - reference, 2);
+        }
+    }
+    CHECK(trinomial_error < crr_error / 1.5);
+}
+
+TEST_CASE("Trinomial Lattice puts strikes within one level of the spot on a level") {
+    auto S = 100.0;
+    auto sigma = 0.20;
+    auto t = system_clock::now();
+    auto r = 0.05;
+    auto q = 0.0;
+    mkt_params mktParams{S, sigma, t, r, q};
+    fastamerican_solver solve_reference{mktParams, 25, 5, 12};
+    trinomial_solver solve_trinomial{mktParams, 100};
+
+    //dx = sigma sqrt(dt) = 0.02: no stretch of the lattice rooted at the spot reaches these strikes. With the strike
+    //on a level the error is the smooth bias of the lattice, it doesn't oscillate with the strike
+    double lowest = INFINITY, highest = -INFINITY;
+    for (auto K: {98.5, 99.0, 99.5, 99.9, 100.1, 100.5, 101.0, 101.5}) {
+        american_put americanPut{K, t + 1.0_years};
+        auto reference = solve_reference(americanPut);
+        auto trinomial = solve_trinomial(americanPut);
+        auto error = trinomial->price() - reference->price();
+        lowest = std::min(lowest, error);
+        highest = std::max(highest, error);
+        CHECK(trinomial->price() == Approx(reference->price()).margin(0.003));
+        CHECK(trinomial->delta() == Approx(reference->delta()).margin(0.0002));
+        CHECK(trinomial->gamma() == Approx(reference->gamma()).margin(0.0001));
+        CHECK(trinomial->theta() == Approx(reference->theta()).margin(0.02));
+    }
+    CHECK(highest - lowest < 0.0003);
+}
@@ -0,0 +1,180 @@
+#include <catch2/catch.hpp>
+
+#include "../random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Philox4x32-10 matches the Random123 known answers") {
+    CHECK(philox{0}.encrypt({0, 0, 0, 0}) == philox::block{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+    CHECK(philox{UINT64_MAX}.encrypt({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}) == philox::block{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd});
+    philox pi{0x299f31d0a4093822};
+    CHECK(pi.encrypt({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}) == philox::block{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+}
+
+TEST_CASE("Random normal streams are reproducible and independent") {
+    random_normal<double> normal{42};
+    random_normal<double> same{42};
+    auto z = normal(1001);
+    CHECK(z == same(1001));
+
+    //Bulk fills, scalar draws and skips walk the same stream
+    random_normal<double> scalar{42};
+    for (int i = 0; i < 7; i++) {
+        CHECK(scalar() == z[i]);
+    }
+    std::vector<double> rest(500);
+    scalar.fill(rest.data(), rest.size());
+    CHECK(std::equal(rest.begin(), rest.end(), z.begin() + 7));
+    scalar.discard(300);
+    CHECK(scalar() == z[807]);
+
+    //Other streams of the same seed are uncorrelated
+    auto other = normal.stream(1)(10000);
+    auto first = normal.stream(0)(10000);
+    CHECK(std::equal(first.begin(), first.begin() + 1001, z.begin()));
+    double correlation = 0;
+    for (int i = 0; i < 10000; i++) {
+        correlation += first[i] * other[i] / 10000;
+    }
+    CHECK(std::abs(correlation) < 0.04);
+
+    //Without a seed every generator gets its own
+    CHECK(random_normal<double>{}.seed() != random_normal<double>{}.seed());
+}
+
+TEST_CASE("Random normals have the moments of the standard normal") {
+    random_normal<double> normal{7};
+    int n = 1000000;
+    auto z = normal(n);
+    double mean = 0, variance = 0, skew = 0, kurtosis = 0, tail = 0;
+    for (auto x: z) {
+        mean += x / n;
+        variance += x * x / n;
+        skew += x * x * x / n;
+        kurtosis += x * x * x * x / n;
+        tail += x < -2.0 ? 1.0 / n : 0.0;
+    }
+    CHECK(mean == Approx(0.0).margin(0.005));
+    CHECK(variance == Approx(1.0).margin(0.005));
+    CHECK(skew == Approx(0.0).margin(0.01));
+    CHECK(kurtosis == Approx(3.0).margin(0.03));
+    //P(Z < -2)
+    CHECK(tail == Approx(0.0227501319).margin(0.0005));
+
+    random_normal<float> single{7};
+    CHECK(single(1000)[999] == Approx(z[999]).epsilon(1e-6));
+}
+
+TEST_CASE("Sobol points are stratified in every dimension and in two dimensional projections") {
+    for (std::uint64_t seed: {0, 1234}) {
+        int dimensions = 64;
+        sobol sequence{dimensions, seed};
+        int n = 1024;
+        std::vector<double> u(n * dimensions);
+        sequence.points(0, n, u.data());
+        if (seed == 0) {
+            //Gray code order: 0, 1/2, 3/4, 1/4 in the first dimension, 0, 1/2, 1/4, 3/4 in the second one
+            CHECK(u[dimensions] == Approx(0.5));
+            CHECK(u[2 * dimensions] == Approx(0.75));
+            CHECK(u[3 * dimensions] == Approx(0.25));
+            CHECK(u[2 * dimensions + 1] == Approx(0.25));
+        }
+        //One point in each interval of length 1/1024 of every dimension
+        for (int d = 0; d < dimensions; d++) {
+            std::vector<int> counts(n, 0);
+            for (int i = 0; i < n; i++) {
+                counts[static_cast<int>(u[i * dimensions + d] * n)]++;
+            }
+            CHECK(std::ranges::count(counts, 1) == n);
+        }
+        //The first two dimensions form a (0, 2)-sequence: one point in each 32 x 32 box
+        std::vector<int> boxes(n, 0);
+        for (int i = 0; i < n; i++) {
+            boxes[static_cast<int>(u[i * dimensions] * 32) * 32 + static_cast<int>(u[i * dimensions + 1] * 32)]++;
+        }
+        CHECK(std::ranges::count(boxes, 1) == n);
+    }
+}
+
+TEST_CASE("Sobol sequences skip ahead and are filled by blocks from several threads") {
+    int dimensions = 16;
+    sobol sequence{dimensions, 7};
+    std::vector<double> sequential(4000 * dimensions);
+    for (int i = 0; i < 4000; i++) {
+        sequence.next(sequential.data() + i * dimensions);
+    }
+    CHECK(sequence.index() == 4000);
+
+    std::vector<double> u(dimensions);
+    sequence.seek(2345);
+    sequence.next(u.data());
+    CHECK(std::equal(u.begin(), u.end(), sequential.begin() + 2345 * dimensions));
+
+    std::vector<double> blocks(4000 * dimensions);
+    std::vector<std::thread> threads;
+    for (int k = 0; k < 4; k++) {
+        threads.emplace_back([&sequence, &blocks, dimensions, k]() {
+            sequence.points(1000 * k, 1000, blocks.data() + 1000 * k * dimensions);
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    CHECK(blocks == sequential);
+
+    //Normals are the inverse cumulative normal of the uniforms
+    std::vector<double> z(dimensions);
+    sequence.seek(17);
+    sequence.next_normal(z.data());
+    for (int d = 0; d < dimensions; d++) {
+        CHECK(0.5 * std::erfc(-z[d] / std::sqrt(2.0)) == Approx(sequential[17 * dimensions + d]).epsilon(1e-13));
+    }
+    CHECK(sobol{dimensions, 8}.index() == 0);
+}
+
+TEST_CASE("Inverse normal cumulative distribution") {
+    CHECK(inverse_normal_cdf(0.5) == 0.0);
+    CHECK(inverse_normal_cdf(0.975) == Approx(1.959963984540054).epsilon(1e-14));
+    CHECK(inverse_normal_cdf(0.025) == Approx(-1.959963984540054).epsilon(1e-14));
+    CHECK(inverse_normal_cdf(1e-10) == Approx(-6.361340902404056).epsilon(1e-14));
+    CHECK(inverse_normal_cdf(1.0 - 1e-10) == Approx(6.361340889697422).epsilon(1e-8));
+    for (auto u = 0.001; u < 1.0; u += 0.001) {
+        CHECK(0.5 * std::erfc(-inverse_normal_cdf(u) / std::sqrt(2.0)) == Approx(u).epsilon(1e-14));
+    }
+}
+
+TEST_CASE("Brownian bridge paths have the covariance of the Brownian motion") {
+    std::vector<double> times{0.1, 0.25, 0.3, 0.5, 0.8, 0.9, 1.0};
+    brownian_bridge bridge{times};
+    int n = bridge.steps();
+    random_normal<double> normal{11};
+    std::vector<double> z(n), W(n);
+    std::vector<double> covariance(n * n, 0.0);
+    int paths = 200000;
+    for (int p = 0; p < paths; p++) {
+        normal.fill(z.data(), n);
+        bridge(z.data(), W.data());
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                covariance[i * n + j] += W[i] * W[j] / paths;
+            }
+        }
+    }
+    //Cov(W(s), W(t)) = min(s, t)
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            CHECK(covariance[i * n + j] == Approx(std::min(times[i], times[j])).margin(0.01));
+        }
+    }
+
+    //The first normal sets the end of the path
+    brownian_bridge uniform{64, 2.0};
+    std::vector<double> e(64, 0.0), path(64);
+    e[0] = 1.0;
+    uniform(e.data(), path.data());
+    CHECK(path[63] == Approx(std::sqrt(2.0)));
+    CHECK(path[31] == Approx(std::sqrt(2.0) / 2));
+}